@@ -0,0 +1,120 @@
+/**
+ * Class        DCF77Capture.cpp
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Hardware timestamping of the DCF77 signal edges with the
+ *              input capture unit of Timer1
+ * 
+ * Board        Arduino Uno R3
+ * 
+ * Remarks      Uses Timer1 input capture and overflow interrupts
+ */
+
+#include <DCF77Capture.h>
+
+static DCF77Capture *capture = nullptr;
+
+ISR(TIMER1_CAPT_vect)
+{
+  capture->handleCapture();
+}
+
+ISR(TIMER1_OVF_vect)
+{
+  capture->handleOverflow();
+}
+
+/**
+ * Start Timer1 in normal mode with 16 MHz / 64 = 4 us ticks,
+ * noise canceler on and the first capture on a rising edge.
+ * The tick counter is aligned to millis() and micros().
+ */
+void DCF77Capture::begin()
+{
+  capture = this;
+  pinMode(PIN_ICP1, INPUT);
+
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = _BV(ICNC1) | _BV(ICES1) | _BV(CS11) | _BV(CS10);
+  TCNT1  = 0;
+  _overflows = 0;
+  _micros    = micros();
+  dcf77_clock_init(&_clock, 0, millis(), 250);   // 250 ticks = 1 ms
+  TIFR1  = _BV(ICF1) | _BV(TOV1);
+  TIMSK1 = _BV(ICIE1) | _BV(TOIE1);
+  interrupts();
+}
+
+/**
+ * Stop capturing
+ */
+void DCF77Capture::end()
+{
+  TIMSK1 = 0;
+}
+
+/**
+ * Called by the capture interrupt. Queues the latched timestamp 
+ * and switches the edge detector to the opposite edge.
+ */
+void DCF77Capture::handleCapture()
+{
+  uint16_t icr       = ICR1;
+  uint8_t  rising    = (TCCR1B & _BV(ICES1)) ? 1 : 0;
+  uint16_t overflows = _overflows;
+
+  // an overflow may be pending if the capture happened just after it
+  if ((TIFR1 & _BV(TOV1)) && icr < 0x8000) overflows++;
+  TCCR1B ^= _BV(ICES1);
+  TIFR1   = _BV(ICF1);   // changing the edge may set the flag
+
+  Capture c = { ((uint32_t)overflows << 16) | icr, rising };
+  if (! _captures.push(c)) _overruns++;
+}
+
+/**
+ * Called by the overflow interrupt every 262 ms
+ */
+void DCF77Capture::handleOverflow()
+{
+  _overflows++;
+}
+
+/**
+ * Read up to maxEdges queued edges and convert the timestamps
+ * to the time base of millis() and micros(). 
+ * Returns the number of edges read.
+ */
+uint8_t DCF77Capture::readEdges(int *edgeModes, uint32_t *edgeMillis, uint32_t *edgeMicros, uint8_t maxEdges)
+{
+  uint8_t n = 0;
+
+  Capture  c;
+
+  _captures.notePeak();
+  while (n < maxEdges && _captures.pop(c))
+  {
+    edgeModes[n]  = c.rising ? HIGH : LOW;
+    edgeMillis[n] = dcf77_clock_millis(&_clock, c.ticks);
+    edgeMicros[n] = _micros + (c.ticks << 2);
+    n++;
+  }
+  return n;
+}
+
+/**
+ * Number of edges lost because loop() did not read them in time
+ */
+uint16_t DCF77Capture::getOverruns()
+{
+  return _overruns;
+}
+
+/**
+ * Most captures found waiting in the queue by readEdges()
+ */
+uint8_t DCF77Capture::getPeak()
+{
+  return _captures.getPeak();
+}
@@ -0,0 +1,47 @@
+/**
+ * Header       DCF77Capture.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Declaration of the class DCF77Capture which timestamps the
+ *              edges of the receiver signal in hardware with the input
+ *              capture unit of Timer1. The timestamp is latched by the 
+ *              edge itself, independent of interrupt latency, with a 
+ *              resolution of 4 us. The interrupt handler only queues the 
+ *              raw captures, loop() reads them in batches and converts
+ *              them to the millis() and micros() time base.
+ * 
+ * Wiring       Receiver output to ICP1, which is digital pin 8 on the Uno
+ * 
+ * Remarks      Timer1 runs with prescaler 64, therefore PWM on pins 9 and 10 
+ *              and libraries using Timer1 (e.g. Servo) are not available.
+ */
+
+#include <Arduino.h>
+#include <SpscQueue.h>
+#include <DCF77Core.h>
+#ifndef _DCF77Capture_H_
+#define _DCF77Capture_H_
+
+#define PIN_ICP1        8
+#define CAPTURE_QUEUE   8     // number of queued edges, power of 2
+
+class DCF77Capture
+{
+  public:
+    void begin();
+    void end();
+    uint8_t readEdges(int *edgeModes, uint32_t *edgeMillis, uint32_t *edgeMicros, uint8_t maxEdges);
+    void handleCapture();
+    void handleOverflow();
+    uint16_t getOverruns();
+    uint8_t getPeak();
+
+  private:
+    typedef struct { uint32_t ticks; uint8_t rising; } Capture;   // ticks of 4 us
+    SpscQueue<Capture, CAPTURE_QUEUE> _captures;
+    volatile uint16_t _overflows = 0;           // high word of the tick counter
+    volatile uint16_t _overruns = 0;            // edges lost because queue was full
+    uint32_t _micros = 0;                       // micros() when tick counter was 0
+    dcf77_clock _clock;                         // ticks to millis()
+};
+#endif
@@ -0,0 +1,95 @@
+/**
+ * Module       DCF77Bank.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Decoder bank with the channel state as structure of arrays
+ *              and branch free pulse classification
+ * 
+ * Remarks      Plain C99, allocation free, meant for hosts
+ */
+
+#include <string.h>
+#include <DCF77Bank.h>
+#include <DCF77Thresholds.h>
+
+/**
+ * Bytes of memory needed for a bank of nbrChannels,
+ * the memory must be aligned for uint64_t
+ */
+size_t dcf77_bank_size(uint32_t nbrChannels)
+{
+  return (size_t)nbrChannels * (sizeof(uint64_t) + 2 * sizeof(uint32_t) + 3 * sizeof(uint8_t));
+}
+
+/**
+ * Lay out the arrays of the bank in memory of dcf77_bank_size() 
+ * bytes and reset all channels
+ */
+void dcf77_bank_init(dcf77_bank *bank, uint32_t nbrChannels, void *memory)
+{
+  uint8_t *p = (uint8_t *)memory;
+
+  memset(memory, 0, dcf77_bank_size(nbrChannels));
+  bank->nbrChannels  = nbrChannels;
+  bank->frame        = (uint64_t *)p;  p += nbrChannels * sizeof(uint64_t);
+  bank->startPulse   = (uint32_t *)p;  p += nbrChannels * sizeof(uint32_t);
+  bank->endPulse     = (uint32_t *)p;  p += nbrChannels * sizeof(uint32_t);
+  bank->seconds      = p;              p += nbrChannels;
+  bank->nbrBits      = p;              p += nbrChannels;
+  bank->synchronized = p;
+}
+
+/**
+ * Feed a batch of edges of many channels, best sorted by channel. Every 
+ * completed telegram is stored in frames, at most maxFrames. 
+ * Returns the number of telegrams stored.
+ * One pass over the edges: a rising edge only stores its time unless
+ * it ends a sync gap, which is rare. A falling edge is classified and
+ * written into the telegram without branches, so random bits cost no
+ * mispredictions. The level alternates and is predicted.
+ */
+size_t dcf77_bank_push_edges(dcf77_bank *bank, const uint32_t *channels, const uint32_t *times, 
+                             const uint8_t *levels, size_t nbrEdges, dcf77_bank_frame *frames, size_t maxFrames)
+{
+  size_t nbrFrames = 0;
+
+  for (size_t i = 0; i < nbrEdges; i++)
+  {
+    uint32_t c = channels[i];
+    uint32_t t = times[i];
+
+    if (levels[i])
+    {
+      uint32_t w = t - bank->endPulse[c];
+      bank->startPulse[c] = t;
+      if ((w - (MIN_SYNCGAP - JITTER) - 1) < (uint32_t)(MAX_SYNCGAP - MIN_SYNCGAP + 2 * JITTER - 1))
+      { // minute mark, like dcf77_mark_minute()
+        if (bank->synchronized[c] && nbrFrames < maxFrames)
+        {
+          frames[nbrFrames].frame    = bank->frame[c];
+          frames[nbrFrames].markTime = t;
+          frames[nbrFrames].channel  = c;
+          frames[nbrFrames].nbrBits  = bank->seconds[c];
+          nbrFrames++;
+        }
+        bank->synchronized[c] = 1;
+        bank->nbrBits[c]      = bank->seconds[c];
+        bank->seconds[c]      = 0;
+      }
+    }
+    else
+    { // like dcf77_push_bit() with the bit of dcf77_classify_pulse()
+      uint32_t w       = t - bank->startPulse[c];
+      uint8_t  seconds = bank->seconds[c];
+      uint8_t  sync    = bank->synchronized[c];
+      uint8_t  bit1    = (w - (P1 - JITTER) - 1) < (uint32_t)(2 * JITTER - 1);
+      uint8_t  bit0    = (w - (P0 - JITTER) - 1) < (uint32_t)(2 * JITTER - 1);
+      uint64_t write   = -(uint64_t)(sync & (bit0 | bit1) & (seconds < FRAMEBITS));
+      uint64_t mask    = ((uint64_t)1 << (seconds & 63)) & write;
+      bank->frame[c]   = (bank->frame[c] & ~mask) | (mask & -(uint64_t)bit1);
+      bank->seconds[c] = seconds + (sync & (seconds < 0xFF));
+      bank->endPulse[c] = t;
+    }
+  }
+  return nbrFrames;
+}
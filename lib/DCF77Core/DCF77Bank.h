@@ -0,0 +1,59 @@
+/**
+ * Header       DCF77Bank.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Plain C interface of a decoder bank, which decodes the signal
+ *              streams of many receiver channels at once, e.g. on a host 
+ *              aggregating thousands of receivers. The state of all channels
+ *              is kept as structure of arrays in memory owned by the caller,
+ *              19 bytes per channel instead of 24 for a dcf77_ctx.
+ * 
+ * Remarks      Edges are pushed in batches, the edges of each channel in 
+ *              time order. Sorted by channel, the arrays of the state are
+ *              read and written sequentially. Every edge is handled in one
+ *              pass without a call: a falling edge is classified and
+ *              written into the telegram without branches, a rising edge
+ *              branches only at the rare sync gap. The results are the 
+ *              same as with one dcf77_ctx per channel and dcf77_push_edge(),
+ *              see the unit tests. At 10000 channels the bank decodes 1.5
+ *              to 2 times the edges per second (tools/dcf77bankbench.c).
+ */
+
+#ifndef _DCF77Bank_H_
+#define _DCF77Bank_H_
+
+#include <DCF77Core.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct 
+{
+  uint32_t  nbrChannels;
+  uint64_t *frame;         // per channel, see dcf77_ctx
+  uint32_t *startPulse;
+  uint32_t *endPulse;
+  uint8_t  *seconds;
+  uint8_t  *nbrBits;
+  uint8_t  *synchronized;
+} dcf77_bank;
+
+typedef struct
+{
+  uint64_t frame;          // packed telegram
+  uint32_t markTime;       // timestamp of the minute mark which completed it
+  uint32_t channel;        // channel which received it
+  uint8_t  nbrBits;        // number of seconds counted
+  uint8_t  reserved[7];
+} dcf77_bank_frame;
+
+size_t dcf77_bank_size(uint32_t nbrChannels);
+void   dcf77_bank_init(dcf77_bank *bank, uint32_t nbrChannels, void *memory);
+size_t dcf77_bank_push_edges(dcf77_bank *bank, const uint32_t *channels, const uint32_t *times, 
+                             const uint8_t *levels, size_t nbrEdges, dcf77_bank_frame *frames, size_t maxFrames);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,853 @@
+/**
+ * Module       DCF77Core.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Reentrant, allocation free decoding of the DCF77 time 
+ *              telegram: pulse classification, minute framing, parity
+ *              and plausibility checks and BCD extraction
+ * 
+ * Remarks      Plain C99, compiles for the Arduino as well as for hosts
+ * 
+ * References   https://oar.ptb.de/files/download/56d6a9c0ab9f3f76468b45a7 
+ */
+
+#include <DCF77Core.h>
+#include <DCF77Thresholds.h>
+
+#define TIME_BITS 0x07FFFFFFFFE60000ULL   // time zone (17, 18), time and date (21..58)
+#define CLOCK_BITS 0x0000000FFFE60000ULL  // time zone (17, 18), minute and hour (21..35)
+#define GRID_BITS 0x07FFFFFFFFF60001ULL   // markers (0, 20), time zone, time and date
+#define MINUTE_MASK 0x0FFFFFFFFFFFFFFFULL // seconds 0..59
+
+#define CLASSIFY_BLOCK 64                  // edges checked for alternating levels at once
+
+static const uint8_t segments[3][2] = { { 21, 28 }, { 29, 35 }, { 36, 58 } };   // parity segments
+
+#ifdef DCF77_TUNING
+uint32_t dcf77_thresholds[5] = { 100, 200, 35, 1800, 1900 };
+
+/**
+ * Set P0, P1, JITTER, MIN_SYNCGAP and MAX_SYNCGAP of the tuning build
+ */
+void dcf77_set_thresholds(const uint32_t *thresholds)
+{
+  for (uint8_t i = 0; i < 5; i++) dcf77_thresholds[i] = thresholds[i];
+}
+#endif
+
+/**
+ * Count the set bits of the telegram from firstBit to lastBit
+ */
+static uint8_t countBits(uint64_t frame, uint8_t firstBit, uint8_t lastBit)
+{
+  uint64_t bits = (frame >> firstBit) & (((uint64_t)1 << (lastBit - firstBit + 1)) - 1);
+  uint8_t  sum  = 0;
+
+  while (bits)
+  {
+    bits &= bits - 1;
+    sum++;
+  }
+  return sum;
+}
+
+/**
+ * Reset a stream context
+ */
+void dcf77_init(dcf77_ctx *ctx)
+{
+  ctx->frame        = 0;
+  ctx->startPulse   = 0;
+  ctx->endPulse     = 0;
+  ctx->seconds      = 0;
+  ctx->nbrBits      = 0;
+  ctx->synchronized = 0;
+  ctx->reserved     = 0;
+}
+
+/**
+ * Align a free running tick counter, e.g. of a timer with input 
+ * capture, to a millisecond time base: ticks correspond to millis
+ */
+void dcf77_clock_init(dcf77_clock *clock, uint32_t ticks, uint32_t millis, uint16_t ticksPerMs)
+{
+  clock->ticks      = ticks;
+  clock->millis     = millis;
+  clock->remainder  = 0;
+  clock->ticksPerMs = ticksPerMs;
+}
+
+/**
+ * Convert a tick count, not older than the last one converted, to ms.
+ * The fractions of a ms are carried over, so the ms never fall behind
+ * the ticks however many conversions are made. The counter may wrap.
+ */
+uint32_t dcf77_clock_millis(dcf77_clock *clock, uint32_t ticks)
+{
+  uint32_t delta = ticks - clock->ticks + clock->remainder;
+
+  clock->ticks     = ticks;
+  clock->millis   += delta / clock->ticksPerMs;
+  clock->remainder = (uint16_t)(delta % clock->ticksPerMs);
+  return clock->millis;
+}
+
+/**
+ * Classify a measured pulse width against the P0 and P1 windows.
+ * Returns 0 or 1 for a valid bit and -1 for a glitch.
+ * Both windows are tested with one unsigned compare each.
+ */
+int dcf77_classify_pulse(int32_t widthPulse)
+{
+  if ((uint32_t)(widthPulse - (P1 - JITTER) - 1) < (2 * JITTER - 1)) return 1;
+  if ((uint32_t)(widthPulse - (P0 - JITTER) - 1) < (2 * JITTER - 1)) return 0;
+  return -1;
+}
+
+/**
+ * Feed one edge of the stream. A pause between 2 pulses in the 
+ * sync window marks the beginning of a new minute, the counting
+ * of seconds restarts with 0. Returns a DCF77_EV_* event.
+ */
+int dcf77_push_edge(dcf77_ctx *ctx, uint32_t time, int rising)
+{
+  if (rising)
+  { // Pulse begins and pause ends
+    uint32_t widthPause = time - ctx->endPulse;
+    ctx->startPulse = time;
+    if (widthPause > (MIN_SYNCGAP - JITTER) && widthPause < (MAX_SYNCGAP + JITTER))
+    {
+      return dcf77_mark_minute(ctx);
+    }
+    return DCF77_EV_PULSE;
+  }
+
+  // Pulse ends and pause begins
+  return dcf77_push_bit(ctx, time, dcf77_classify_pulse((int32_t)(time - ctx->startPulse)));
+}
+
+/**
+ * Take the running pulse as minute mark, either after the sync gap 
+ * or because the caller predicted it otherwise. The counting of 
+ * seconds restarts with 0. Returns DCF77_EV_MINUTE.
+ */
+int dcf77_mark_minute(dcf77_ctx *ctx)
+{
+  ctx->synchronized = 1;
+  ctx->nbrBits      = ctx->seconds;
+  ctx->seconds      = 0;
+  return DCF77_EV_MINUTE;
+}
+
+/**
+ * Feed the end of a pulse which has already been classified,
+ * bit is 0, 1 or -1 for a glitch. Returns a DCF77_EV_* event.
+ */
+int dcf77_push_bit(dcf77_ctx *ctx, uint32_t time, int bit)
+{
+  ctx->endPulse = time;
+  if (ctx->synchronized)
+  {
+    if (bit >= 0 && ctx->seconds < FRAMEBITS)
+    {
+      uint64_t mask = (uint64_t)1 << ctx->seconds;
+      ctx->frame = bit ? (ctx->frame | mask) : (ctx->frame & ~mask);
+    }
+    if (ctx->seconds < 0xFF) ctx->seconds++;
+  }
+  return (bit < 0) ? DCF77_EV_GLITCH : DCF77_EV_BIT0 + bit;
+}
+
+/**
+ * DCF77_EV_* of an edge after an interval w since the last edge of the
+ * other level, without branches: the windows are tested with unsigned 
+ * compares like in dcf77_classify_pulse() and combined arithmetically
+ */
+static inline uint8_t eventOf(uint32_t w, uint8_t rise)
+{
+  uint8_t sync = (w - (MIN_SYNCGAP - JITTER) - 1) < (uint32_t)(MAX_SYNCGAP - MIN_SYNCGAP + 2 * JITTER - 1);
+  uint8_t bit1 = (w - (P1 - JITTER) - 1) < (uint32_t)(2 * JITTER - 1);
+  uint8_t bit0 = ((w - (P0 - JITTER) - 1) < (uint32_t)(2 * JITTER - 1)) & !bit1;
+
+  return rise ? DCF77_EV_PULSE + sync : DCF77_EV_GLITCH - 2 * bit0 - bit1;
+}
+
+/**
+ * Classify a batch of edges of one stream like dcf77_push_edge() and
+ * store the DCF77_EV_* of edge i in events[i]. The first edges are 
+ * measured against the last pulse in ctx, which is not changed. Runs 
+ * of strictly alternating levels, the normal case, are measured edge
+ * to edge in blocks the compiler can vectorize, other runs track the
+ * last rising and falling edge. Nothing depends on the bits received.
+ */
+void dcf77_classify_batch(const dcf77_ctx *ctx, const uint32_t *times, const uint8_t *levels, 
+                          size_t nbrEdges, uint8_t *events)
+{
+  uint32_t lastRise = ctx->startPulse;
+  uint32_t lastFall = ctx->endPulse;
+
+  for (size_t base = 0; base < nbrEdges; )
+  {
+    size_t  end  = (nbrEdges - base < CLASSIFY_BLOCK) ? nbrEdges : base + CLASSIFY_BLOCK;
+    uint8_t same = (base == 0);
+    for (size_t i = base + (base == 0); i < end; i++) same |= (levels[i] != 0) == (levels[i - 1] != 0);
+    if (! same)
+    {
+      for (size_t i = base; i < end; i++) events[i] = eventOf(times[i] - times[i - 1], levels[i] != 0);
+    }
+    else
+    {
+      for (size_t i = base; i < end; i++)
+      {
+        uint8_t rise = levels[i] != 0;
+        events[i] = eventOf(times[i] - (rise ? lastFall : lastRise), rise);
+        lastRise  = rise ? times[i] : lastRise;
+        lastFall  = rise ? lastFall : times[i];
+      }
+    }
+    base = end;
+    if (levels[end - 1]) lastRise = times[end - 1]; else lastFall = times[end - 1];
+    if (end - 1 > 0 && (levels[end - 2] != 0) != (levels[end - 1] != 0))
+    {
+      if (levels[end - 2]) lastRise = times[end - 2]; else lastFall = times[end - 2];
+    }
+  }
+}
+
+/**
+ * Index of the first rising edge of a batch of one stream which ends
+ * a sync gap, i.e. of the first minute mark, nbrEdges if there is none.
+ * The first pause is measured from the last pulse in ctx. Lets a host
+ * skip the seconds before the mark of a stream it joins.
+ */
+size_t dcf77_find_sync_gap(const dcf77_ctx *ctx, const uint32_t *times, const uint8_t *levels, size_t nbrEdges)
+{
+  uint32_t lastFall = ctx->endPulse;
+
+  for (size_t i = 0; i < nbrEdges; i++)
+  {
+    uint32_t w = times[i] - lastFall;
+    if (levels[i] && (w - (MIN_SYNCGAP - JITTER) - 1) < (uint32_t)(MAX_SYNCGAP - MIN_SYNCGAP + 2 * JITTER - 1)) return i;
+    lastFall = levels[i] ? lastFall : times[i];
+  }
+  return nbrEdges;
+}
+
+/**
+ * Feed a batch of edges given as caller owned arrays of timestamps 
+ * and levels (nonzero = rising). Every completed telegram is stored 
+ * in frames, at most maxFrames. Returns the number of telegrams stored.
+ */
+size_t dcf77_push_edges(dcf77_ctx *ctx, const uint32_t *times, const uint8_t *levels, size_t nbrEdges,
+                        dcf77_frame *frames, size_t maxFrames)
+{
+  size_t nbrFrames = 0;
+
+  for (size_t i = 0; i < nbrEdges; i++)
+  {
+    uint64_t frame = ctx->frame;
+    uint8_t  sync  = ctx->synchronized;
+    if (dcf77_push_edge(ctx, times[i], levels[i]) == DCF77_EV_MINUTE && sync && nbrFrames < maxFrames)
+    {
+      frames[nbrFrames].frame    = frame;
+      frames[nbrFrames].markTime = times[i];
+      frames[nbrFrames].nbrBits  = ctx->nbrBits;
+      frames[nbrFrames].repairs  = 0;
+      nbrFrames++;
+    }
+  }
+  return nbrFrames;
+}
+
+/**
+ * Reset the time slots and forget the last valid telegram
+ */
+void dcf77_slots_init(dcf77_slots *slots)
+{
+  slots->lastFrame   = 0;
+  slots->lastChecked = 0;
+  dcf77_slots_resync(slots);
+}
+
+/**
+ * Forget the framing of the running telegram, e.g. when the stream
+ * restarts after a gap. The last telegrams are kept.
+ */
+void dcf77_slots_resync(dcf77_slots *slots)
+{
+  slots->bits       = 0;
+  slots->seen       = 0;
+  slots->bad        = 0;
+  slots->lastMillis = 0;
+  slots->lastSlot   = 0;
+  slots->framed     = 0;
+  slots->repairs    = 0;
+  slots->reserved   = 0;
+}
+
+/**
+ * Time slot of a rising edge, in seconds from the minute mark,
+ * counted from the last valid pulse. 0xFF if it is too far away.
+ */
+uint8_t dcf77_slot_of(const dcf77_slots *slots, uint32_t rise)
+{
+  uint32_t seconds = (rise - slots->lastMillis + 500) / 1000;
+  return (seconds >= 0xFFU - slots->lastSlot) ? 0xFF : slots->lastSlot + seconds;
+}
+
+/**
+ * Enter a valid pulse into the time slot of its second, counted from
+ * the previous valid pulse by its rising edge. Extra or missing edges
+ * do not shift the slots. Pulses disagreeing in one slot discard it.
+ */
+static void recordSlot(dcf77_slots *slots, uint32_t rise, int bit)
+{
+  uint8_t  slot = dcf77_slot_of(slots, rise);
+  if (slot >= FRAMEBITS) return;
+
+  uint64_t mask = (uint64_t)1 << slot;
+  if (slots->seen & mask)
+  {
+    if (((slots->bits & mask) != 0) != bit)
+    {
+      slots->seen &= ~mask;
+      slots->bad  |= mask;
+    }
+  }
+  else if (!(slots->bad & mask))
+  {
+    slots->seen |= mask;
+    if (bit) slots->bits |= mask;
+  }
+  slots->lastSlot   = slot;
+  slots->lastMillis = rise;
+}
+
+/**
+ * True if a rising edge comes exactly when the minute mark is due 
+ * after the last valid pulse near the end of the minute. Catches
+ * marks whose sync gap was shortened by a glitch.
+ */
+static int isPredictedMark(const dcf77_ctx *ctx, const dcf77_slots *slots, uint32_t time)
+{
+  if (! slots->framed || ! ctx->synchronized || slots->lastSlot < FRAMEBITS - 4) return 0;
+  uint32_t predicted = slots->lastMillis + (60 - slots->lastSlot) * 1000UL;
+  return (time - predicted + JITTER) <= 2 * JITTER;
+}
+
+/**
+ * The telegram following a valid one, without announcements,
+ * 0 if frame is not valid
+ */
+static uint64_t nextFrame(uint64_t frame)
+{
+  dcf77_time time;
+
+  if (dcf77_decode_frame(frame, &time) != DCF77_OK) return 0;
+  dcf77_from_unix(dcf77_unix_time(&time) + 60, time.isdst, &time);
+  return dcf77_encode_frame(&time);
+}
+
+/**
+ * Confirm a telegram which has passed its checks: true if time zone,
+ * time and date have been received in full, or equal the telegram 
+ * which passed its checks before + 1 minute. A missing bit has kept 
+ * its old value or has been given by parity, the parity check proves
+ * nothing about it. Remembers frame for the next telegram.
+ */
+static int confirmFrame(dcf77_slots *slots, uint64_t frame)
+{
+  uint64_t last = slots->lastChecked;
+
+  slots->lastChecked = frame;
+  if (!(~slots->seen & TIME_BITS)) return 1;
+  return !((frame ^ nextFrame(last)) & TIME_BITS);
+}
+
+/**
+ * Called at the minute mark. The counted telegram has slipped if its
+ * length is not FRAMEBITS or a bit disagrees with its time slot. Then,
+ * or if its checks fail, the telegram is rebuilt from the time slots,
+ * provided they end at the mark at time. Missing bits are completed by
+ * markers and parity and otherwise taken from the last valid telegram.
+ * Returns the counted telegram if the rebuilt one fails. A slipped 
+ * telegram which cannot be rebuilt and a valid one which misses bits 
+ * and is not confirmed, see confirmFrame(), are marked DCF77_FIX_REJECTED.
+ */
+static uint64_t alignFrame(const dcf77_ctx *ctx, dcf77_slots *slots, uint32_t time)
+{
+  uint64_t frame = ctx->frame;
+  int      slip  = ctx->nbrBits != FRAMEBITS || ((frame ^ slots->bits) & slots->seen);
+
+  if (slip) slots->repairs |= DCF77_FIX_SLIP;
+  slots->framed = 1;
+  if (! slip && dcf77_check_frame(frame) == DCF77_OK) 
+  {
+    if (! confirmFrame(slots, frame)) 
+    {
+      slots->repairs |= DCF77_FIX_REJECTED;
+      return frame;
+    }
+    slots->lastFrame = frame;
+    return frame;
+  }
+  uint64_t aligned = (slots->bits & slots->seen) | ((slip ? slots->lastFrame : frame) & ~slots->seen);
+  if (dcf77_slot_of(slots, time) != 60 || dcf77_complete_frame(&aligned, slots->seen) != DCF77_OK) 
+  {
+    if (slip) slots->repairs |= DCF77_FIX_REJECTED;
+    slots->framed = 0;   // the minute mark may be wrong as well, or one has been missed
+    return frame;
+  }
+  if (! confirmFrame(slots, aligned))
+  {
+    if (slip) slots->repairs |= DCF77_FIX_REJECTED;   // the slots agree, the framing stands
+    return frame;
+  }
+  slots->repairs  |= DCF77_FIX_REBUILT;
+  slots->lastFrame = aligned;
+  return aligned;
+}
+
+/**
+ * Frame an event of the stream by the time slots. time is the edge, 
+ * rise the rising edge of a classified pulse, wasSynchronized the 
+ * state before the edge. Returns the event, possibly corrected.
+ */
+static int frameEvent(dcf77_ctx *ctx, dcf77_slots *slots, int event, uint32_t time, uint32_t rise,
+                      uint8_t wasSynchronized)
+{
+  uint8_t slot;
+
+  slots->repairs = 0;
+  if (event == DCF77_EV_PULSE && isPredictedMark(ctx, slots, time))
+  { // the sync gap has been corrupted, but the pulse is where the mark is due
+    event = dcf77_mark_minute(ctx);
+    slots->repairs |= DCF77_FIX_FLYWHEEL;
+  }
+  else if (event == DCF77_EV_MINUTE && slots->framed && (slot = dcf77_slot_of(slots, time)) < FRAMEBITS)
+  { // a dropped pulse looks like the sync gap, but the minute is not over yet
+    ctx->seconds = slot;
+    event = DCF77_EV_PULSE;
+    slots->repairs |= DCF77_FIX_FALSEMARK;
+  }
+
+  if (event == DCF77_EV_MINUTE)
+  {
+    if (wasSynchronized) ctx->frame = alignFrame(ctx, slots, time); else slots->framed = 0;
+    slots->bits       = 0;
+    slots->seen       = 0;
+    slots->bad        = 0;
+    slots->lastSlot   = 0;
+    slots->lastMillis = time;
+  }
+  else if ((event == DCF77_EV_BIT0 || event == DCF77_EV_BIT1) && ctx->synchronized)
+  {
+    recordSlot(slots, rise, event == DCF77_EV_BIT1);
+  }
+  return event;
+}
+
+/**
+ * Feed one edge like dcf77_push_edge() and frame the telegram by the 
+ * time slots of its pulses. At the minute mark ctx->frame holds the
+ * telegram, rebuilt if it has slipped. The repairs made are left in
+ * slots->repairs. Returns a DCF77_EV_* event.
+ */
+int dcf77_push_framed_edge(dcf77_ctx *ctx, dcf77_slots *slots, uint32_t time, int rising)
+{
+  uint8_t sync  = ctx->synchronized;
+  int     event = dcf77_push_edge(ctx, time, rising);
+  return frameEvent(ctx, slots, event, time, ctx->startPulse, sync);
+}
+
+/**
+ * Feed a pulse classified ahead of its falling edge like dcf77_push_bit(),
+ * rise is its rising edge, and frame the telegram like 
+ * dcf77_push_framed_edge(). Returns a DCF77_EV_* event.
+ */
+int dcf77_push_framed_bit(dcf77_ctx *ctx, dcf77_slots *slots, uint32_t time, uint32_t rise, int bit)
+{
+  uint8_t sync  = ctx->synchronized;
+  int     event = dcf77_push_bit(ctx, time, bit);
+  return frameEvent(ctx, slots, event, time, rise, sync);
+}
+
+/**
+ * Feed a batch of edges like dcf77_push_edges() and frame the telegrams
+ * by the time slots like dcf77_push_framed_edge(), as the clock does. 
+ * Every telegram completed at a minute mark is stored in frames with its
+ * repairs, rebuilt if it has slipped, at most maxFrames. Returns the 
+ * number of telegrams stored.
+ */
+size_t dcf77_push_framed_edges(dcf77_ctx *ctx, dcf77_slots *slots, const uint32_t *times, const uint8_t *levels,
+                               size_t nbrEdges, dcf77_frame *frames, size_t maxFrames)
+{
+  size_t nbrFrames = 0;
+
+  for (size_t i = 0; i < nbrEdges; i++)
+  {
+    uint8_t sync = ctx->synchronized;
+    if (dcf77_push_framed_edge(ctx, slots, times[i], levels[i]) == DCF77_EV_MINUTE && sync && nbrFrames < maxFrames)
+    {
+      frames[nbrFrames].frame    = ctx->frame;
+      frames[nbrFrames].markTime = times[i];
+      frames[nbrFrames].nbrBits  = ctx->nbrBits;
+      frames[nbrFrames].repairs  = slots->repairs;
+      nbrFrames++;
+    }
+  }
+  return nbrFrames;
+}
+
+/**
+ * Start an empty grid, the next pulse is its first
+ */
+void dcf77_grid_init(dcf77_grid *grid)
+{
+  grid->bits      = 0;
+  grid->seen      = 0;
+  grid->firstRise = 0;
+  grid->lastRise  = 0;
+  grid->last      = 0;
+  grid->reserved[0] = grid->reserved[1] = grid->reserved[2] = 0;
+}
+
+/**
+ * Enter a valid pulse with its rising edge into the grid, by its 
+ * second from the first pulse. The grid spans one minute, it starts
+ * again with a pulse beyond. Returns the second of the pulse.
+ */
+uint8_t dcf77_grid_push(dcf77_grid *grid, uint32_t rise, int bit)
+{
+  uint32_t second = (rise - grid->firstRise + 500) / 1000;
+
+  if (! grid->seen || second >= 60)
+  {
+    dcf77_grid_init(grid);
+    grid->firstRise = rise;
+    second = 0;
+  }
+  uint64_t mask = (uint64_t)1 << second;
+  grid->seen |= mask;
+  grid->bits  = bit ? (grid->bits | mask) : (grid->bits & ~mask);
+  grid->last     = second;
+  grid->lastRise = rise;
+  return second;
+}
+
+/**
+ * Telegram sent in the minute beginning at the UTC seconds,
+ * it announces the next minute
+ */
+static uint64_t frameAt(uint32_t seconds, int8_t isdst)
+{
+  dcf77_time time;
+
+  dcf77_from_unix(seconds + 60, isdst, &time);
+  return dcf77_encode_frame(&time);
+}
+
+/**
+ * Lock the time slots on a time prior: the first pulse of the grid is 
+ * at firstUnix +/- uncertainty seconds UTC. Every second in that range 
+ * is tried as the second of the first pulse, in both time zones. A 
+ * candidate counts once the pulses cover its time zone, minute and hour
+ * and its second 58 has passed, so the date has been received as well.
+ * It matches if all pulses agree with the markers, the time zone, the
+ * time and the date of the telegrams it predicts. A single match frames
+ * ctx and slots at the last pulse, as if the last minute mark had been
+ * seen, with the telegram so far in ctx->frame.
+ * Returns the number of matches, 1 locked, 2 more than one, 0 if the 
+ * pulses of a whole minute, all seconds but the one before the mark, 
+ * contradict the prior, else -1.
+ */
+int dcf77_grid_lock(const dcf77_grid *grid, uint32_t firstUnix, uint16_t uncertainty, 
+                    dcf77_ctx *ctx, dcf77_slots *slots)
+{
+  uint32_t lo      = firstUnix - uncertainty;
+  uint32_t hi      = firstUnix + uncertainty;
+  uint64_t covered = 0;             // bit k: the pulses cover the clock if the first is at second k
+  uint64_t seconds = grid->seen;    // seconds of the minute seen if the first pulse is at second k
+  uint32_t start   = 0;             // UTC of the minute of the first pulse if matched
+  uint8_t  first   = 0;             // second of the first pulse if matched
+  int8_t   isdst   = 0;
+  int      found   = -1;
+
+  for (uint8_t k = 0; k < 60; k++)
+  {
+    if (!(~seconds & CLOCK_BITS) && k + grid->last >= FRAMEBITS - 1) covered |= (uint64_t)1 << k;
+    seconds = ((seconds << 1) | (seconds >> 59)) & MINUTE_MASK;
+  }
+  if (! covered) return -1;
+  for (uint32_t minute = lo - lo % 60; (int32_t)(minute - hi) <= 0; minute += 60)
+  {
+    for (int8_t dst = 0; dst < 2; dst++)
+    {
+      uint64_t current = frameAt(minute, dst);        // minute of the first pulse, seconds k..59
+      uint64_t next    = frameAt(minute + 60, dst);   // following minute, seconds 0..k-1
+      uint64_t bits    = grid->bits;
+      uint64_t seen    = grid->seen;
+      uint64_t early   = 0;                           // seconds 0..k-1
+      for (uint8_t k = 0; k < 60; k++)
+      { // bits and seen rotated to the seconds of the minute
+        if (((covered >> k) & 1) && (int32_t)(minute + k - lo) >= 0 && (int32_t)(minute + k - hi) <= 0)
+        {
+          if (found < 0) found = 0;
+          if (!((bits ^ ((current & ~early) | (next & early))) & seen & GRID_BITS))
+          {
+            if (found++) return found;
+            start = minute;
+            first = k;
+            isdst = dst;
+          }
+        }
+        bits  = ((bits << 1) | (bits >> 59)) & MINUTE_MASK;
+        seen  = ((seen << 1) | (seen >> 59)) & MINUTE_MASK;
+        early = (early << 1) | 1;
+      }
+    }
+  }
+  if (found == 0 && countBits(grid->seen, 0, 59) < FRAMEBITS) return -1;   // the right candidate may not count yet
+  if (found != 1) return found;
+
+  // frame the minute of the last pulse at its second
+  uint8_t  second = first + grid->last;
+  uint64_t mask   = grid->seen << first;              // seconds seen in the minute of the first pulse
+  if (second >= 60)
+  {
+    second -= 60;
+    start  += 60;
+    mask    = grid->seen >> (60 - first);
+  }
+  mask &= ((uint64_t)2 << second) - 1;
+  ctx->frame         = frameAt(start, isdst);
+  ctx->seconds       = second + 1;
+  ctx->synchronized  = 1;
+  slots->bits        = ctx->frame & mask;
+  slots->seen        = mask;
+  slots->bad         = 0;
+  slots->lastFrame   = frameAt(start - 60, isdst);
+  slots->lastChecked = slots->lastFrame;
+  slots->lastMillis  = grid->lastRise;
+  slots->lastSlot    = second;
+  slots->framed      = 1;
+  return 1;
+}
+
+/**
+ * Calculate value from bcd coded bits starting 
+ * at firstBit and composed of nbrBits (max. 8)
+ */
+uint8_t dcf77_get_value(uint64_t frame, uint8_t firstBit, uint8_t nbrBits)
+{
+  uint8_t bcd = (uint8_t)(frame >> firstBit) & ((1 << nbrBits) - 1);
+  return (bcd & 0x0F) + 10 * (bcd >> 4);
+}
+
+/**
+ * Check the markers and the even parity of the 3 segments.
+ * Returns DCF77_OK or the DCF77_ERR_* bits of the failed checks.
+ */
+int dcf77_check_frame(uint64_t frame)
+{
+  int status = DCF77_OK;
+
+  if (countBits(frame, 21, 28) & 1) status |= DCF77_ERR_MINUTE;
+  if (countBits(frame, 29, 35) & 1) status |= DCF77_ERR_HOUR;
+  if (countBits(frame, 36, 58) & 1) status |= DCF77_ERR_DATE;
+  if ((frame & 1) || !((frame >> 20) & 1)) status |= DCF77_ERR_MARKER;
+  return status;
+}
+
+/**
+ * Complete a telegram of which only the bits in known have been received.
+ * Missing markers are set, a single missing bit of a parity segment is
+ * given by the even parity, other missing bits keep their value in frame.
+ * Returns DCF77_OK or the DCF77_ERR_* bits of the completed telegram,
+ * DCF77_ERR_LENGTH if a parity segment misses more than one bit.
+ */
+int dcf77_complete_frame(uint64_t *frame, uint64_t known)
+{
+  uint64_t f      = *frame;
+  int      status = DCF77_OK;
+
+  if (!(known & 1))         f &= ~(uint64_t)1;
+  if (!((known >> 20) & 1)) f |= (uint64_t)1 << 20;
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    uint8_t first   = segments[i][0];
+    uint8_t last    = segments[i][1];
+    uint8_t missing = countBits(~known, first, last);
+    if (missing > 1) status |= DCF77_ERR_LENGTH;
+    if (missing != 1 || !(countBits(f, first, last) & 1)) continue;
+    for (uint8_t n = first; n <= last; n++)
+    {
+      if (!((known >> n) & 1)) f ^= (uint64_t)1 << n;
+    }
+  }
+  *frame = f;
+  return status | dcf77_check_frame(f);
+}
+
+/**
+ * Decode minute, hour, time zone and announcements of the telegram and
+ * check its markers and the parity of minute and hour. The date fields
+ * of time are left untouched. Returns DCF77_OK or the DCF77_ERR_* bits.
+ */
+int dcf77_decode_clock(uint64_t frame, dcf77_time *time)
+{
+  int status = DCF77_OK;
+
+  if (countBits(frame, 21, 28) & 1) status |= DCF77_ERR_MINUTE;
+  if (countBits(frame, 29, 35) & 1) status |= DCF77_ERR_HOUR;
+  if ((frame & 1) || !((frame >> 20) & 1)) status |= DCF77_ERR_MARKER;
+  switch ((frame >> 17) & 3)   // Z1 Z2
+  {
+    case 1:  time->isdst = 1;  break;  // daylight saving (MESZ)
+    case 2:  time->isdst = 0;  break;  // standard time (MEZ)
+    default: time->isdst = -1; break;  // no information available
+  }
+  time->flags  = (uint8_t)((frame >> 15) & 3) | (uint8_t)(((frame >> 19) & 1) << 2);
+  time->minute = dcf77_get_value(frame, 21, 7);
+  time->hour   = dcf77_get_value(frame, 29, 6);
+  if (time->minute > 59 || time->hour > 23) status |= DCF77_ERR_RANGE;
+  time->status = status;
+  return status;
+}
+
+/**
+ * Decode the whole time telegram into time.
+ * Returns DCF77_OK or the DCF77_ERR_* bits, also stored in time->status.
+ */
+int dcf77_decode_frame(uint64_t frame, dcf77_time *time)
+{
+  int status = dcf77_decode_clock(frame, time);
+
+  if (countBits(frame, 36, 58) & 1) status |= DCF77_ERR_DATE;
+  time->mday   = dcf77_get_value(frame, 36, 6);
+  time->wday   = dcf77_get_value(frame, 42, 3);
+  time->month  = dcf77_get_value(frame, 45, 5);
+  time->year   = dcf77_get_value(frame, 50, 8);
+  if (time->mday < 1 || time->mday > 31 || time->wday < 1 || 
+      time->month < 1 || time->month > 12 || time->year > 99)
+  {
+    status |= DCF77_ERR_RANGE;
+  }
+  time->status = status;
+  return status;
+}
+
+/**
+ * Days since 1970-01-01 of the date of a decoded time
+ */
+int32_t dcf77_day_number(const dcf77_time *time)
+{
+  // proleptic gregorian date, 2000 <= year < 2100
+  int32_t  year  = 2000 + time->year - (time->month <= 2);
+  uint16_t month = time->month + ((time->month > 2) ? -3 : 9);   // march = 0
+
+  return 365 * year + year / 4 - year / 100 + year / 400 
+       + (153 * month + 2) / 5 + time->mday - 1 - 719468;
+}
+
+/**
+ * Convert the time of day of a decoded time (MEZ or MESZ) on the 
+ * day given by its day number to seconds since 1970-01-01 UTC.
+ * Unsigned throughout, the seconds pass INT32_MAX in 2038.
+ */
+uint32_t dcf77_unix_time_days(int32_t days, const dcf77_time *time)
+{
+  uint32_t seconds = (uint32_t)days * 86400UL + time->hour * 3600UL + time->minute * 60UL;
+
+  return seconds - ((time->isdst > 0) ? 7200UL : 3600UL);
+}
+
+/**
+ * Convert a decoded time (MEZ or MESZ) to seconds since 
+ * 1970-01-01 00:00:00 UTC. Leap seconds are not counted.
+ */
+uint32_t dcf77_unix_time(const dcf77_time *time)
+{
+  return dcf77_unix_time_days(dcf77_day_number(time), time);
+}
+
+/**
+ * Convert seconds since 1970-01-01 00:00:00 UTC to MEZ (isdst = 0) 
+ * or MESZ (isdst = 1), seconds within the minute are dropped
+ */
+void dcf77_from_unix(uint32_t seconds, int8_t isdst, dcf77_time *time)
+{
+  uint32_t local = seconds + ((isdst > 0) ? 7200L : 3600L);
+  int32_t  days  = local / 86400L;
+  uint32_t sod   = local % 86400L;
+
+  // proleptic gregorian date from days since 1970-01-01, eras of 400 years
+  int32_t  z     = days + 719468L;               // days since 0000-03-01
+  int32_t  era   = z / 146097L;
+  int32_t  doe   = z - era * 146097L;            // day of era
+  int32_t  yoe   = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int32_t  doy   = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int32_t  mp    = (5 * doy + 2) / 153;
+
+  time->mday   = doy - (153 * mp + 2) / 5 + 1;
+  time->month  = (mp < 10) ? mp + 3 : mp - 9;
+  time->year   = (era * 400 + yoe + (time->month <= 2)) % 100;
+  time->wday   = (days + 3) % 7 + 1;   // 1970-01-01 was a thursday
+  time->hour   = sod / 3600;
+  time->minute = (sod / 60) % 60;
+  time->isdst  = isdst;
+  time->flags  = 0;
+  time->status = DCF77_OK;
+}
+
+/**
+ * Encode a time (MEZ or MESZ) with its announcement flags into the
+ * telegram sent during the minute before, with markers and parity.
+ * The meteo bits 1..14 are 0.
+ */
+uint64_t dcf77_encode_frame(const dcf77_time *time)
+{
+  static const uint8_t fields[6][3] = { { 21, 7, 1 }, { 29, 6, 1 }, { 36, 6, 0 }, { 42, 3, 0 }, { 45, 5, 0 }, { 50, 8, 1 } };
+  uint8_t  values[6] = { time->minute, time->hour, time->mday, time->wday, time->month, time->year };
+  uint64_t frame     = (uint64_t)1 << 20;
+  uint8_t  parity    = 0;
+
+  if (time->isdst >= 0) frame |= (uint64_t)1 << ((time->isdst > 0) ? 17 : 18);
+  frame |= (uint64_t)(time->flags & (DCF77_FLAG_CALL | DCF77_FLAG_DST)) << 15;
+  if (time->flags & DCF77_FLAG_LEAP) frame |= (uint64_t)1 << 19;
+  for (uint8_t i = 0; i < 6; i++)
+  {
+    uint8_t bcd = (uint8_t)(((values[i] / 10) << 4) | (values[i] % 10));
+    frame  |= (uint64_t)bcd << fields[i][0];
+    parity ^= countBits(bcd, 0, 7) & 1;
+    if (fields[i][2])
+    {
+      frame |= (uint64_t)parity << (fields[i][0] + fields[i][1]);
+      parity = 0;
+    }
+  }
+  return frame;
+}
+
+/**
+ * Decode a batch of telegrams into the caller owned array times.
+ * Telegrams with a wrong length, unless rebuilt from their time slots,
+ * and rejected ones are flagged with DCF77_ERR_LENGTH.
+ * Returns the number of valid telegrams.
+ */
+size_t dcf77_decode_frames(const dcf77_frame *frames, dcf77_time *times, size_t nbrFrames)
+{
+  size_t nbrValid = 0;
+
+  for (size_t i = 0; i < nbrFrames; i++)
+  {
+    int status = dcf77_decode_frame(frames[i].frame, &times[i]);
+    if ((frames[i].nbrBits != FRAMEBITS && !(frames[i].repairs & DCF77_FIX_REBUILT)) || 
+        (frames[i].repairs & DCF77_FIX_REJECTED))
+    {
+      times[i].status = status |= DCF77_ERR_LENGTH;
+    }
+    if (status == DCF77_OK) nbrValid++;
+  }
+  return nbrValid;
+}
@@ -0,0 +1,168 @@
+/**
+ * Header       DCF77Core.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Plain C interface of the DCF77 decoding logic, shared by the
+ *              class DCF77Decoder and by host programs which link it as 
+ *              libdcf77. 
+ * 
+ * Remarks      The functions allocate nothing and keep no global state. 
+ *              All state of a signal stream lives in a dcf77_ctx owned by 
+ *              the caller, so any number of streams can be decoded in 
+ *              parallel, one context per stream and thread.
+ *              Timestamps are in ms, wrap around of uint32_t is harmless.
+ *              A telegram is packed into an uint64_t, bit n holds second n.
+ *              A dcf77_slots next to the context adds the framing by time
+ *              slots: slip repair, flywheel marks and false mark rejection.
+ *              A dcf77_grid places the time slots from a time prior before
+ *              the first minute mark.
+ *              The classification thresholds are compiled into the core,
+ *              see DCF77Thresholds.h, this header exports only names
+ *              prefixed dcf77_ or DCF77_.
+ */
+
+#ifndef _DCF77Core_H_
+#define _DCF77Core_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DCF77_FRAMEBITS 59   // Number of bits in a time telegram (sec 0..58)
+
+// Events returned by dcf77_push_edge()
+#define DCF77_EV_PULSE   0   // rising edge, pulse started
+#define DCF77_EV_MINUTE  1   // rising edge after the sync gap, telegram complete
+#define DCF77_EV_BIT0    2   // falling edge of a 100 ms pulse
+#define DCF77_EV_BIT1    3   // falling edge of a 200 ms pulse
+#define DCF77_EV_GLITCH  4   // falling edge of a pulse with invalid width
+
+// Status bits returned by dcf77_check_frame() and dcf77_decode_frame()
+#define DCF77_OK          0x00
+#define DCF77_ERR_MINUTE  0x01   // parity of minute (bits 21..28) 
+#define DCF77_ERR_HOUR    0x02   // parity of hour (bits 29..35)
+#define DCF77_ERR_DATE    0x04   // parity of date (bits 36..58)
+#define DCF77_ERR_MARKER  0x08   // bit 0 is not 0 or bit 20 is not 1
+#define DCF77_ERR_RANGE   0x10   // BCD value out of range
+#define DCF77_ERR_LENGTH  0x20   // telegram has not 59 bits or misses bits
+
+// Announcement flags in dcf77_time
+#define DCF77_FLAG_CALL   0x01   // R,  bit 15: call bit, transmitter irregularity
+#define DCF77_FLAG_DST    0x02   // A1, bit 16: change MEZ/MESZ at the end of this hour
+#define DCF77_FLAG_LEAP   0x04   // A2, bit 19: leap second at the end of this hour
+
+// Repairs of the last edge in dcf77_slots, by dcf77_push_framed_edge()
+#define DCF77_FIX_FLYWHEEL  0x01   // minute mark taken where it was due, without sync gap
+#define DCF77_FIX_FALSEMARK 0x02   // sync gap of a dropped pulse within the minute ignored
+#define DCF77_FIX_SLIP      0x04   // telegram with extra or missing seconds
+#define DCF77_FIX_REBUILT   0x08   // telegram rebuilt from its time slots
+#define DCF77_FIX_REJECTED  0x10   // telegram slipped or misses bits and is not confirmed
+
+typedef struct 
+{
+  uint64_t frame;        // bits received so far, bit n holds second n
+  uint32_t startPulse;   // rising edge of the current pulse, is also end of pause
+  uint32_t endPulse;     // falling edge of the last pulse, is also start of pause
+  uint8_t  seconds;      // falling edges since the last minute mark
+  uint8_t  nbrBits;      // length of the telegram completed at the last minute mark
+  uint8_t  synchronized; // a minute mark has been seen
+  uint8_t  reserved;
+} dcf77_ctx;
+
+typedef struct
+{
+  uint64_t bits;         // bits of the running minute by time slot
+  uint64_t seen;         // slots with a valid pulse
+  uint64_t bad;          // slots with disagreeing pulses
+  uint64_t lastFrame;    // last valid telegram
+  uint64_t lastChecked;  // last telegram which passed its checks, confirmed or not
+  uint32_t lastMillis;   // rising edge of the last valid pulse
+  uint8_t  lastSlot;     // its time slot, in seconds from the minute mark
+  uint8_t  framed;       // the last minute mark gave a valid telegram
+  uint8_t  repairs;      // DCF77_FIX_* of the last edge
+  uint8_t  reserved;
+} dcf77_slots;
+
+typedef struct
+{
+  uint64_t bits;         // bits of the pulses since the first one, by second
+  uint64_t seen;         // seconds with a valid pulse
+  uint32_t firstRise;    // rising edge of the first pulse
+  uint32_t lastRise;     // rising edge of the last pulse
+  uint8_t  last;         // its second, counted from the first pulse
+  uint8_t  reserved[3];
+} dcf77_grid;
+
+typedef struct
+{
+  uint64_t frame;        // packed telegram
+  uint32_t markTime;     // timestamp of the minute mark which completed it
+  uint8_t  nbrBits;      // number of seconds counted
+  uint8_t  repairs;      // DCF77_FIX_* of dcf77_push_framed_edges(), else 0
+  uint8_t  reserved[2];
+} dcf77_frame;
+
+typedef struct
+{
+  uint8_t  minute;       // 0..59
+  uint8_t  hour;         // 0..23
+  uint8_t  mday;         // 1..31
+  uint8_t  wday;         // 1..7, Monday = 1 
+  uint8_t  month;        // 1..12
+  uint8_t  year;         // 0..99
+  int8_t   isdst;        // 1 MESZ, 0 MEZ, -1 no information
+  uint8_t  status;       // DCF77_OK or DCF77_ERR_* bits
+  uint8_t  flags;        // DCF77_FLAG_* announcements
+  uint8_t  reserved[3];
+} dcf77_time;
+
+typedef struct
+{
+  uint32_t ticks;        // tick count of the last conversion
+  uint32_t millis;       // ms at that tick count
+  uint16_t remainder;    // ticks not yet counted in millis, < ticksPerMs
+  uint16_t ticksPerMs;
+} dcf77_clock;
+
+void   dcf77_init(dcf77_ctx *ctx);
+void   dcf77_clock_init(dcf77_clock *clock, uint32_t ticks, uint32_t millis, uint16_t ticksPerMs);
+uint32_t dcf77_clock_millis(dcf77_clock *clock, uint32_t ticks);
+int    dcf77_classify_pulse(int32_t widthPulse);
+int    dcf77_push_edge(dcf77_ctx *ctx, uint32_t time, int rising);
+int    dcf77_push_bit(dcf77_ctx *ctx, uint32_t time, int bit);
+int    dcf77_mark_minute(dcf77_ctx *ctx);
+void   dcf77_slots_init(dcf77_slots *slots);
+void   dcf77_slots_resync(dcf77_slots *slots);
+uint8_t dcf77_slot_of(const dcf77_slots *slots, uint32_t rise);
+int    dcf77_push_framed_edge(dcf77_ctx *ctx, dcf77_slots *slots, uint32_t time, int rising);
+int    dcf77_push_framed_bit(dcf77_ctx *ctx, dcf77_slots *slots, uint32_t time, uint32_t rise, int bit);
+void   dcf77_classify_batch(const dcf77_ctx *ctx, const uint32_t *times, const uint8_t *levels, 
+                            size_t nbrEdges, uint8_t *events);
+size_t dcf77_find_sync_gap(const dcf77_ctx *ctx, const uint32_t *times, const uint8_t *levels, size_t nbrEdges);
+size_t dcf77_push_edges(dcf77_ctx *ctx, const uint32_t *times, const uint8_t *levels, size_t nbrEdges,
+                        dcf77_frame *frames, size_t maxFrames);
+size_t dcf77_push_framed_edges(dcf77_ctx *ctx, dcf77_slots *slots, const uint32_t *times, const uint8_t *levels,
+                               size_t nbrEdges, dcf77_frame *frames, size_t maxFrames);
+void   dcf77_grid_init(dcf77_grid *grid);
+uint8_t dcf77_grid_push(dcf77_grid *grid, uint32_t rise, int bit);
+int    dcf77_grid_lock(const dcf77_grid *grid, uint32_t firstUnix, uint16_t uncertainty, 
+                       dcf77_ctx *ctx, dcf77_slots *slots);
+uint8_t dcf77_get_value(uint64_t frame, uint8_t firstBit, uint8_t nbrBits);
+int    dcf77_check_frame(uint64_t frame);
+int    dcf77_complete_frame(uint64_t *frame, uint64_t known);
+int    dcf77_decode_clock(uint64_t frame, dcf77_time *time);
+int    dcf77_decode_frame(uint64_t frame, dcf77_time *time);
+int32_t dcf77_day_number(const dcf77_time *time);
+uint32_t dcf77_unix_time_days(int32_t days, const dcf77_time *time);
+uint32_t dcf77_unix_time(const dcf77_time *time);
+void   dcf77_from_unix(uint32_t seconds, int8_t isdst, dcf77_time *time);
+uint64_t dcf77_encode_frame(const dcf77_time *time);
+size_t dcf77_decode_frames(const dcf77_frame *frames, dcf77_time *times, size_t nbrFrames);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
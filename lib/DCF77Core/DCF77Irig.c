@@ -0,0 +1,225 @@
+/**
+ * Module       DCF77Irig.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      IRIG-B frame encoding, element sequencing and the lock of
+ *              the frames to the DCF77 seconds
+ *
+ * Remarks      Plain C99, allocation free, shared by the class DCF77IrigB
+ *              and the host model tools/dcf77irigmodel.c
+ */
+
+#include <string.h>
+#include <DCF77Irig.h>
+
+#define MIN_FRAME_US (DCF77_IRIG_ELEMENTS * (DCF77_IRIG_MARK + 250UL) * DCF77_IRIG_TICK_US)
+#define LOCK_US      1000      // output is on while the frames start this close to the second
+
+/**
+ * Reset the generator, no output until the first frame is planned
+ */
+void dcf77_irig_init(dcf77_irig *irig)
+{
+  memset(irig, 0, sizeof(*irig));
+  irig->frame[0].period = irig->frame[1].period = 10000 / DCF77_IRIG_TICK_US;
+  irig->element     = 0;         // the timer starts with element 0
+  irig->usPerSecond = 1000000UL;
+}
+
+/**
+ * Put value into nbrBits elements starting at first, LSB first
+ */
+static void putBits(dcf77_irig_frame *frame, uint8_t first, uint16_t value, uint8_t nbrBits)
+{
+  for (uint8_t i = 0; i < nbrBits; i++, value >>= 1)
+  {
+    if (value & 1) frame->bits[(first + i) >> 3] |= (uint8_t)(1 << ((first + i) & 7));
+  }
+}
+
+/**
+ * Fill the data bits of a frame with the time of its on time point,
+ * seconds since 1970 in the time scale to be sent (usually UTC).
+ * code is the x of B00x and selects the year and the straight
+ * binary seconds, the control functions are always 0.
+ */
+void dcf77_irig_encode(dcf77_irig_frame *frame, uint32_t seconds, uint8_t code)
+{
+  dcf77_time t, jan1;
+  uint32_t   sbs = seconds % 86400UL;
+  uint8_t    sec = seconds % 60;
+  uint16_t   doy;
+
+  dcf77_from_unix(seconds - 3600, 0, &t);   // MEZ of seconds - 1 h is the plain date of seconds
+  jan1       = t;
+  jan1.month = 1;
+  jan1.mday  = 1;
+  doy        = (uint16_t)(dcf77_day_number(&t) - dcf77_day_number(&jan1) + 1);
+
+  memset(frame->bits, 0, sizeof(frame->bits));
+  frame->seconds = seconds;
+  putBits(frame,  1, sec % 10, 4);
+  putBits(frame,  6, sec / 10, 3);
+  putBits(frame, 10, t.minute % 10, 4);
+  putBits(frame, 15, t.minute / 10, 3);
+  putBits(frame, 20, t.hour % 10, 4);
+  putBits(frame, 25, t.hour / 10, 2);
+  putBits(frame, 30, doy % 10, 4);
+  putBits(frame, 35, (doy / 10) % 10, 4);
+  putBits(frame, 40, doy / 100, 2);
+  if (code >= 4)
+  {
+    putBits(frame, 50, t.year % 10, 4);
+    putBits(frame, 55, t.year / 10, 4);
+  }
+  if (code == 0 || code == 3 || code == 4 || code == 7)
+  {
+    putBits(frame, 80, (uint16_t)(sbs & 0x1FF), 9);
+    putBits(frame, 90, (uint16_t)(sbs >> 9), 8);
+  }
+}
+
+/**
+ * Called at the end of the pulse of the element being sent, which
+ * started at elementStart. Returns the period of the next element
+ * and its pulse width in width, both in ticks - 1 as a timer counts.
+ * At the end of a frame the planned frame is taken, if there is none
+ * the frame is sent again with the output switched off.
+ */
+uint16_t dcf77_irig_load(dcf77_irig *irig, uint32_t elementStart, uint16_t *width)
+{
+  uint8_t e = irig->element;
+
+  if (e == 0)
+  {
+    irig->frameStart = elementStart;
+    irig->started    = 1;
+  }
+  if (++e == DCF77_IRIG_ELEMENTS)
+  {
+    e = 0;
+    if (irig->ready)
+    {
+      irig->front ^= 1;
+      irig->ready  = 0;
+    }
+    else
+    {
+      irig->frame[irig->front].enabled = 0;
+      irig->late++;
+    }
+  }
+  irig->element = e;
+
+  const dcf77_irig_frame *f = &irig->frame[irig->front];
+  if (e == 0 || e % 10 == 9)                    *width = DCF77_IRIG_MARK - 1;
+  else if ((f->bits[e >> 3] >> (e & 7)) & 1)    *width = DCF77_IRIG_ONE - 1;
+  else                                          *width = DCF77_IRIG_ZERO - 1;
+  return f->period - 1 + (e < f->extra);
+}
+
+/**
+ * Feed the local timestamp of a DCF77 second epoch. The local length
+ * of a second is measured over a baseline of up to 4000 s, epochs off
+ * the baseline are ignored unless 3 in a row agree with each other.
+ * The grid of the seconds is smoothed to keep the edge jitter out.
+ */
+void dcf77_irig_epoch(dcf77_irig *irig, uint32_t epoch)
+{
+  if (! irig->hasEpoch)
+  {
+    irig->refEpoch = irig->lastEpoch = epoch;
+    irig->baseline = 0;
+    irig->hasEpoch = 1;
+    return;
+  }
+  uint32_t span     = epoch - irig->refEpoch;
+  uint32_t n        = (span + irig->usPerSecond / 2) / irig->usPerSecond;
+  int32_t  residual = (int32_t)(span - n * irig->usPerSecond);
+
+  if (residual > 20000 || residual < -20000)
+  {
+    if (++irig->outliers < 3) return;
+    irig->refEpoch = epoch;          // the baseline itself is wrong
+    irig->baseline = 0;
+  }
+  irig->outliers = 0;
+  if (irig->baseline == 0) irig->lastEpoch = epoch;
+  else
+  { // the grid follows the epochs with a time constant of 8 s
+    uint32_t k = (epoch - irig->lastEpoch + irig->usPerSecond / 2) / irig->usPerSecond;
+    uint32_t predicted = irig->lastEpoch + k * irig->usPerSecond;
+    irig->lastEpoch = predicted + (int32_t)(epoch - predicted) / 8;
+  }
+  if (n > 4000)
+  { // keep the estimate, start a new baseline before the span overflows
+    irig->refEpoch = epoch;
+    return;
+  }
+  if (n >= 1 && (n >= irig->baseline || n >= 1000))
+  {
+    irig->usPerSecond = (span + n / 2) / n;
+    irig->baseline    = (uint16_t)n;
+  }
+}
+
+/**
+ * Distance of a local time from the nearest DCF77 second in us
+ */
+static int32_t offGrid(const dcf77_irig *irig, uint32_t t)
+{
+  uint32_t d = (t - irig->lastEpoch) % irig->usPerSecond;
+  return (d >= irig->usPerSecond / 2) ? (int32_t)(d - irig->usPerSecond) : (int32_t)d;
+}
+
+/**
+ * Called from loop() with interrupts disabled, as the interrupt writes
+ * the frame start. True once a frame has started and the following one
+ * can be planned, its start is stored in frameStart. Keep this short,
+ * the planning itself runs with interrupts enabled.
+ */
+int dcf77_irig_take(dcf77_irig *irig, uint32_t *frameStart)
+{
+  if (! irig->started || irig->ready) return 0;
+  irig->started = 0;
+  *frameStart   = irig->frameStart;
+  return 1;
+}
+
+/**
+ * Called from loop() after dcf77_irig_take() with the start of the
+ * frame being sent, the local time now and the decoded time (seconds
+ * and ms) at now, valid if the decoder has the time. The following
+ * frame is planned: its length brings the frame after it onto the DCF77
+ * second, and it carries the time of its own on time point. The
+ * interrupt does not touch that frame before it is marked ready, so 
+ * interrupts may stay enabled.
+ */
+void dcf77_irig_plan(dcf77_irig *irig, uint32_t start, uint32_t now, uint32_t seconds, uint16_t ms, uint8_t valid)
+{
+  const dcf77_irig_frame *sent = &irig->frame[irig->front];
+  dcf77_irig_frame       *next = &irig->frame[irig->front ^ 1];
+  uint32_t following = start + ((uint32_t)sent->period * DCF77_IRIG_ELEMENTS + sent->extra) * DCF77_IRIG_TICK_US;
+  int32_t  error     = 0;
+
+  if (irig->hasEpoch)
+  {
+    irig->phase = offGrid(irig, start);
+    error       = offGrid(irig, following);
+  }
+  // large errors are removed at once, small ones smoothed. A frame is
+  // stretched rather than shortened below 1 ms of rest after a marker,
+  // so the interrupt keeps its deadline.
+  int32_t length = (int32_t)irig->usPerSecond - ((error > LOCK_US || error < -LOCK_US) ? error : error / 4);
+  if (length < (int32_t)MIN_FRAME_US) length += irig->usPerSecond;
+  uint32_t ticks = (uint32_t)length / DCF77_IRIG_TICK_US;
+
+  int32_t ahead = (int32_t)(following - now) + ms * 1000L;
+  if (ahead < 0) ahead = 0;
+  dcf77_irig_encode(next, seconds + (uint32_t)(ahead + 500000L) / 1000000UL, DCF77_IRIG_CODE);
+  next->period  = (uint16_t)(ticks / DCF77_IRIG_ELEMENTS);
+  next->extra   = (uint8_t)(ticks % DCF77_IRIG_ELEMENTS);
+  next->enabled = valid && irig->hasEpoch && error <= LOCK_US && error >= -LOCK_US;
+  __asm__ __volatile__ ("" ::: "memory");   // the frame is complete before it is handed over
+  irig->ready   = 1;
+}
@@ -0,0 +1,79 @@
+/**
+ * Header       DCF77Irig.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Plain C interface of an IRIG-B timecode generator (B00x, DC
+ *              level shift) driven by the decoded DCF77 time. A frame of
+ *              100 elements of 10 ms is sent every second, each element is
+ *              a pulse of 2 ms (0), 5 ms (1) or 8 ms (position marker).
+ *
+ * Remarks      Meant for a timer in PWM mode whose period and compare value
+ *              are double buffered: dcf77_irig_load() runs in the compare
+ *              interrupt at the end of each pulse and returns the registers
+ *              of the next element. Two frames are kept, one is sent while
+ *              dcf77_irig_plan() fills the other once per second outside
+ *              the interrupt, so the interrupt only indexes a bit array.
+ *              Only dcf77_irig_take() needs interrupts disabled.
+ *              dcf77_irig_epoch() measures the local clock against the DCF77
+ *              second epochs, the frame length is corrected every second
+ *              so the on time point of a frame follows the DCF77 second.
+ *              Timestamps are local us, wrap around is harmless.
+ */
+
+#ifndef _DCF77Irig_H_
+#define _DCF77Irig_H_
+
+#include <DCF77Core.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef DCF77_IRIG_CODE
+#define DCF77_IRIG_CODE     4        // B004: BCD time of year, year, control functions, SBS
+#endif
+#define DCF77_IRIG_ELEMENTS 100      // elements per frame
+#define DCF77_IRIG_TICK_US  4        // timer tick, 16 MHz / 64
+#define DCF77_IRIG_ZERO     (2000 / DCF77_IRIG_TICK_US)   // pulse widths in ticks
+#define DCF77_IRIG_ONE      (5000 / DCF77_IRIG_TICK_US)
+#define DCF77_IRIG_MARK     (8000 / DCF77_IRIG_TICK_US)
+
+typedef struct
+{
+  uint8_t  bits[13];       // data bits, element e is bit e % 8 of byte e / 8
+  uint8_t  enabled;        // output on while this frame is sent
+  uint16_t period;         // timer ticks per element
+  uint8_t  extra;          // the first extra elements are one tick longer
+  uint8_t  reserved;
+  uint32_t seconds;        // time at the on time point, leading edge of element 0
+} dcf77_irig_frame;
+
+typedef struct
+{
+  dcf77_irig_frame  frame[2];    // frame[front] is sent, the other one is planned
+  volatile uint8_t  front;
+  volatile uint8_t  ready;       // the other frame is planned
+  volatile uint8_t  element;     // element being sent
+  volatile uint8_t  started;     // a frame started since the last plan
+  volatile uint32_t frameStart;  // leading edge of its element 0
+  volatile uint16_t late;        // frames sent twice because none was planned
+  uint32_t usPerSecond;          // local us per DCF77 second
+  uint32_t refEpoch;             // first epoch of the frequency baseline
+  uint32_t lastEpoch;            // smoothed DCF77 second epoch
+  uint16_t baseline;             // seconds behind usPerSecond
+  uint8_t  hasEpoch;
+  uint8_t  outliers;             // epochs off the baseline in a row
+  int32_t  phase;                // on time point of the frame being sent minus DCF77 second
+} dcf77_irig;
+
+void     dcf77_irig_init(dcf77_irig *irig);
+void     dcf77_irig_encode(dcf77_irig_frame *frame, uint32_t seconds, uint8_t code);
+uint16_t dcf77_irig_load(dcf77_irig *irig, uint32_t elementStart, uint16_t *width);
+void     dcf77_irig_epoch(dcf77_irig *irig, uint32_t epoch);
+int      dcf77_irig_take(dcf77_irig *irig, uint32_t *frameStart);
+void     dcf77_irig_plan(dcf77_irig *irig, uint32_t start, uint32_t now, uint32_t seconds, uint16_t ms, uint8_t valid);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
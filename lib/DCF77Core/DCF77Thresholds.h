@@ -0,0 +1,56 @@
+/**
+ * Header       DCF77Thresholds.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Pulse classification thresholds of the decoding core, 
+ *              private to the core and to the firmware of the clock. 
+ *              Host programs linking libdcf77 include DCF77Core.h only, 
+ *              which defines no unprefixed names.
+ * 
+ * Remarks      A receiver profile generated by tools/dcf77optimize.py is
+ *              selected with the build flag DCF77_PROFILE, single values
+ *              can be overridden with -D as well. The thresholds are 
+ *              compiled into the core, see tools/libdcf77.py, except in 
+ *              the tuning build with DCF77_TUNING.
+ */
+
+#ifndef _DCF77Thresholds_H_
+#define _DCF77Thresholds_H_
+
+#include <DCF77Core.h>
+
+#ifdef DCF77_TUNING
+// Host build for the threshold search of tools/dcf77optimize.py: the 
+// thresholds are variables, set with dcf77_set_thresholds(), so one 
+// library decodes every candidate. One set per process.
+extern uint32_t dcf77_thresholds[5];
+void dcf77_set_thresholds(const uint32_t *thresholds);
+#define P0          dcf77_thresholds[0]
+#define P1          dcf77_thresholds[1]
+#define JITTER      dcf77_thresholds[2]
+#define MIN_SYNCGAP dcf77_thresholds[3]
+#define MAX_SYNCGAP dcf77_thresholds[4]
+#endif
+
+#ifdef DCF77_PROFILE
+#include DCF77_PROFILE
+#endif
+
+#ifndef P0
+#define P0          100      // Pulse width of 100 ms means bit = 0
+#endif
+#ifndef P1
+#define P1          200      // Pulse width of 200 ms means bit = 1
+#endif
+#ifndef JITTER
+#define JITTER      35       // Uncertainty of measured pulse width
+#endif
+#ifndef MIN_SYNCGAP
+#define MIN_SYNCGAP 1800     // Minimal synchronization gap at sec 59 
+#endif
+#ifndef MAX_SYNCGAP
+#define MAX_SYNCGAP 1900     // Maximal synchronization gap at sec 59
+#endif
+#define FRAMEBITS   DCF77_FRAMEBITS
+
+#endif
@@ -0,0 +1,36 @@
+/**
+ * Header       DCF77Console.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Console is the serial port used by the clock and its 
+ *              libraries: Serial from the Arduino core or, with the 
+ *              build flag DCF77_LEAN_UART, LeanSerial.
+ *              consoleWriteNonBlocking() queues telemetry records
+ *              without waiting on either of them.
+ */
+
+#ifndef _DCF77Console_H_
+#define _DCF77Console_H_
+
+#ifdef DCF77_LEAN_UART
+#include <LeanUart.h>
+#define Console LeanSerial
+#else
+#include <Arduino.h>
+#define Console Serial
+#endif
+
+/**
+ * Queue a complete record or nothing, never waits.
+ * Returns false if it does not fit into the TX buffer now.
+ */
+inline bool consoleWriteNonBlocking(const uint8_t *buffer, size_t size)
+{
+  if (Console.availableForWrite() < (int)size) return false;
+#ifdef DCF77_LEAN_UART
+  return Console.writeNonBlocking(buffer, size) == size;
+#else
+  return Console.write(buffer, size) == size;
+#endif
+}
+#endif
@@ -14,153 +14,618 @@
 
 #include <DCF77Decoder.h>
 
+#ifdef DCF77_EARLY_DECISION
+#ifdef DCF77_INPUT_CAPTURE
+#error "DCF77_EARLY_DECISION needs the edges in real time, not DCF77_INPUT_CAPTURE"
+#endif
+// Timer0 compare B serves the decision windows of one decoder only: the
+// first one constructed. Further instances decide at the falling edge.
+static DCF77Decoder *sampler = nullptr;
+
+ISR(TIMER0_COMPB_vect)
+{
+  sampler->handleTick();
+}
+#endif
+
 DCF77Decoder::DCF77Decoder(int dcf77InputPin, int dcf77IndicatorPin, tm &dcf77Time) : 
   _inputPin(dcf77InputPin), _indicatorPin(dcf77IndicatorPin), _dcf77Time(dcf77Time)
 {
+  dcf77_init(&_ctx);
+  dcf77_slots_init(&_slots);
+  dcf77_grid_init(&_grid);
+#ifdef DCF77_EARLY_DECISION
+  if (sampler == nullptr) sampler = this;
+#endif
 	pinMode(_inputPin, INPUT);
 	pinMode(_indicatorPin, OUTPUT);
 }
 
 /**
- * Called when an interrupt signals a newly detected edge.
+ * Called for every edge taken from the queue filled by the interrupt 
+ * handler. The edge is timestamped in the interrupt handler, so the
+ * measured widths do not depend on the latency of loop().
  * Evaluates the measured pulse width and fills the dcf77Bits
  * with 0 and 1 accordingly.
  * A longer gap between 2 pulses is interpreted as the beginning of 
  * a new minute and the counting of seconds restarts with 0.
+ * Returns true at a minute mark which completes a telegram.
  */
-bool DCF77Decoder::collectBits()
+bool DCF77Decoder::collectBits(const Edge &edge)
 {
-  if (_newEdge) 
+  // a decision carries its rising edge, the earliest decision tick is the reference
+  uint32_t stamp   = edge.micros + ((edge.mode >= EDGE_BIT0) ? (DECISION_TICKS - 1) * 1024UL : 0);
+  uint32_t latency = micros() - stamp;
+  uint8_t  bucket  = 0;
+  if (latency > _maxLatency) _maxLatency = latency;
+  while (bucket < LATENCY_BUCKETS - 1 && latency > (64UL << bucket)) bucket++;
+  _metrics.latency[bucket]++;
+  _metrics.latencySum += latency;
+  _metrics.edges++;
+
+  int      event;
+  uint32_t rise = _ctx.startPulse;   // rising edge of the pulse
+  bool     wasSynchronized = _ctx.synchronized;
+#ifdef DCF77_EARLY_DECISION
+  // bit already decided by the sampler, its trailing edge is ignored
+  if (edge.mode == EDGE_FALLING && sampler == this) return false;
+  if (edge.mode >= EDGE_BIT0)
   {
-    _newEdge = false;
-
-    if (_edgeMode == EDGE_RISING) 
-    { // Pulse begins and pause ends
-      _startPulse = millis();
-      _widthPause = _startPulse - _endPulse;
-
-      if (_widthPause > (MIN_SYNCGAP - JITTER) && _widthPause < (MAX_SYNCGAP + JITTER)) 
-      {
-        _synchronized = true;
-        _seconds = 0;
-        _dcf77Time.tm_sec = 0;
-        return (true);
-      }
-    }
+    _startMicros = edge.micros;
+    rise  = edge.millis - DCF77_DECISION_MS;
+    event = dcf77_push_framed_bit(&_ctx, &_slots, edge.millis, rise, 
+                                  (edge.mode == EDGE_NOBIT) ? -1 : edge.mode - EDGE_BIT0);
+  }
+  else
+#endif
+  event = dcf77_push_framed_edge(&_ctx, &_slots, edge.millis, edge.mode == EDGE_RISING);
+  // the time slots have repaired the framing, see dcf77_push_framed_edge()
+  if (_slots.repairs & DCF77_FIX_FLYWHEEL)  _metrics.flywheelMarks++;
+  if (_slots.repairs & DCF77_FIX_FALSEMARK) _metrics.falseMarks++;
+  if (_slots.repairs & DCF77_FIX_SLIP)      _metrics.slips++;
+  if (_slots.repairs & DCF77_FIX_REBUILT)   _metrics.framesRecovered++;
+  if (_slots.repairs & DCF77_FIX_REJECTED)  _metrics.framesRejected++;
+  switch (event)
+  {
+    case DCF77_EV_MINUTE:
+      DCF77_TRACEPOINT(TR_MINUTE, _ctx.nbrBits);
+      _markMillis  = edge.millis;
+      _startMicros = edge.micros;
+      _dcf77Time.tm_sec = 0;
+      // the first mark after a (re)start only opens the minute, there is no telegram yet
+      if (! wasSynchronized) _next.ready = false;
+      return wasSynchronized;
+
+    case DCF77_EV_PULSE:  // Pulse begins and pause ends
+      _startMicros = edge.micros;
+      return false;
+
+    case DCF77_EV_GLITCH: // pulse too short or too long, probably interference
+      DCF77_TRACEPOINT(TR_GLITCH, _ctx.seconds);
+      _metrics.glitches++;
+      _glitchEpochs.push(_startMicros);
+      break;
 
-    if (_edgeMode == EDGE_FALLING) 
-    { // Pulse ends and pause begins
-      _endPulse = millis();
-      _widthPulse = _endPulse - _startPulse;
-      
-      if (_synchronized) 
-      { // Clock is synchronized
-        if (_widthPulse > (P0 - JITTER) && _widthPulse < (P0 + JITTER)) 
-        {
-          _dcf77Bits[_seconds] = '0';
-          if (_verbose) Serial.print(0);
-        }
-        if (_widthPulse > (P1 - JITTER) && _widthPulse < (P1 + JITTER)) 
-        {
-          _dcf77Bits[_seconds] = '1';
-          if (_verbose) Serial.print(1);
-        }
-		    digitalWrite(_indicatorPin, !digitalRead(_indicatorPin));
-        _seconds++;
-        _dcf77Time.tm_sec++;
-      }
-      else
-      {
-        // Clock is synchronizing, seconds still unknown
-        if (_verbose) Serial.print("*");
-        //if (_verbose) Serial.print(_dcf77Bits[58]);
-      }
+    default:              // a valid pulse marks the start of a second
+      DCF77_TRACEPOINT(event == DCF77_EV_BIT1 ? TR_BIT1 : TR_BIT0, _ctx.seconds);
+      _secondEpochs.push(_startMicros);
+      break;
+  }
+
+  // Pulse ends and pause begins
+  if (_ctx.synchronized) 
+  { // Clock is synchronized
+    uint8_t second = _ctx.seconds - 1;
+    if (event != DCF77_EV_GLITCH && second < FRAMEBITS)
+    {
+      _dcf77Bits[second] = (event == DCF77_EV_BIT1) ? '1' : '0';
+      if (_verbose) Console.print(_dcf77Bits[second]);
     }
+    digitalWrite(_indicatorPin, !digitalRead(_indicatorPin));
+    _dcf77Time.tm_sec++;
+  }
+  else
+  {
+    // Clock is synchronizing, seconds still unknown
+    if (_verbose) Console.print("*");
   }
+  if (_priorUnix != 0 && event != DCF77_EV_GLITCH) checkPrior(rise, event == DCF77_EV_BIT1);
   return false;	
 }
 
 /**
- * Calculate value from bcd coded bits starting 
- * at firstBit and composed of nbrBits
+ *  Check and decode the telegram of the running minute into _next,
+ *  including the time string. Called during second 59 as soon as the
+ *  missing pulse is confirmed, so only publishMinute() is left for 
+ *  the minute mark.
+ */
+void DCF77Decoder::prepareMinute()
+{
+  _next.frame  = _ctx.frame;
+  _next.status = dcf77_check_frame(_ctx.frame);
+  _next.ready  = true;
+  if (_next.status == DCF77_OK) decodeBits();
+}
+
+/**
+ *  Commit the prepared telegram at its minute mark, 
+ *  edge is the rising edge of second 0
  */
-int DCF77Decoder::getValueFromBits(int firstBit, int nbrBits)
+void DCF77Decoder::publishMinute(const Edge &edge)
 {
-  int value = 0;
-  for (int i = firstBit; i < firstBit + nbrBits; i++)
+  int status = _next.status;
+
+  // slipped and not rebuilt, or bits missing and not confirmed by the last telegram
+  if (_slots.repairs & DCF77_FIX_REJECTED) status |= DCF77_ERR_LENGTH;
+  // parity and markers are right but a value is out of range
+  else if (status == DCF77_OK && _next.decoded != DCF77_OK)
+  {
+    status |= _next.decoded;
+    _metrics.framesRejected++;
+  }
+
+  if (status == DCF77_OK)
   {
-    value += ((int)_dcf77Bits[i] - (int)'0') * _bcdValue[i - firstBit];
+    _minuteUnix   = _next.minuteUnix;
+    _minuteMillis = _ctx.startPulse;
+    _flags        = _next.flags;
+    _timeValid    = true;
+    _priorUnix    = 0;    // no longer needed
+    _z12          = _next.z12;
+    _dcf77Time    = _next.time;
+    _dateCache    = _next.date;
+    memcpy(_dcf77TimeString, _next.text, sizeof(_dcf77TimeString));
+    if (_next.cacheHit) _metrics.dateCacheHits++; else _metrics.dateCacheMisses++;
+  }
+  _next.ready = false;
+  _publishLatency = micros() - edge.micros;
+  if (_publishLatency > _maxPublishLatency) _maxPublishLatency = _publishLatency;
+
+  DCF77_TRACEPOINT(TR_CHECK, status);
+  countFrame(status);
+  if (status == DCF77_OK)
+  {
+    DCF77_TRACEPOINT(TR_PUBLISH, _dcf77Time.tm_min);
+    if (_verbose) printDateTime();
+  } 
+  else 
+  {
+    Console.println(" Parity check failed, continue collecting time info..."); 
+
+    Console.println("012345678901234567890123456789012345678901234567890123456789 ");     
+    Console.println("0--Meteo-Data--RazZA|mmmmmmmPhhhhhhPddddddwwwMMMMMyyyyyyyyP_ ");
   }
-  return value;
 }
 
 /**
- *  Decode the whole time telegram
+ *  Decode the whole time telegram into _next, the date only if it
+ *  or the time zone differs from the last published telegram. The 
+ *  cache key is the date segment with the zone bits and the DST 
+ *  announcement, a hit takes date, zone and the UTC at midnight from
+ *  the cache, a change of time zone is a miss.
+ *  The date cache and its counters are left to publishMinute(), 
+ *  a telegram prepared in vain must not change them.
  */
 void DCF77Decoder::decodeBits()
 {
-  int value = getValueFromBits(17, 2); // standard or dayligt saving time
-  if (value == 2) 
-  {
-    _z12 = value;
-    _dcf77Time.tm_isdst = 0;  // standard time (MEZ)
+  dcf77_time time;
+  Date       &date   = _next.date;
+  uint32_t   segment = ((uint32_t)(_ctx.frame >> 36) & 0x7FFFFFUL) | ((uint32_t)(_ctx.frame >> 16) & 7) << 23;
+  int        status;
+
+  date           = _dateCache;
+  _next.cacheHit = (segment == date.segment);
+  if (_next.cacheHit)
+  { // same date and zone as the last valid telegram, only the time of day is new
+    status     = dcf77_decode_clock(_ctx.frame, &time);
+    time.isdst = date.isdst;
+    time.mday  = date.mday;
+    time.wday  = date.wday;
+    time.month = date.month;
+    time.year  = date.year;
   }
-  else if (value == 1) 
+  else
   {
-    _z12 = 1;
-    _dcf77Time.tm_isdst = 1;  // daylight saving (MESZ))
+    status = dcf77_decode_frame(_ctx.frame, &time);
+    if (status == DCF77_OK)
+    {
+      date.segment  = segment;
+      date.midnight = dcf77_unix_time(&time) - time.hour * 3600UL - time.minute * 60UL;
+      date.isdst    = time.isdst;
+      date.mday     = time.mday;
+      date.wday     = time.wday;
+      date.month    = time.month;
+      date.year     = time.year;
+    }
   }
-  else
+  _next.decoded = status;
+  if (status == DCF77_OK)
   {
-    _z12 = 0;
-    _dcf77Time.tm_isdst = -1; // no information available
-  };
-  _dcf77Time.tm_sec  = 0; // Seconds are always 0
-  _dcf77Time.tm_min  = getValueFromBits(21, 7);
-  _dcf77Time.tm_hour = getValueFromBits(29, 6);
-  _dcf77Time.tm_mday = getValueFromBits(36, 6);
-  _dcf77Time.tm_wday = getValueFromBits(42, 3);
-  _dcf77Time.tm_mon  = getValueFromBits(45, 5) - 1;
-  _dcf77Time.tm_year = getValueFromBits(50, 8) + 100;
-  snprintf(_dcf77TimeString, sizeof(_dcf77TimeString), DCF77TIMEFORMAT, 
-        _weekDay[_dcf77Time.tm_wday], 
-        _dcf77Time.tm_year - 100, 
-        _dcf77Time.tm_mon + 1, 
-        _dcf77Time.tm_mday, 
-        _dcf77Time.tm_hour, 
-        _dcf77Time.tm_min, 
-        _dcf77Time.tm_sec, 
-        _timeZone[_z12]);    // time zone flags: 2 = MESZ, 1 = MEZ, 0 = no information available
+    _next.minuteUnix = date.midnight + time.hour * 3600UL + time.minute * 60UL;
+    _next.flags      = time.flags;
+  }
+  _next.z12 = setTime(time, 0, _next.time, _next.text);   // Seconds are always 0
 }
 
 /**
- *  Checks parity to verify validity of received DCF77 information
+ *  Fill a struct tm and a time string, returns the time zone index
  */
-bool DCF77Decoder::parityOK() 
+int DCF77Decoder::setTime(const dcf77_time &time, int seconds, tm &t, char *text)
 {
-  int sum = 0;
+  // time zone flags: 2 = MEZ, 1 = MESZ, 0 = no information available
+  int z12 = (time.isdst < 0) ? 0 : 2 - time.isdst;
+  t.tm_isdst = time.isdst;
+  t.tm_sec  = seconds;
+  t.tm_min  = time.minute;
+  t.tm_hour = time.hour;
+  t.tm_mday = time.mday;
+  t.tm_wday = time.wday;
+  t.tm_mon  = time.month - 1;
+  t.tm_year = time.year + 100;
+  snprintf(text, sizeof(_dcf77TimeString), DCF77TIMEFORMAT, 
+        _weekDay[t.tm_wday], 
+        t.tm_year - 100, 
+        t.tm_mon + 1, 
+        t.tm_mday, 
+        t.tm_hour, 
+        t.tm_min, 
+        t.tm_sec, 
+        _timeZone[z12]);
+  return z12;
+}
 
-  for (int i = 21; i < 29; i++) {  // parity minutes
-    sum += ((int)_dcf77Bits[i] - (int)'0');
+/**
+ * Set an approximate UTC from the host (NTP, RTC, another clock) 
+ * with its uncertainty in seconds. The pulses of the next minute
+ * are compared with the telegrams the prior predicts, see 
+ * checkPrior(). If they agree, the clock locks within that minute,
+ * before it has seen a minute mark. A prior which does not agree 
+ * is rejected.
+ */
+void DCF77Decoder::setTimePrior(uint32_t unixTime, uint16_t uncertainty)
+{
+  _priorUnix        = unixTime;
+  _priorMillis      = millis();
+  _priorUncertainty = uncertainty;
+  dcf77_grid_init(&_grid);
+}
+
+/**
+ * Forget the framing of the running telegram, e.g. after the 
+ * receiver has been powered up again: the edge timing, the time 
+ * slots, the confirmed framing and a telegram prepared for the 
+ * next minute mark. The time and the last valid telegram are kept.
+ */
+void DCF77Decoder::resync()
+{
+  dcf77_init(&_ctx);
+  dcf77_slots_resync(&_slots);
+  _next.ready = false;
+}
+
+/**
+ * Called with every valid pulse while a prior is set, rise is its
+ * rising edge. The seconds the pulses fall into are searched within 
+ * the uncertainty of the prior, see dcf77_grid_lock(). Once time zone,
+ * time and date of one minute have been received and agree with the
+ * prior, the time slots are placed and the clock locks, without waiting
+ * for a minute mark. A prior which a whole minute contradicts is rejected.
+ */
+void DCF77Decoder::checkPrior(uint32_t rise, int bit)
+{
+  dcf77_grid_push(&_grid, rise, bit);
+
+  // UTC at the first pulse according to the prior
+  int32_t  elapsed   = (int32_t)(_grid.firstRise - _priorMillis);
+  uint32_t firstUnix = _priorUnix + (elapsed + ((elapsed < 0) ? -500L : 500L)) / 1000L;
+  int      matches   = dcf77_grid_lock(&_grid, firstUnix, _priorUncertainty, &_ctx, &_slots);
+
+  if (matches == 0)
+  {
+    _priorUnix = 0;      // telegram contradicts the prior
+    _metrics.priorsRejected++;
+    return;
   }
+  if (matches != 1) return;   // not enough pulses yet or ambiguous
 
-  for (int i = 29; i < 36; i++) {  // parity hours
-    sum += ((int)_dcf77Bits[i] - (int)'0');
+  dcf77_time time;
+  dcf77_decode_frame(_ctx.frame, &time);   // announces the coming minute
+  _metrics.priorsAccepted++;
+  _markMillis   = _slots.lastMillis - _slots.lastSlot * 1000UL;
+  _minuteUnix   = dcf77_unix_time(&time) - 60;
+  _minuteMillis = _markMillis;
+  _flags        = time.flags;
+  _timeValid    = true;
+  _priorUnix    = 0;
+  _next.ready   = false;
+  dcf77_from_unix(_minuteUnix, time.isdst, &time);
+  _z12 = setTime(time, _ctx.seconds, _dcf77Time, _dcf77TimeString);
+  DCF77_TRACEPOINT(TR_PUBLISH, time.minute);
+  if (_verbose) 
+  {
+    Console.print(" ");
+    printDateTime();
   }
+}
 
-  for (int i = 36; i < 59; i++) {  // parity date
-    sum += ((int)_dcf77Bits[i] - (int)'0');
+/**
+ *  Count the result of the checks of a completed telegram
+ */
+void DCF77Decoder::countFrame(int status)
+{
+  if (status == DCF77_OK) 
+  {
+    _metrics.framesOK++;
+    return;
   }
-  return ((sum % 2) == 0) ? true : false;
+  _metrics.framesFailed++;
+  if (status & DCF77_ERR_MINUTE) _metrics.parityMinute++;
+  if (status & DCF77_ERR_HOUR)   _metrics.parityHour++;
+  if (status & DCF77_ERR_DATE)   _metrics.parityDate++;
+  if (status & DCF77_ERR_MARKER) _metrics.markerErrors++;
 }
 
 /**
- *  Interrupt handler detects rising or falling edge of received pulse
+ * Enables the external interrupt of the input pin on any change,
+ * INT0 on pin 2 or INT1 on pin 3. The vector is defined with
+ * DCF77_DECODER_VECTOR, attachInterrupt() of the core is not used.
  */
-void DCF77Decoder::handleInterrupt()
+void DCF77Decoder::attach()
 {
-	_edgeMode = digitalRead(_inputPin);
-	_newEdge = true;
+  uint8_t irq  = digitalPinToInterrupt(_inputPin);
+  uint8_t sreg = SREG;
+
+  if (irq > 1) return;          // no external interrupt on this pin
+  cli();
+  EICRA = (EICRA & ~((_BV(ISC01) | _BV(ISC00)) << 2 * irq)) | (_BV(ISC00) << 2 * irq);   // any change
+  EIFR  = _BV(INTF0) << irq;    // forget an edge flagged before
+  EIMSK |= _BV(INT0) << irq;
+  SREG  = sreg;
+}
+
+/**
+ * Feeds an edge into the decoder. Called by the interrupt 
+ * handler or by any other signal source like the simulator.
+ */
+void DCF77Decoder::handleEdge(int edgeMode)
+{
+  handleEdge(edgeMode, millis(), micros());
+}
+
+/**
+ * Feeds an edge which has already been timestamped, 
+ * e.g. by the input capture unit of a timer.
+ */
+void DCF77Decoder::handleEdge(int edgeMode, uint32_t edgeMillis, uint32_t edgeMicros)
+{
+  Edge edge = { edgeMillis, edgeMicros, (uint8_t)edgeMode };
+#ifdef DCF77_EARLY_DECISION
+  _level = edgeMode;
+  if (edgeMode == EDGE_RISING) openWindow(edgeMillis, edgeMicros);
+#endif
+  if (! _edges.push(edge)) 
+  {
+    _overruns++;
+    DCF77_TRACEPOINT(TR_OVERRUN, _overruns);
+    return;
+  }
+  DCF77_TRACEPOINT(edgeMode == EDGE_RISING ? TR_RISING : TR_FALLING, _edges.size());
+}
+
+#ifdef DCF77_EARLY_DECISION
+/**
+ * Called by handleEdge() for a rising edge. Opens the decision window
+ * unless one is running or the edge is trailing noise in the pause of 
+ * the last pulse. A window which saw only a short glitch so far is 
+ * restarted by the next rising edge. Only the decoder owning Timer0 
+ * compare B opens windows.
+ */
+void DCF77Decoder::openWindow(uint32_t edgeMillis, uint32_t edgeMicros)
+{
+  if (sampler != this) return;
+  if (_windowTicks ? (_highTicks >= (P0 - JITTER) / 2) : (edgeMillis - _windowMillis < 1000 - 2 * JITTER)) return;
+  _windowMillis = edgeMillis;
+  _windowMicros = edgeMicros;
+  _highTicks    = 0;
+  _windowTicks  = 1;
+  TIFR0   = _BV(OCF0B);
+  TIMSK0 |= _BV(OCIE0B);
+}
+
+/**
+ * Called by the Timer0 compare B interrupt every 1.024 ms while a 
+ * decision window is open. Integrates the line level and classifies
+ * the pulse at the decision point, independent of its falling edge.
+ * A 1 pulse is still high at the decision point, so its width cannot 
+ * be checked against P1 +- JITTER: a high time of P0 +- JITTER is a 0, 
+ * one of at least (P0 + JITTER + DCF77_DECISION_MS) / 2 is a 1, 
+ * anything else is no bit.
+ */
+void DCF77Decoder::handleTick()
+{
+  _highTicks += _level;
+  if (++_windowTicks <= DECISION_TICKS) return;
+
+  uint16_t highMs = _highTicks * 1024UL / 1000;
+  uint8_t  mode   = (highMs < P0 - JITTER) ? EDGE_NOBIT 
+                  : (highMs <= P0 + JITTER) ? EDGE_BIT0
+                  : (highMs >= (P0 + JITTER + DCF77_DECISION_MS) / 2) ? EDGE_BIT1 : EDGE_NOBIT;
+  Edge     edge   = { _windowMillis + DCF77_DECISION_MS, _windowMicros, mode };
+
+  TIMSK0 &= ~_BV(OCIE0B);
+  _windowTicks = 0;
+  if (! _edges.push(edge)) _overruns++;
+}
+#endif
+
+/**
+ * True while edges are waiting to be processed by loop()
+ */
+bool DCF77Decoder::hasPendingEdges()
+{
+  return ! _edges.isEmpty();
+}
+
+/**
+ * Number of edges lost because the queue was full
+ */
+uint16_t DCF77Decoder::getOverruns()
+{
+  return _overruns;
+}
+
+/**
+ * Most edges found waiting in the queue by loop()
+ */
+uint8_t DCF77Decoder::getEdgePeak()
+{
+  return _edges.getPeak();
+}
+
+/**
+ * Returns true once for every valid second pulse and 
+ * delivers the micros() timestamp of its rising edge.
+ * The epochs are queued, call it until it returns false, 
+ * a single loop() may have decoded several pulses.
+ */
+bool DCF77Decoder::getSecondEpoch(uint32_t &epoch)
+{
+  return _secondEpochs.pop(epoch);
+}
+
+/**
+ * Returns true once for every rejected pulse and 
+ * delivers the micros() timestamp of its rising edge.
+ * Queued like the second epochs, bursts are kept.
+ */
+bool DCF77Decoder::getGlitchEpoch(uint32_t &epoch)
+{
+  return _glitchEpochs.pop(epoch);
+}
+
+/**
+ * Current UTC as seconds since 1970 and milliseconds, extrapolated
+ * from the minute mark of the last valid telegram.
+ * Returns false as long as no valid telegram has been received.
+ */
+bool DCF77Decoder::getUnixTime(uint32_t &seconds, uint16_t &ms)
+{
+  if (! _timeValid) return false;
+  uint32_t elapsed = millis() - _minuteMillis;
+  seconds = _minuteUnix + elapsed / 1000;
+  ms      = elapsed % 1000;
+  return true;
+}
+
+/**
+ * Seconds since the minute mark of the last valid 
+ * telegram, 0xFFFFFFFF if there was none
+ */
+uint32_t DCF77Decoder::getHoldover()
+{
+  return _timeValid ? (millis() - _minuteMillis) / 1000 : 0xFFFFFFFF;
+}
+
+/**
+ * Announcement flags DCF77_FLAG_* of the last valid telegram
+ */
+uint8_t DCF77Decoder::getFlags()
+{
+  return _flags;
+}
+
+/**
+ * Longest delay in us between the interrupt handler 
+ * stamping an edge and loop() processing it
+ */
+uint32_t DCF77Decoder::getMaxLatency()
+{
+  return _maxLatency;
+}
+
+/**
+ * Delay in us from the minute mark to the published 
+ * time, of the last minute and the longest so far
+ */
+uint32_t DCF77Decoder::getPublishLatency(uint32_t &maxLatency)
+{
+  maxLatency = _maxPublishLatency;
+  return _publishLatency;
+}
+
+/**
+ * True while the last valid telegram is 
+ * younger than MAX_LOCKAGE seconds
+ */
+bool DCF77Decoder::isLocked()
+{
+  return getHoldover() < MAX_LOCKAGE;
+}
+
+/**
+ * Print one metric in Prometheus text format
+ */
+static void printMetric(const __FlashStringHelper *name, const __FlashStringHelper *type, uint32_t value)
+{
+  Console.print(F("# TYPE ")); Console.print(name); Console.print(' '); Console.print(type); Console.print('\n');
+  Console.print(name); Console.print(' '); Console.print(value); Console.print('\n');
+}
+
+/**
+ * Print one sample of a labeled metric in Prometheus text format
+ */
+static void printSample(const __FlashStringHelper *name, const __FlashStringHelper *label, uint32_t value)
+{
+  Console.print(name); Console.print('{'); Console.print(label); Console.print(F("} ")); Console.print(value); Console.print('\n');
+}
+
+/**
+ * Print all counters and gauges in Prometheus text exposition 
+ * format, ready to be scraped by a host through the serial line.
+ * Lines end with \n only, the format does not allow the \r\n 
+ * of println()
+ */
+void DCF77Decoder::printMetrics()
+{
+  uint32_t holdover   = getHoldover();
+  uint32_t cumulative = 0;
+
+  printMetric(F("dcf77_edges_total"),         F("counter"), _metrics.edges);
+  printMetric(F("dcf77_glitches_total"),      F("counter"), _metrics.glitches);
+  printMetric(F("dcf77_edge_overruns_total"), F("counter"), _overruns);
+  printMetric(F("dcf77_frames_ok_total"),     F("counter"), _metrics.framesOK);
+  printMetric(F("dcf77_frames_failed_total"), F("counter"), _metrics.framesFailed);
+  printMetric(F("dcf77_frames_recovered_total"), F("counter"), _metrics.framesRecovered);
+  printMetric(F("dcf77_frames_rejected_total"), F("counter"), _metrics.framesRejected);
+  printMetric(F("dcf77_slips_total"),         F("counter"), _metrics.slips);
+  printMetric(F("dcf77_flywheel_marks_total"), F("counter"), _metrics.flywheelMarks);
+  printMetric(F("dcf77_false_marks_total"),   F("counter"), _metrics.falseMarks);
+  Console.print(F("# TYPE dcf77_check_errors_total counter\n"));
+  printSample(F("dcf77_check_errors_total"), F("check=\"minute_parity\""), _metrics.parityMinute);
+  printSample(F("dcf77_check_errors_total"), F("check=\"hour_parity\""),   _metrics.parityHour);
+  printSample(F("dcf77_check_errors_total"), F("check=\"date_parity\""),   _metrics.parityDate);
+  printSample(F("dcf77_check_errors_total"), F("check=\"marker\""),        _metrics.markerErrors);
+  Console.print(F("# TYPE dcf77_time_priors_total counter\n"));
+  printSample(F("dcf77_time_priors_total"), F("result=\"accepted\""), _metrics.priorsAccepted);
+  printSample(F("dcf77_time_priors_total"), F("result=\"rejected\""), _metrics.priorsRejected);
+  Console.print(F("# TYPE dcf77_date_cache_total counter\n"));
+  printSample(F("dcf77_date_cache_total"), F("result=\"hit\""),  _metrics.dateCacheHits);
+  printSample(F("dcf77_date_cache_total"), F("result=\"miss\""), _metrics.dateCacheMisses);
+  printMetric(F("dcf77_locked"),              F("gauge"),   isLocked() ? 1 : 0);
+  printMetric(F("dcf77_holdover_seconds"),    F("gauge"),   _timeValid ? holdover : 0);
+
+  Console.print(F("# TYPE dcf77_edge_latency_microseconds histogram\n"));
+  for (uint8_t i = 0; i < LATENCY_BUCKETS; i++)
+  {
+    cumulative += _metrics.latency[i];
+    Console.print(F("dcf77_edge_latency_microseconds_bucket{le=\""));
+    if (i < LATENCY_BUCKETS - 1) Console.print(64UL << i); else Console.print(F("+Inf"));
+    Console.print(F("\"} ")); Console.print(cumulative); Console.print('\n');
+  }
+  Console.print(F("dcf77_edge_latency_microseconds_sum "));   Console.print(_metrics.latencySum); Console.print('\n');
+  Console.print(F("dcf77_edge_latency_microseconds_count ")); Console.print(cumulative); Console.print('\n');
+  printMetric(F("dcf77_publish_latency_microseconds"),     F("gauge"), _publishLatency);
+  printMetric(F("dcf77_publish_latency_max_microseconds"), F("gauge"), _maxPublishLatency);
 }
 
 /**
@@ -169,7 +634,7 @@ void DCF77Decoder::handleInterrupt()
  */
 void DCF77Decoder::printDateTime()
 {
-  Serial.println(_dcf77TimeString);  
+  Console.println(_dcf77TimeString);  
 }
 
 /**
@@ -183,29 +648,27 @@ void DCF77Decoder::setVerbose(bool verbose)
 
 /**
  * The time telegram has been received completely if the
- * last character in the initial string is no longer 'P'.
+ * last character in the initial string is no longer 'P',
+ * or the time has been confirmed early with a time prior.
  */
 bool DCF77Decoder::isReady()
 {
-  return (_dcf77Bits[58] == 'P') ? false : true;
+  return (_dcf77Bits[58] == 'P' && ! _timeValid) ? false : true;
 }
 
 void DCF77Decoder::loop()
 {
-  if (collectBits() == true)
-  {
-    if (parityOK())
-    {
-      decodeBits();
-      if (_verbose) printDateTime();
-    } 
-    else 
-    {
-      Serial.println(" Parity check failed, continue collecting time info..."); 
+  Edge edge;
 
-      Serial.println("012345678901234567890123456789012345678901234567890123456789 ");     
-      Serial.println("0--Meteo-Data--RazZA|mmmmmmmPhhhhhhPddddddwwwMMMMMyyyyyyyyP_ ");
-                     
-    }
+  _edges.notePeak();
+  while (_edges.pop(edge))
+  {
+    if (collectBits(edge) == false) continue;
+    // prepared in second 59 unless the telegram changed since or loop() was late
+    if (! _next.ready || _next.frame != _ctx.frame) prepareMinute();
+    publishMinute(edge);
   }
+  // all bits are in and the pulse of second 59 is missing: the next edge is the minute mark
+  if (_ctx.synchronized && _ctx.seconds == FRAMEBITS && ! _next.ready &&
+      millis() - _ctx.startPulse > 1000 + JITTER) prepareMinute();
 }
\ No newline at end of file
@@ -12,17 +12,31 @@
  */
 
 #include <Arduino.h>
+#include <DCF77Console.h>
 #include <time.h>
+#include <DCF77Core.h>
+#include <DCF77Thresholds.h>
+#include <SpscQueue.h>
+#include <DCF77Trace.h>
 #ifndef _DCF77Decoder_H_
 #define _DCF77Decoder_H_
 
 #define EDGE_RISING  HIGH
 #define EDGE_FALLING LOW
-#define P0          100      // Pulse width of 100 ms means bit = 0
-#define P1          200      // Pulse width of 200 ms means bit = 1
-#define JITTER      35       // Uncertainty of measured pulse width
-#define MIN_SYNCGAP 1800     // Minimal synchronization gap at sec 59 
-#define MAX_SYNCGAP 1900     // Maximal synchronization gap at sec 59
+#define EDGE_BIT0    2        // pulse classified at the decision point, see DCF77_EARLY_DECISION
+#define EDGE_BIT1    3
+#define EDGE_NOBIT   4        // too little signal in the decision window
+#ifndef DCF77_DECISION_MS
+#define DCF77_DECISION_MS 150 // decision point after the rising edge [ms]
+#endif
+#if DCF77_DECISION_MS <= P0 + JITTER || DCF77_DECISION_MS >= P1 - JITTER
+#error "DCF77_DECISION_MS must lie between the widths of a 0 and a 1 pulse"
+#endif
+#define DECISION_TICKS (DCF77_DECISION_MS * 1000L / 1024)   // Timer0 compare B ticks of 1.024 ms
+#define EDGE_QUEUE   8        // queued edges between interrupt and loop(), power of 2
+#define EPOCH_QUEUE  8        // second and glitch epochs of one drain of the edge queue, power of 2
+#define LATENCY_BUCKETS 8     // latency histogram, upper bounds 64 us .. 4096 us and +Inf
+#define MAX_LOCKAGE  120      // locked while the last valid telegram is younger [sec]
 #define DCF77TIMEFORMAT "%3s 20%02d-%02d-%02d %02d:%02d:%02d %4s DCF77"
 
 /*
@@ -51,33 +65,129 @@
   }
 */
 
+// Interrupt vector of a decoder, INT0_vect for pin 2 or INT1_vect for pin 3,
+// one line at file scope per instance: DCF77_DECODER_VECTOR(INT0_vect, myDCF77)
+// The vector calls the handler of the instance without function pointer,
+// attachInterrupt() of the core must not be used for the same interrupt.
+#define DCF77_DECODER_VECTOR(vector, decoder) ISR(vector) { DCF77Decoder::isr<decoder>(); }
+
 class DCF77Decoder
 {
   public:
     DCF77Decoder(int dcf77InputPin, int dcf77IndicatorPin, tm &dcf77Time);
     void loop();
-    void handleInterrupt();
+    // Interrupt handler detects rising or falling edge of received pulse
+    void handleInterrupt() { handleEdge(digitalRead(_inputPin), millis(), micros()); }
+    // Interrupt entry of one decoder instance, generated at compile time.
+    // The instance is a template argument, so its handler is called directly,
+    // DCF77_DECODER_VECTOR makes it the body of the interrupt vector.
+    template<DCF77Decoder &decoder> static void isr() { decoder.handleInterrupt(); }
+    // Enable the external interrupt of the input pin, INT0 or INT1
+    void attach();
+    void handleEdge(int edgeMode);
+    void handleEdge(int edgeMode, uint32_t edgeMillis, uint32_t edgeMicros);
     void printDateTime();
     void setVerbose(bool verbose);
     bool isReady();
+    bool getSecondEpoch(uint32_t &epoch);
+    bool getGlitchEpoch(uint32_t &epoch);
+    bool getUnixTime(uint32_t &seconds, uint16_t &ms);
+    uint32_t getHoldover();
+    uint8_t  getFlags();
+    uint32_t getMaxLatency();
+    uint32_t getPublishLatency(uint32_t &maxLatency);
+    uint16_t getOverruns();
+    uint8_t  getEdgePeak();
+    bool hasPendingEdges();
+    bool isLocked();
+    void setTimePrior(uint32_t unixTime, uint16_t uncertainty);
+    void resync();
+    void printMetrics();
+    void handleTick();
 
   private:
-    bool collectBits();
-  	int  getValueFromBits(int firstbit, int nbrBits);
+    typedef struct { uint32_t millis; uint32_t micros; uint8_t mode; } Edge;
+    bool collectBits(const Edge &edge);
+    void prepareMinute();
+    void publishMinute(const Edge &edge);
     void decodeBits();
-	  bool parityOK();
+    int  setTime(const dcf77_time &time, int seconds, tm &t, char *text);
+    void checkPrior(uint32_t rise, int bit);
+    void countFrame(int status);
+    void openWindow(uint32_t edgeMillis, uint32_t edgeMicros);
     volatile int  _inputPin;
-	  volatile int  _edgeMode = -1;    // value set by interrupt handler, 0 falling, 1 rising
-	  volatile bool _newEdge = false;  // value set by interrupt handler
-	  uint32_t   _startPulse = 0;      // is also end of pause
-	  uint32_t   _endPulse = 0;        // is also start of pause
+	  SpscQueue<Edge, EDGE_QUEUE> _edges; // filled by interrupt handler
+	  volatile uint16_t _overruns = 0; // edges lost because the queue was full
+	  uint32_t   _maxLatency = 0;      // longest delay from interrupt to loop() in us
+#ifdef DCF77_EARLY_DECISION
+	  volatile uint8_t _level = 0;     // line level after the last edge
+	  volatile uint8_t _windowTicks = 0;  // ticks of the running decision window, 0 = none
+	  volatile uint8_t _highTicks = 0; // ticks with high level in the window
+	  uint32_t   _windowMillis = 0;    // rising edge which opened the window
+	  uint32_t   _windowMicros = 0;
+#endif
+	  struct                           // counters, only updated in loop()
+	  {
+	    uint32_t edges;
+	    uint32_t glitches;
+	    uint32_t framesOK;
+	    uint32_t framesFailed;
+	    uint16_t parityMinute;
+	    uint16_t parityHour;
+	    uint16_t parityDate;
+	    uint16_t markerErrors;
+	    uint16_t priorsAccepted;
+	    uint16_t priorsRejected;
+	    uint16_t dateCacheHits;
+	    uint16_t dateCacheMisses;
+	    uint16_t slips;                // telegrams with extra or missing seconds
+	    uint16_t framesRecovered;      // telegrams rebuilt from their time slots
+	    uint16_t framesRejected;       // not confirmed or out of range
+	    uint16_t flywheelMarks;        // minute marks found without sync gap
+	    uint16_t falseMarks;           // sync gaps from dropped pulses
+	    uint32_t latency[LATENCY_BUCKETS];
+	    uint32_t latencySum;           // in us
+	  } _metrics = {};
+	  uint32_t   _startMicros = 0;     // rising edge of the current pulse in us
+	  SpscQueue<uint32_t, EPOCH_QUEUE> _secondEpochs;  // rising edges of valid pulses in us
+	  SpscQueue<uint32_t, EPOCH_QUEUE> _glitchEpochs;  // rising edges of rejected pulses in us
 	  int        _indicatorPin;
-	  int        _widthPulse = 0;
-	  int        _widthPause = 0;
-	  int 	     _bcdValue[8] = {1, 2, 4, 8, 10, 20, 40, 80};
-	  bool       _synchronized = false;
+	  dcf77_ctx  _ctx;                 // edge timing and packed telegram
+	  uint32_t   _minuteUnix = 0;      // UTC of the last valid telegram
+	  uint32_t   _minuteMillis = 0;    // millis() at its minute mark
+	  bool       _timeValid = false;
+	  uint32_t   _markMillis = 0;      // millis() at the last minute mark
+	  dcf77_slots _slots;              // framing of the running minute by time slots
+	  uint32_t   _priorUnix = 0;       // UTC from the host, 0 = no prior
+	  uint32_t   _priorMillis = 0;     // millis() when the prior was set
+	  uint16_t   _priorUncertainty = 0;  // in seconds
+	  dcf77_grid _grid;                // pulses checked against the prior
+	  uint8_t    _flags = 0;           // DCF77_FLAG_* of the last valid telegram
+	  typedef struct                   // date and time zone of a valid telegram
+	  {
+	    uint32_t segment;              // bits 36..58, above A1 Z1 Z2 (16..18), 0 = empty
+	    uint32_t midnight;             // UTC at 00:00 of the date in its time zone
+	    int8_t   isdst;
+	    uint8_t  mday, wday, month, year;
+	  } Date;
+	  struct                           // telegram decoded ahead of its minute mark
+	  {
+	    uint64_t frame;                // bits it has been decoded from
+	    int      status;               // DCF77_OK or DCF77_ERR_* of the checks
+	    int      decoded;              // DCF77_OK or DCF77_ERR_* of the decoding
+	    bool     ready;
+	    uint32_t minuteUnix;           // UTC at the minute mark
+	    uint8_t  flags;
+	    int      z12;
+	    tm       time;
+	    char     text[40];
+	    Date     date;                 // date cache once this telegram is published
+	    bool     cacheHit;             // the date was taken from the cache
+	  } _next = {};
+	  uint32_t   _publishLatency = 0;  // minute mark to published time in us
+	  uint32_t   _maxPublishLatency = 0;
+	  Date       _dateCache = {};      // date of the last published telegram
 	  bool       _verbose = true;
-	  int        _seconds = 0;
 	  int        _z12 = 0; // 0 = no information available, 1 = MESZ, 2 = MEZ
   	//                           0        10        20        30        40        50        60
     //                          "0....:....:....:....:....:....:....:....:....:....:....:....:"
@@ -0,0 +1,38 @@
+/**
+ * Class        DCF77Trace.cpp
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Circular trace buffer of the decoder tracepoints
+ * 
+ * Board        Arduino Uno R3
+ */
+
+#include <DCF77Trace.h>
+#ifdef DCF77_TRACE
+
+DCF77Trace dcf77Trace;
+
+/**
+ * Print the buffered events, oldest first, and clear the buffer.
+ * Events recorded while dumping may overwrite not yet printed ones.
+ */
+void DCF77Trace::dump()
+{
+  uint8_t head = _head;
+
+  Console.println(F("TRACE BEGIN"));
+  for (uint8_t i = 0; i < DCF77_TRACE_EVENTS; i++)
+  {
+    Event &slot = _events[(head + i) & (DCF77_TRACE_EVENTS - 1)];
+    noInterrupts();
+    Event e = slot;
+    slot.id = 0;
+    interrupts();
+    if (e.id == 0) continue;   // never written or already dumped
+    Console.print(F("T ")); Console.print(e.ticks);
+    Console.print(' ');     Console.print(e.id);
+    Console.print(' ');     Console.println(e.arg);
+  }
+  Console.println(F("TRACE END"));
+}
+#endif
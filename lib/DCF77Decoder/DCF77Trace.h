@@ -0,0 +1,66 @@
+/**
+ * Header       DCF77Trace.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Compile time tracepoints for the decoder. Each tracepoint 
+ *              writes an event id, one byte argument and the Timer0 tick 
+ *              count (4 us) into a circular buffer in RAM, which is 
+ *              dumped over serial on demand and converted to a 
+ *              Chrome/Perfetto trace by tools/dcf77trace.py.
+ *              
+ * Remarks      Enabled with the build flag DCF77_TRACE, otherwise the 
+ *              tracepoints compile to nothing. A tracepoint costs a few
+ *              cycles, it reads the tick count like micros() does, but 
+ *              without correcting a pending Timer0 overflow.
+ *              Dump format, one event per line: T <ticks> <id> <arg>
+ */
+
+#include <Arduino.h>
+#include <DCF77Console.h>
+#ifndef _DCF77Trace_H_
+#define _DCF77Trace_H_
+
+#ifndef DCF77_TRACE_EVENTS
+#define DCF77_TRACE_EVENTS 32   // buffered events, power of 2, 6 bytes each
+#endif
+
+// Event ids, keep in sync with tools/dcf77trace.py
+#define TR_RISING   1   // arg: edge queue size
+#define TR_FALLING  2   // arg: edge queue size
+#define TR_BIT0     3   // arg: seconds counted
+#define TR_BIT1     4   // arg: seconds counted
+#define TR_GLITCH   5   // arg: seconds counted
+#define TR_MINUTE   6   // arg: number of seconds counted
+#define TR_CHECK    7   // arg: DCF77_OK or DCF77_ERR_* bits
+#define TR_PUBLISH  8   // arg: minute of the published time
+#define TR_OVERRUN  9   // arg: low byte of the overrun counter
+
+#ifdef DCF77_TRACE
+extern "C" volatile unsigned long timer0_overflow_count;   // Arduino core, wiring.c
+
+class DCF77Trace
+{
+  public:
+    inline void record(uint8_t id, uint8_t arg)
+    {
+      uint8_t sreg = SREG;
+      cli();
+      Event &e = _events[_head++ & (DCF77_TRACE_EVENTS - 1)];
+      e.id    = id;
+      e.arg   = arg;
+      e.ticks = (timer0_overflow_count << 8) | TCNT0;
+      SREG = sreg;
+    }
+    void dump();
+
+  private:
+    typedef struct { uint8_t id; uint8_t arg; uint32_t ticks; } Event;
+    Event   _events[DCF77_TRACE_EVENTS];
+    uint8_t _head = 0;
+};
+extern DCF77Trace dcf77Trace;
+#define DCF77_TRACEPOINT(id, arg) dcf77Trace.record((id), (arg))
+#else
+#define DCF77_TRACEPOINT(id, arg) ((void)0)
+#endif
+#endif
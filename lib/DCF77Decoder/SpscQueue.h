@@ -0,0 +1,79 @@
+/**
+ * Header       SpscQueue.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Lock free single producer single consumer ring buffer
+ *              to hand items from an interrupt handler to loop().
+ *              The producer only writes _head, the consumer only writes 
+ *              _tail, both are single bytes and therefore atomic on AVR.
+ *              A compiler barrier makes sure an item is completely 
+ *              written before its index is published.
+ *              notePeak() keeps the highest fill level for sizing the
+ *              queue, it is called from loop() only, so the interrupt
+ *              side pays nothing for it.
+ * 
+ * Template
+ * arguments    T   type of the items, copied by value
+ *              N   capacity + 1, must be a power of 2 (max. 128)
+ */
+
+#include <stdint.h>
+#ifndef _SpscQueue_H_
+#define _SpscQueue_H_
+
+template <typename T, uint8_t N>
+class SpscQueue
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of 2");
+
+  public:
+    // Called by the producer, returns false if the queue is full
+    bool push(const T &item)
+    {
+      uint8_t head = _head;
+      uint8_t next = (head + 1) & (N - 1);
+      if (next == _tail) return false;
+      _items[head] = item;
+      __asm__ __volatile__ ("" ::: "memory");
+      _head = next;
+      return true;
+    }
+
+    // Called by the consumer, returns false if the queue is empty
+    bool pop(T &item)
+    {
+      uint8_t tail = _tail;
+      if (tail == _head) return false;
+      __asm__ __volatile__ ("" ::: "memory");
+      item = _items[tail];
+      __asm__ __volatile__ ("" ::: "memory");
+      _tail = (tail + 1) & (N - 1);
+      return true;
+    }
+
+    // Called by the consumer, returns false if the queue is empty
+    bool peek(T &item)
+    {
+      uint8_t tail = _tail;
+      if (tail == _head) return false;
+      __asm__ __volatile__ ("" ::: "memory");
+      item = _items[tail];
+      return true;
+    }
+
+    bool isEmpty() { return _head == _tail; }
+    bool isFull() { return ((_head + 1) & (N - 1)) == _tail; }
+    uint8_t size() { return (_head - _tail) & (N - 1); }
+
+    // Called by the side running in loop(), the consumer before it
+    // drains the queue or the producer after it filled it
+    void notePeak() { uint8_t n = size(); if (n > _peak) _peak = n; }
+    uint8_t getPeak() { return _peak; }
+
+  private:
+    T                _items[N];
+    volatile uint8_t _head = 0;
+    volatile uint8_t _tail = 0;
+    uint8_t          _peak = 0;   // highest fill level seen by notePeak()
+};
+#endif
@@ -0,0 +1,272 @@
+/**
+ * Class        DCF77DutyCycle.cpp
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Switches the receiver on for a window every period, hands 
+ *              the flywheel time to the decoder as prior, sleeps in power
+ *              down in between and keeps the statistics of acquisition 
+ *              time, flywheel error and energy
+ * 
+ * Board        Arduino Uno R3
+ * 
+ * Remarks      Uses the watchdog interrupt and the pin change interrupt
+ *              of RX (PCINT16) with DCF77_POWER_DOWN
+ */
+
+#include <DCF77DutyCycle.h>
+#ifdef DCF77_POWER_DOWN
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include <util/atomic.h>
+
+extern "C" volatile unsigned long timer0_millis, timer0_overflow_count;   // Arduino core, wiring.c
+
+static volatile bool     wdtFired = false;   // the watchdog period is over
+static volatile uint32_t wdtMicros = 0;      // micros() when it was over
+static volatile bool     rxActive = false;   // the console has sent something
+
+// WDTCSR prescaler bits for 0.5 s * 2^prescaler
+static const uint8_t wdtBits[] = 
+{ 
+  _BV(WDP2) | _BV(WDP0), _BV(WDP2) | _BV(WDP1), _BV(WDP2) | _BV(WDP1) | _BV(WDP0), _BV(WDP3), _BV(WDP3) | _BV(WDP0)
+};
+#define WDT_MAX_PRESCALER 4   // 8 s
+
+ISR(WDT_vect)
+{
+  wdtMicros = micros();
+  wdtFired  = true;
+}
+
+ISR(PCINT2_vect)
+{
+  rxActive = true;
+}
+#endif
+
+DCF77DutyCycle::DCF77DutyCycle(DCF77Decoder &decoder, uint8_t ponPin, bool ponActiveLow) : 
+  _decoder(decoder), _ponPin(ponPin), _ponActiveLow(ponActiveLow)
+{
+}
+
+/**
+ * Power the receiver every periodMinutes for at most windowMinutes,
+ * starting now with the receiver on until the first lock
+ */
+void DCF77DutyCycle::begin(uint16_t periodMinutes, uint8_t windowMinutes)
+{
+  _periodMinutes = periodMinutes;
+  _windowMinutes = windowMinutes;
+  _beginMillis   = millis();
+  pinMode(_ponPin, OUTPUT);
+  powerOn();
+}
+
+/**
+ * Called from loop(). Switches the receiver off as soon as a telegram
+ * has been accepted after the wake or the window is over, and on again
+ * when the period is over.
+ */
+void DCF77DutyCycle::loop()
+{
+  uint32_t elapsed = millis() - _switchMillis;
+
+  if (! _on)
+  {
+#ifdef DCF77_POWER_DOWN
+    if (wdtFired)
+    {
+      if (_wdtMicros == 0)
+      { // awake during the first period, Timer0 has measured it
+        _wdtMicros = wdtMicros - _wdtStart;
+      }
+      else
+      { // Timer0 stood still while asleep, advance millis() to the end of the period
+        uint32_t end = _wdtMillis + ((_wdtMicros << _wdtPrescaler) + 500) / 1000;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+          int32_t slept = end - timer0_millis;
+          if (slept > 0)
+          {
+            timer0_millis          = end;
+            timer0_overflow_count += slept * 1000L / 1024;
+            _sleptMillis          += slept;
+          }
+        }
+      }
+      stopWatchdog();
+      elapsed = millis() - _switchMillis;
+    }
+    if (elapsed < _periodMinutes * 60000UL) sleep(_periodMinutes * 60000UL - elapsed);
+#endif
+    if (elapsed >= _periodMinutes * 60000UL) powerOn();
+    return;
+  }
+  if (_decoder.getHoldover() < elapsed / 1000)
+  { // locked since the wake
+    uint32_t seconds;
+    uint16_t ms;
+
+    _lastAcquisition = elapsed / 1000;
+    _maxAcquisition  = max(_maxAcquisition, _lastAcquisition);
+    if (_wakeUnix && _decoder.getUnixTime(seconds, ms))
+    {
+      // received time minus flywheel time, both at this moment
+      _lastStep = (int32_t)(seconds - _wakeUnix - elapsed / 1000) * 1000L + ms - _wakeMs - (int32_t)(elapsed % 1000);
+      _maxStep  = max(_maxStep, abs(_lastStep));
+    }
+    _sleptAtLock = _sleptMillis;
+    _cycles++;
+    powerOff();
+  }
+  else if (_wakeUnix && elapsed >= _windowMinutes * 60000UL)
+  { // no lock in this window, the flywheel keeps running
+    _failures++;
+    powerOff();
+  }
+}
+
+bool DCF77DutyCycle::isReceiverOn()
+{
+  return _on;
+}
+
+/**
+ * Switch the receiver on, restart the framing and set
+ * the flywheel time with its uncertainty as prior
+ */
+void DCF77DutyCycle::powerOn()
+{
+  uint32_t seconds;
+  uint16_t ms;
+
+#ifdef DCF77_POWER_DOWN
+  stopWatchdog();
+  PCMSK2 &= ~_BV(PCINT16);
+#endif
+  digitalWrite(_ponPin, _ponActiveLow ? LOW : HIGH);
+  if (_switchMillis) _lastOffSeconds = (millis() - _switchMillis) / 1000;
+  _switchMillis = millis();
+  _on = true;
+  _decoder.resync();
+  _wakeUnix = 0;
+  if (_decoder.getUnixTime(seconds, ms))
+  {
+    uint32_t slept       = (_sleptMillis - _sleptAtLock) / 1000;
+    uint32_t uncertainty = 2 + (uint32_t)(((uint64_t)_decoder.getHoldover() * DCF77_FLYWHEEL_PPM + 
+                                           (uint64_t)slept * DCF77_SLEEP_PPM) / 1000000UL);
+    _wakeUnix = seconds;
+    _wakeMs   = ms;
+    _decoder.setTimePrior(seconds, min(uncertainty, 3600UL));
+  }
+}
+
+/**
+ * Switch the receiver off and, with DCF77_POWER_DOWN, calibrate
+ * the watchdog during its first period of 0.5 s
+ */
+void DCF77DutyCycle::powerOff()
+{
+  digitalWrite(_ponPin, _ponActiveLow ? HIGH : LOW);
+  _onSeconds   += (millis() - _switchMillis) / 1000;
+  _switchMillis = millis();
+  _on = false;
+#ifdef DCF77_POWER_DOWN
+  _wdtMicros     = 0;
+  _consoleMillis = millis() - DCF77_CONSOLE_AWAKE;
+  startWatchdog(0);
+  PCIFR  = _BV(PCIF2);
+  PCMSK2 |= _BV(PCINT16);
+  PCICR  |= _BV(PCIE2);
+#endif
+}
+
+#ifdef DCF77_POWER_DOWN
+/**
+ * Sleep in power down until the watchdog or the console wakes the MCU.
+ * A new watchdog period is started with the longest prescaler which
+ * ends before msLeft. The MCU stays awake while the watchdog is not
+ * calibrated yet, while the console is active and for the last 
+ * fraction of a second before the receiver is due.
+ */
+void DCF77DutyCycle::sleep(uint32_t msLeft)
+{
+  if (rxActive)
+  {
+    rxActive       = false;
+    _consoleMillis = millis();
+  }
+  if (_wdtMicros == 0 || millis() - _consoleMillis < DCF77_CONSOLE_AWAKE) return;
+  if (_wdtPrescaler == 0xFF)
+  {
+    uint8_t prescaler = WDT_MAX_PRESCALER;
+    while (prescaler > 0 && (_wdtMicros << prescaler) / 1000 >= msLeft) prescaler--;
+    if (_wdtMicros / 1000 >= msLeft) return;
+    startWatchdog(prescaler);
+  }
+  Console.flush();
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  sleep_mode();
+}
+
+/**
+ * Start a watchdog period of 0.5 s * 2^prescaler 
+ * in interrupt mode, without system reset
+ */
+void DCF77DutyCycle::startWatchdog(uint8_t prescaler)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    wdt_reset();
+    wdtFired = false;
+    WDTCSR   = _BV(WDCE) | _BV(WDE);
+    WDTCSR   = _BV(WDIE) | wdtBits[prescaler];
+    _wdtMillis = millis();
+    _wdtStart  = micros();
+  }
+  _wdtPrescaler = prescaler;
+}
+
+void DCF77DutyCycle::stopWatchdog()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    wdt_reset();
+    MCUSR   &= ~_BV(WDRF);
+    WDTCSR   = _BV(WDCE) | _BV(WDE);
+    WDTCSR   = 0;
+    wdtFired = false;
+  }
+  _wdtPrescaler = 0xFF;
+}
+#endif
+
+/**
+ * Print the schedule, the acquisition times, the flywheel 
+ * corrections and the expected charge per day
+ */
+void DCF77DutyCycle::printReport()
+{
+  uint32_t total = (millis() - _beginMillis) / 1000;
+  uint32_t on    = _onSeconds + (_on ? (millis() - _switchMillis) / 1000 : 0);
+  float    duty  = total ? (float)on / total : 1.0;
+  float    sleep = total ? _sleptMillis / 1000.0 / total : 0.0;
+  float    drift = _lastOffSeconds ? 1000.0 * _lastStep / _lastOffSeconds : 0.0;
+
+  Console.print(F("Receiver on "));     Console.print(_windowMinutes);
+  Console.print(F(" min every "));      Console.print(_periodMinutes);
+  Console.print(F(" min, now "));       Console.println(_on ? F("on") : F("off"));
+  Console.print(F("Windows locked "));  Console.print(_cycles);
+  Console.print(F(", failed "));        Console.print(_failures);
+  Console.print(F(", duty "));          Console.print(100.0 * duty, 2); Console.println(F(" %"));
+  Console.print(F("Acquisition last ")); Console.print(_lastAcquisition);
+  Console.print(F(" s, max "));         Console.print(_maxAcquisition); Console.println(F(" s"));
+  Console.print(F("Flywheel step last ")); Console.print(_lastStep);
+  Console.print(F(" ms, max "));        Console.print(_maxStep);
+  Console.print(F(" ms, drift "));      Console.print(drift, 1); Console.println(F(" ppm"));
+  Console.print(F("MCU asleep "));      Console.print(100.0 * sleep, 2); Console.println(F(" %"));
+  Console.print(F("Expected charge ")); 
+  Console.print((DCF77_MCU_UA * (1.0 - sleep) + DCF77_SLEEP_UA * sleep + DCF77_RX_UA * duty) * 24.0 / 1000.0, 1);
+  Console.print(F(" mAh/day, receiver ")); 
+  Console.print(DCF77_RX_UA * duty * 24.0 / 1000.0, 3); Console.println(F(" mAh/day"));
+}
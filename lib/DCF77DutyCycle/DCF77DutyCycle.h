@@ -0,0 +1,117 @@
+/**
+ * Header       DCF77DutyCycle.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Declaration of the class DCF77DutyCycle which powers the
+ *              receiver only for a short window every period to save the
+ *              batteries. In between the MCU sleeps in power down and is
+ *              woken by the watchdog every 8 s, millis() is advanced by
+ *              the watchdog period, which is calibrated against the
+ *              resonator at the start of every pause (flywheel). At each 
+ *              wake the flywheel time is set as time prior, so the decoder
+ *              locks as soon as minute and hour of the first complete 
+ *              telegram confirm it, usually within one or two minutes.
+ * 
+ * Constructor
+ * arguments    DCF77Decoder &decoder   decoder fed by the receiver
+ *              uint8_t ponPin          pin to the PON input of the receiver 
+ *                                      or to the gate of a MOSFET switch
+ *              bool ponActiveLow       true if the receiver runs with PON low
+ * 
+ * Remarks      Until the first lock the receiver stays on. The energy model
+ *              uses the currents DCF77_RX_UA of the receiver, DCF77_MCU_UA of
+ *              the awake and DCF77_SLEEP_UA of the sleeping MCU, weighted
+ *              with the measured times. The defaults are those of a bare
+ *              ATmega328P. On an Uno board the USB chip, the regulator and 
+ *              the power LED keep drawing tens of mA in power down, set
+ *              DCF77_SLEEP_UA to the measured board current there.
+ *              The watchdog oscillator drifts with temperature and supply
+ *              by up to several %, the prior uncertainty grows with
+ *              DCF77_SLEEP_PPM for the slept time and with 
+ *              DCF77_FLYWHEEL_PPM for the rest.
+ *              In power down Timer0, Timer1, Timer2 and the USART stop.
+ *              The MCU therefore stays awake with the simulator (Timer2),
+ *              with DCF77_IRIG_B and with DCF77_INPUT_CAPTURE (Timer1):
+ *              the capture time base would fall behind millis() by the 
+ *              time slept. A falling edge on RX 
+ *              wakes it up, the first byte is lost, and it stays awake 
+ *              for DCF77_CONSOLE_AWAKE ms after the last console byte.
+ *              The WDT and PCINT2 interrupts belong to this class.
+ */
+
+#include <Arduino.h>
+#include <DCF77Console.h>
+#include <DCF77Decoder.h>
+#ifndef _DCF77DutyCycle_H_
+#define _DCF77DutyCycle_H_
+
+#ifndef DCF77_DUTY_PERIOD
+#define DCF77_DUTY_PERIOD  360     // Minutes from wake to wake
+#endif
+#ifndef DCF77_DUTY_WINDOW
+#define DCF77_DUTY_WINDOW  5       // Maximal minutes with receiver on
+#endif
+#ifndef DCF77_RX_UA
+#define DCF77_RX_UA        100     // Receiver supply current in uA
+#endif
+#ifndef DCF77_MCU_UA
+#define DCF77_MCU_UA       15000   // MCU supply current when awake in uA
+#endif
+#ifndef DCF77_SLEEP_UA
+#define DCF77_SLEEP_UA     10      // MCU supply current in power down with watchdog in uA
+#endif
+#ifndef DCF77_FLYWHEEL_PPM
+#define DCF77_FLYWHEEL_PPM 1000    // Worst case drift of the resonator in ppm
+#endif
+#ifndef DCF77_SLEEP_PPM
+#define DCF77_SLEEP_PPM    20000   // Worst case drift of the calibrated watchdog in ppm
+#endif
+#ifndef DCF77_CONSOLE_AWAKE
+#define DCF77_CONSOLE_AWAKE 10000  // ms awake after a byte from the console
+#endif
+#if ! defined(DCF77_SIMULATOR) && ! defined(DCF77_IRIG_B) && ! defined(DCF77_INPUT_CAPTURE)
+#define DCF77_POWER_DOWN           // MCU sleeps between the windows
+#endif
+
+class DCF77DutyCycle
+{
+  public:
+    DCF77DutyCycle(DCF77Decoder &decoder, uint8_t ponPin, bool ponActiveLow = true);
+    void begin(uint16_t periodMinutes, uint8_t windowMinutes);
+    void loop();
+    bool isReceiverOn();
+    void printReport();
+
+  private:
+    void powerOn();
+    void powerOff();
+    void sleep(uint32_t msLeft);
+    void startWatchdog(uint8_t prescaler);
+    void stopWatchdog();
+    DCF77Decoder &_decoder;
+    uint8_t   _ponPin;
+    bool      _ponActiveLow;
+    uint16_t  _periodMinutes = 0;
+    uint8_t   _windowMinutes = 0;
+    bool      _on = false;
+    uint32_t  _beginMillis = 0;    // millis() at begin()
+    uint32_t  _switchMillis = 0;   // millis() at the last power on or off
+    uint32_t  _onSeconds = 0;      // receiver on time of the completed windows
+    uint32_t  _wakeUnix = 0;       // flywheel time at wake, 0 = no time yet
+    uint16_t  _wakeMs = 0;
+    uint16_t  _cycles = 0;         // windows with a lock
+    uint16_t  _failures = 0;       // windows without a lock
+    uint16_t  _lastAcquisition = 0;  // seconds from wake to lock
+    uint16_t  _maxAcquisition = 0;
+    int32_t   _lastStep = 0;       // correction of the flywheel at lock in ms
+    int32_t   _maxStep = 0;        // largest correction, absolute
+    uint32_t  _lastOffSeconds = 0; // length of the last period without receiver
+    uint32_t  _sleptMillis = 0;    // time in power down, included in millis()
+    uint32_t  _sleptAtLock = 0;    // _sleptMillis at the last lock
+    uint32_t  _wdtMicros = 0;      // calibrated watchdog period of 0.5 s, 0 = not yet
+    uint32_t  _wdtMillis = 0;      // millis() when the running watchdog period began
+    uint32_t  _wdtStart = 0;       // micros() at that time, for the calibration
+    uint8_t   _wdtPrescaler = 0xFF;  // periods of 0.5 s * 2^prescaler, 0xFF = none running
+    uint32_t  _consoleMillis = 0;  // millis() of the last wake by the console
+};
+#endif
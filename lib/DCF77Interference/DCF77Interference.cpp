@@ -0,0 +1,140 @@
+/**
+ * Class        DCF77Interference.cpp
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Autocorrelation and time of day pattern of the glitches
+ *              rejected by the DCF77Decoder
+ * 
+ * Board        Arduino Uno R3
+ */
+
+#include <DCF77Interference.h>
+
+DCF77Interference::DCF77Interference()
+{
+  reset();
+}
+
+/**
+ * Feed the micros() timestamp of a rejected pulse 
+ * and the current hour (IF_NOHOUR if unknown).
+ * Every lag to the last IF_DEPTH glitches is counted.
+ */
+void DCF77Interference::addGlitch(uint32_t epoch, uint8_t hour)
+{
+  uint8_t n = (_glitches < IF_DEPTH) ? _glitches : IF_DEPTH;
+
+  _perHour[hour < IF_NOHOUR ? hour : IF_NOHOUR]++;
+  for (uint8_t i = 0; i < n; i++)
+  {
+    uint8_t bin = getBin(epoch - _recent[i]);
+    if (bin < IF_NBRBINS && _count[bin] < 0xFFFF) _count[bin]++;
+  }
+  _recent[_next] = epoch;
+  _next = (_next + 1) % IF_DEPTH;
+  _glitches++;
+}
+
+/**
+ * Forget all glitches
+ */
+void DCF77Interference::reset()
+{
+  memset(_count, 0, sizeof(_count));
+  memset(_perHour, 0, sizeof(_perHour));
+  _next = 0;
+  _glitches = 0;
+}
+
+/**
+ * Print the dominant interference frequencies and 
+ * the number of glitches for every hour of the day.
+ * The lag k * T of a period T has 1/k of its pairs per us,
+ * so the densest bin is a fundamental, its multiples are
+ * skipped for the next peaks.
+ */
+void DCF77Interference::printReport()
+{
+  uint32_t total = 0;
+  uint8_t  found[IF_NBRPEAKS];   // reported fundamentals
+
+  for (uint8_t i = 0; i < IF_NBRBINS; i++) total += _count[i];
+  Console.print("Glitches: "); Console.println(_glitches);
+  Console.println("period_us,freq_Hz,share_%");
+  for (uint8_t p = 0; p < IF_NBRPEAKS && total > 0; p++)
+  {
+    int8_t peak = -1;
+    float  best = 0.0;
+    for (uint8_t i = 0; i < IF_NBRBINS; i++)
+    {
+      bool isUsed = false;
+      for (uint8_t u = 0; u < p; u++) isUsed |= isMultiple(i, found[u]);
+      if (_count[i] > 0 && !isUsed && getDensity(i) > best) { peak = i; best = getDensity(i); }
+    }
+    if (peak < 0) break;
+    found[p] = peak;
+    float period = getPeriod(peak);
+    Console.print(period, 0); Console.print(',');
+    Console.print(1e6 / period, 2); Console.print(',');
+    Console.println(100.0 * _count[peak] / total, 1);
+  }
+  Console.println("hour,glitches");
+  for (uint8_t h = 0; h <= IF_NOHOUR; h++)
+  {
+    if (h < IF_NOHOUR) Console.print(h); else Console.print("--");
+    Console.print(','); Console.println(_perHour[h]);
+  }
+}
+
+/**
+ * Lag bin of an interval in us, 
+ * IF_NBRBINS if out of range
+ */
+uint8_t DCF77Interference::getBin(uint32_t dt)
+{
+  if (dt < 256UL || dt >= (1UL << 18)) return IF_NBRBINS;
+  // bin = 8 * (log2(dt) - 8) + next 3 lower bits
+  uint8_t msb = 8;
+  while (dt >> (msb + 1)) msb++;
+  return 8 * (msb - 8) + ((dt >> (msb - 3)) & 7);
+}
+
+/**
+ * Center of a lag bin in us
+ */
+uint32_t DCF77Interference::getPeriod(uint8_t bin)
+{
+  return (1UL << (8 + bin / 8)) + (bin % 8) * getWidth(bin) + getWidth(bin) / 2;
+}
+
+/**
+ * Width of a lag bin in us
+ */
+uint32_t DCF77Interference::getWidth(uint8_t bin)
+{
+  return 1UL << (5 + bin / 8);
+}
+
+/**
+ * True if bin is next to bin peak or holds one of its multiples
+ * with no more pairs per us than that multiple explains
+ */
+bool DCF77Interference::isMultiple(uint8_t bin, uint8_t peak)
+{
+  if (bin + 1 >= peak && bin <= peak + 1) return true;
+  uint32_t lo = getPeriod(peak) - getWidth(peak) / 2;
+  uint32_t hi = lo + getWidth(peak) - 1;
+  for (uint32_t k = 2; getBin(k * lo) < IF_NBRBINS; k++)
+  {
+    if (bin >= getBin(k * lo) && bin <= getBin(k * hi) && k * getDensity(bin) <= 2 * getDensity(peak)) return true;
+  }
+  return false;
+}
+
+/**
+ * Glitch pairs per us in a lag bin
+ */
+float DCF77Interference::getDensity(uint8_t bin)
+{
+  return (float)_count[bin] / getWidth(bin);
+}
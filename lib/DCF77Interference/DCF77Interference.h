@@ -0,0 +1,53 @@
+/**
+ * Header       DCF77Interference.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Declaration of the class DCF77Interference which fingerprints
+ *              the noise source of a bad site. Switching power supplies, LED
+ *              drivers or monitors produce glitches with a typical period.
+ *              The autocorrelation of the glitch train is collected with 
+ *              8 lag bins per octave from 256 us to 262 ms, its strongest 
+ *              peaks which are not multiples of another give the 
+ *              interference frequencies.
+ *              The glitches are also counted per hour of the day.
+ * 
+ * Remarks      Each glitch is correlated with the last IF_DEPTH glitches,
+ *              so a period is found even if most of its glitches are lost
+ *              or two sources are interleaved, where the intervals between
+ *              consecutive glitches are just noise. The bins are ranked by
+ *              pairs per us, which is flat for random glitches.
+ *              Slower sources and patterns over many days are analysed on 
+ *              the host from edge captures with tools/dcf77capture.py.
+ */
+
+#include <Arduino.h>
+#include <DCF77Console.h>
+#ifndef _DCF77Interference_H_
+#define _DCF77Interference_H_
+
+#define IF_NBRBINS   80     // 8 lag bins per octave, 2^8 .. 2^18 us
+#define IF_NBRPEAKS  3      // number of reported frequencies
+#define IF_NOHOUR    24     // hour bucket used while time is unknown
+#define IF_DEPTH     8      // glitches each new one is correlated with
+
+class DCF77Interference
+{
+  public:
+    DCF77Interference();
+    void addGlitch(uint32_t epoch, uint8_t hour);
+    void reset();
+    void printReport();
+
+  private:
+    uint8_t  getBin(uint32_t dt);
+    uint32_t getPeriod(uint8_t bin);
+    uint32_t getWidth(uint8_t bin);
+    float    getDensity(uint8_t bin);
+    bool     isMultiple(uint8_t bin, uint8_t peak);
+    uint16_t _count[IF_NBRBINS];   // glitch pairs per lag bin
+    uint16_t _perHour[IF_NOHOUR + 1];
+    uint32_t _recent[IF_DEPTH];    // epochs of the last glitches
+    uint8_t  _next = 0;
+    uint32_t _glitches = 0;
+};
+#endif
@@ -0,0 +1,133 @@
+/**
+ * Class        DCF77IrigB.cpp
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      IRIG-B timecode output on OC1B, locked to the DCF77 seconds
+ * 
+ * Board        Arduino Uno R3
+ * 
+ * Remarks      Uses Timer1 in fast PWM mode 15 and its compare B interrupt
+ */
+
+#include <DCF77IrigB.h>
+
+static DCF77IrigB *irigB = nullptr;
+
+ISR(TIMER1_COMPB_vect)
+{
+  irigB->handleCompare();
+}
+
+DCF77IrigB::DCF77IrigB(DCF77Decoder &decoder) : _decoder(decoder)
+{
+}
+
+/**
+ * Start Timer1 in fast PWM mode 15 with 16 MHz / 64 = 4 us ticks, 
+ * TOP = OCR1A. The first frame is a dummy with the output off, it
+ * only starts the planning in loop().
+ */
+void DCF77IrigB::begin()
+{
+  irigB = this;
+  dcf77_irig_init(&_irig);
+  digitalWrite(PIN_OC1B, LOW);
+  pinMode(PIN_OC1B, OUTPUT);
+
+  noInterrupts();
+  TCCR1B = 0;
+  TCCR1A = _BV(WGM11) | _BV(WGM10);
+  TCNT1  = 0;
+  OCR1A  = _irig.frame[0].period - 1;
+  OCR1B  = DCF77_IRIG_MARK - 1;
+  TIFR1  = _BV(OCF1B);
+  TIMSK1 = _BV(OCIE1B);
+  TCCR1B = _BV(WGM13) | _BV(WGM12) | _BV(CS11) | _BV(CS10);
+  interrupts();
+}
+
+/**
+ * Stop the output
+ */
+void DCF77IrigB::end()
+{
+  TIMSK1 = 0;
+  TCCR1A = 0;
+  TCCR1B = 0;
+  digitalWrite(PIN_OC1B, LOW);
+}
+
+/**
+ * Called by the compare interrupt at the end of each pulse. The 
+ * registers written here are taken over by the timer at the start
+ * of the next element. The output is switched at the frame start.
+ */
+void DCF77IrigB::handleCompare()
+{
+  uint16_t ocr   = OCR1B;    // still the active value, nothing buffered yet
+  uint16_t tcnt  = TCNT1;
+  uint32_t start = micros() - ((uint32_t)tcnt << 2);
+  uint16_t width;
+
+  OCR1A = dcf77_irig_load(&_irig, start, &width);
+  OCR1B = width;
+  if (_irig.element == 0)
+  {
+    if (_irig.frame[_irig.front].enabled) TCCR1A |= _BV(COM1B1);
+    else                                  TCCR1A &= ~_BV(COM1B1);
+  }
+  uint16_t load = TCNT1 - ocr;
+  if (load > _maxLoad) _maxLoad = load;
+}
+
+/**
+ * Called from loop(), plans the next frame once per frame. Only
+ * the frame start is taken with interrupts disabled, the encoding
+ * must not delay the edge interrupt of the decoder.
+ */
+void DCF77IrigB::loop()
+{
+  if (! _irig.started) return;
+
+  uint32_t seconds = 0;
+  uint16_t ms      = 0;
+  bool     valid   = _decoder.getUnixTime(seconds, ms);
+  uint32_t start, now;
+
+  noInterrupts();
+  bool taken = dcf77_irig_take(&_irig, &start);
+  now = micros();
+  interrupts();
+  if (taken) dcf77_irig_plan(&_irig, start, now, seconds + DCF77_IRIG_OFFSET, ms, valid);
+}
+
+/**
+ * Feed the micros() timestamp of a DCF77 second epoch
+ */
+void DCF77IrigB::addEpoch(uint32_t epoch)
+{
+  dcf77_irig_epoch(&_irig, epoch);
+}
+
+/**
+ * Print output state, phase of the frames against the DCF77 
+ * seconds, resonator offset and the interrupt load
+ */
+void DCF77IrigB::printReport()
+{
+  noInterrupts();
+  int32_t  phase   = _irig.phase;
+  uint8_t  enabled = _irig.frame[_irig.front].enabled;
+  uint16_t late    = _irig.late;
+  uint16_t maxLoad = _maxLoad;
+  interrupts();
+
+  Console.print(F("IRIG-B00"));        Console.print(DCF77_IRIG_CODE);
+  Console.print(F(" on pin "));        Console.print(PIN_OC1B);
+  Console.print(F(", output "));       Console.println(enabled ? F("on") : F("off"));
+  Console.print(F("Frame phase "));    Console.print(phase);
+  Console.print(F(" us, resonator ")); Console.print((int32_t)(_irig.usPerSecond - 1000000UL));
+  Console.print(F(" ppm over "));      Console.print(_irig.baseline); Console.println(F(" s"));
+  Console.print(F("Frames late "));    Console.print(late);
+  Console.print(F(", max load "));     Console.print(maxLoad * 4); Console.println(F(" us"));
+}
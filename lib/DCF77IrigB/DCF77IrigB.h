@@ -0,0 +1,62 @@
+/**
+ * Header       DCF77IrigB.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Declaration of the class DCF77IrigB which generates an IRIG-B
+ *              timecode (B00x, DC level shift) from the decoded DCF77 time.
+ *              The waveform is made by the hardware of Timer1 in fast PWM
+ *              mode: OCR1A holds the period and OCR1B the pulse width of an
+ *              element, both double buffered and taken over at the start of
+ *              the element. The compare interrupt at the end of each pulse
+ *              only loads the registers of the next element from a frame
+ *              prepared by loop(), so the edges do not depend on interrupt
+ *              or loop latency as long as the interrupt is served within
+ *              the rest of the element (2 ms after a position marker).
+ * 
+ * Constructor
+ * arguments    DCF77Decoder &decoder   decoder delivering time and epochs
+ * 
+ * Wiring       IRIG-B output on OC1B, which is digital pin 10 on the Uno
+ * 
+ * Remarks      The frames start on the DCF77 second epochs, which loop() has
+ *              to feed with addEpoch(). The output stays low until the time
+ *              is valid and the frames are locked within 1 ms. The time
+ *              sent is UTC plus DCF77_IRIG_OFFSET seconds. Timer1 is taken,
+ *              so DCF77_INPUT_CAPTURE, PWM on pin 9 and 10 and libraries
+ *              using Timer1 (e.g. Servo) are not available.
+ *              tools/dcf77irigmodel.c models the timing on the host.
+ */
+
+#include <Arduino.h>
+#include <DCF77Console.h>
+#include <DCF77Decoder.h>
+#include <DCF77Irig.h>
+#ifndef _DCF77IrigB_H_
+#define _DCF77IrigB_H_
+
+#if defined(DCF77_IRIG_B) && defined(DCF77_INPUT_CAPTURE)
+#error "DCF77_IRIG_B and DCF77_INPUT_CAPTURE both need Timer1"
+#endif
+
+#define PIN_OC1B          10
+#ifndef DCF77_IRIG_OFFSET
+#define DCF77_IRIG_OFFSET 0       // seconds added to UTC, e.g. 3600 for MEZ
+#endif
+
+class DCF77IrigB
+{
+  public:
+    DCF77IrigB(DCF77Decoder &decoder);
+    void begin();
+    void end();
+    void loop();
+    void addEpoch(uint32_t epoch);
+    void handleCompare();
+    void printReport();
+
+  private:
+    DCF77Decoder &_decoder;
+    dcf77_irig    _irig;
+    volatile uint16_t _maxLoad = 0;    // ticks from the compare match to the registers loaded
+};
+#endif
@@ -0,0 +1,142 @@
+/**
+ * Class        DCF77Memory.cpp
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Stack painting at boot, stack high-water mark, free RAM 
+ *              and queue fill levels
+ * 
+ * Board        Arduino Uno R3
+ * 
+ * Remarks      Uses the symbols of the avr-libc linker script and malloc()
+ */
+
+#include <DCF77Memory.h>
+
+extern uint8_t  __data_start;    // first byte of .data, RAMSTART
+extern uint8_t  __heap_start;    // end of .bss
+extern char    *__brkval;        // top of the heap, 0 before the first malloc()
+
+/**
+ * Runs in .init3 after the stack pointer is set up and before the 
+ * constructors and main(). Nothing is on the stack yet, so the whole
+ * RAM above .bss is painted. Naked: no prologue, no return, the code
+ * falls through to .init4.
+ */
+void dcf77PaintStack() __attribute__((naked, used, section(".init3")));
+void dcf77PaintStack()
+{
+  for (uint8_t *p = &__heap_start; p <= (uint8_t *)RAMEND; p++) *p = MEM_PAINT;
+}
+
+/**
+ * Register the highest fill level of a queue for the report
+ */
+void DCF77Memory::setBuffer(uint8_t index, const __FlashStringHelper *name, uint8_t peak, uint8_t capacity)
+{
+  if (index >= MEM_MAX_BUFFERS) return;
+  _buffers[index] = { name, peak, capacity };
+  if (index >= _nbrBuffers) _nbrBuffers = index + 1;
+}
+
+/**
+ * Bytes of .data and .bss
+ */
+uint16_t DCF77Memory::getStaticRam()
+{
+  return &__heap_start - &__data_start;
+}
+
+/**
+ * Bytes taken by malloc() so far
+ */
+uint16_t DCF77Memory::getHeapUsed()
+{
+  return __brkval ? (uint8_t *)__brkval - &__heap_start : 0;
+}
+
+/**
+ * Bytes between the top of the heap and the stack pointer now
+ */
+uint16_t DCF77Memory::getFreeRam()
+{
+  uint8_t top;   // its address is the stack pointer
+  return &top - (__brkval ? (uint8_t *)__brkval : &__heap_start);
+}
+
+/**
+ * Painted bytes above the heap which the stack never reached, 
+ * the margin left for new buffers
+ */
+uint16_t DCF77Memory::getStackHeadroom()
+{
+  uint8_t *p = __brkval ? (uint8_t *)__brkval : &__heap_start;
+  uint8_t *q = p;
+
+  while (q <= (uint8_t *)RAMEND && *q == MEM_PAINT) q++;
+  return q - p;
+}
+
+/**
+ * Deepest stack since boot in bytes
+ */
+uint16_t DCF77Memory::getStackPeak()
+{
+  uint8_t *q = __brkval ? (uint8_t *)__brkval : &__heap_start;
+
+  while (q <= (uint8_t *)RAMEND && *q == MEM_PAINT) q++;
+  return (uint8_t *)RAMEND + 1 - q;
+}
+
+/**
+ * Print the RAM budget and the fill levels of the registered queues
+ */
+void DCF77Memory::printReport()
+{
+  Console.print(F("RAM "));             Console.print((uint16_t)((uint8_t *)RAMEND + 1 - &__data_start));
+  Console.print(F(" bytes, static "));  Console.print(getStaticRam());
+  Console.print(F(", heap "));          Console.println(getHeapUsed());
+  Console.print(F("Stack peak "));      Console.print(getStackPeak());
+  Console.print(F(", headroom "));      Console.print(getStackHeadroom());
+  Console.print(F(", free now "));      Console.println(getFreeRam());
+  for (uint8_t i = 0; i < _nbrBuffers; i++)
+  {
+    if (_buffers[i].name == nullptr) continue;
+    Console.print(_buffers[i].name);    Console.print(F(" peak "));
+    Console.print(_buffers[i].peak);    Console.print(F(" of "));
+    Console.println(_buffers[i].capacity);
+  }
+}
+
+/**
+ * Write the same figures as one binary record, see DCF77Memory.h.
+ * Never waits: returns false and writes nothing if the record 
+ * does not fit into the TX buffer right now.
+ */
+bool DCF77Memory::writeRecord()
+{
+  uint8_t  record[MEM_RECORD_SIZE];
+  uint8_t  *payload = record + 3;
+  uint8_t  n = 0;
+  uint8_t  sum = 0;
+  uint16_t values[] = { getStaticRam(), getHeapUsed(), getStackPeak(), getFreeRam(), getStackHeadroom() };
+
+  payload[n++] = MEM_RECORD_VER;
+  for (uint8_t i = 0; i < 5; i++)
+  {
+    payload[n++] = values[i] & 0xFF;
+    payload[n++] = values[i] >> 8;
+  }
+  payload[n++] = _nbrBuffers;
+  for (uint8_t i = 0; i < _nbrBuffers; i++)
+  {
+    payload[n++] = _buffers[i].peak;
+    payload[n++] = _buffers[i].capacity;
+  }
+  for (uint8_t i = 0; i < n; i++) sum += payload[i];
+
+  record[0] = MEM_RECORD_SYNC1;
+  record[1] = MEM_RECORD_SYNC2;
+  record[2] = n;
+  payload[n] = sum;
+  return consoleWriteNonBlocking(record, n + 4);
+}
@@ -0,0 +1,63 @@
+/**
+ * Header       DCF77Memory.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Declaration of the class DCF77Memory which measures the use
+ *              of the 2 KB SRAM, so buffers can be sized with confidence:
+ *              - static RAM (.data and .bss) and heap in use
+ *              - free RAM between heap and stack right now
+ *              - stack high-water mark: the RAM between heap and stack is
+ *                painted at boot, before main(), the deepest stack ever
+ *                reached is found by scanning for the first overwritten
+ *                byte. It includes nested interrupts, e.g. a decoder edge
+ *                arriving during Console.print().
+ *              - highest fill level of the queues, registered by the
+ *                program with setBuffer()
+ * 
+ * Remarks      Enabled with the build flag DCF77_MEMORY. Nothing is measured
+ *              at run time, the paint is done once and the scan only runs
+ *              on demand, so interrupts and loop() run at full speed.
+ *              A stack byte that happens to hold the paint value is counted 
+ *              as untouched, the high-water mark may be low by a few bytes.
+ *              Binary record written by writeRecord(), little endian:
+ *                0xD7 0x4D <length of payload> <payload> <sum of payload bytes>
+ *              payload: version (1), static, heap, stack peak, free now,
+ *                stack headroom (2 bytes each), number of buffers (1),
+ *                per buffer: peak (1), capacity (1)
+ *              tools/dcf77memory.py decodes it.
+ */
+
+#include <Arduino.h>
+#include <DCF77Console.h>
+#ifndef _DCF77Memory_H_
+#define _DCF77Memory_H_
+
+#define MEM_PAINT        0xC5    // paint value of the unused RAM
+#define MEM_MAX_BUFFERS  4
+#define MEM_RECORD_SYNC1 0xD7
+#define MEM_RECORD_SYNC2 0x4D    // 'M'
+#define MEM_RECORD_VER   1
+#define MEM_RECORD_SIZE  (3 + 12 + 2 * MEM_MAX_BUFFERS + 1)
+
+#ifdef DCF77_LEAN_UART
+static_assert(LEAN_UART_TX_SIZE > MEM_RECORD_SIZE, "the RAM record must fit into the TX ring");
+#endif
+
+class DCF77Memory
+{
+  public:
+    void setBuffer(uint8_t index, const __FlashStringHelper *name, uint8_t peak, uint8_t capacity);
+    uint16_t getStaticRam();
+    uint16_t getHeapUsed();
+    uint16_t getFreeRam();
+    uint16_t getStackPeak();
+    uint16_t getStackHeadroom();
+    void printReport();
+    bool writeRecord();
+
+  private:
+    typedef struct { const __FlashStringHelper *name; uint8_t peak; uint8_t capacity; } Buffer;
+    Buffer  _buffers[MEM_MAX_BUFFERS];
+    uint8_t _nbrBuffers = 0;
+};
+#endif
@@ -0,0 +1,200 @@
+/**
+ * Class        DCF77Simulator.cpp
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Generates the DCF77 time telegram with the encoder of the core
+ *              and emits its edges from a 1 ms timer interrupt into the 
+ *              edge path of a DCF77Decoder.
+ * 
+ * Board        Arduino Uno R3
+ * 
+ * Remarks      Uses Timer2 compare match A, works unchanged under simavr
+ * 
+ * References   https://oar.ptb.de/files/download/56d6a9c0ab9f3f76468b45a7 
+ */
+
+#include <DCF77Simulator.h>
+
+static const uint8_t daysInMonth[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+static DCF77Simulator *simulator = nullptr;
+
+ISR(TIMER2_COMPA_vect)
+{
+  simulator->handleTick();
+}
+
+DCF77Simulator::DCF77Simulator(DCF77Decoder &decoder) : _decoder(decoder)
+{
+}
+
+/**
+ * Start the simulation, the first telegram announces startTime 
+ * (local time, seconds are ignored) at its minute mark.
+ * Timer2 is set to CTC mode: 16 MHz / 64 / 250 = 1 kHz
+ */
+void DCF77Simulator::begin(const tm &startTime)
+{
+  _time = startTime;
+  encodeFrame();
+  _ms = 0;
+  _second = 0;
+  simulator = this;
+
+  noInterrupts();
+  TCCR2A = _BV(WGM21);
+  TCCR2B = _BV(CS22);
+  OCR2A  = 249;
+  TCNT2  = 0;
+  TIMSK2 = _BV(OCIE2A);
+  interrupts();
+}
+
+/**
+ * Stop the simulation and release Timer2
+ */
+void DCF77Simulator::end()
+{
+  TIMSK2 = 0;
+}
+
+/**
+ * Set the impairments applied to the generated signal
+ */
+void DCF77Simulator::setImpairments(uint16_t glitch, uint16_t drop, uint8_t jitter)
+{
+  noInterrupts();
+  _glitch = glitch;
+  _drop   = drop;
+  _jitter = jitter;
+  interrupts();
+}
+
+/**
+ * Emulate the power switch of the receiver,
+ * a receiver without power emits no pulses
+ */
+void DCF77Simulator::setReceiverPower(bool on)
+{
+  _powered = on;
+}
+
+/**
+ * Called every millisecond from the timer interrupt.
+ * Emits the rising edge at the start of each second except 59,
+ * the falling edge after 100 or 200 ms and optional glitches.
+ */
+void DCF77Simulator::handleTick()
+{
+  if (_ms == 0)
+  {
+    _widthPulse  = 0;
+    _glitchAt    = 0;
+    _msPerSecond = 1000;
+    _driftSum   += _drift;
+    if (_driftSum >= 1000)       { _driftSum -= 1000; _msPerSecond = 999; }
+    else if (_driftSum <= -1000) { _driftSum += 1000; _msPerSecond = 1001; }
+    if (_powered && _second < 59 && random16() % 1000 >= _drop)
+    {
+      _widthPulse = ((_frame >> _second) & 1) ? 200 : 100;   // nominal, not the receiver profile
+      if (_jitter) _widthPulse += random16() % (2 * _jitter + 1) - _jitter;
+      _decoder.handleEdge(EDGE_RISING);
+    }
+    if (_powered && random16() % 1000 < _glitch)
+    {
+      _glitchAt = 300 + random16() % 600;
+    }
+  }
+  else if (_ms == _widthPulse)
+  {
+    _decoder.handleEdge(EDGE_FALLING);
+  }
+  else if (_glitchAt && _ms == _glitchAt)
+  {
+    _decoder.handleEdge(EDGE_RISING);
+  }
+  else if (_glitchAt && _ms == _glitchAt + SIM_GLITCHWIDTH)
+  {
+    _decoder.handleEdge(EDGE_FALLING);
+  }
+
+  if (++_ms == _msPerSecond)
+  {
+    _ms = 0;
+    if (++_second == 60)
+    {
+      _second = 0;
+      nextMinute();
+      encodeFrame();
+      _frames++;
+    }
+  }
+  if (TCNT2 > _maxLoad) _maxLoad = TCNT2;
+}
+
+/**
+ * Number of complete minutes generated so far
+ */
+uint32_t DCF77Simulator::getFrames()
+{
+  noInterrupts();
+  uint32_t frames = _frames;
+  interrupts();
+  return frames;
+}
+
+/**
+ * Longest execution time of handleTick() in us
+ */
+uint16_t DCF77Simulator::getMaxTickLoad()
+{
+  return _maxLoad * 4;
+}
+
+/**
+ * Advance the simulated time by one minute.
+ * DCF77 years are 2000..2099, every 4th is a leap year.
+ */
+void DCF77Simulator::nextMinute()
+{
+  if (++_time.tm_min < 60) return;
+  _time.tm_min = 0;
+  if (++_time.tm_hour < 24) return;
+  _time.tm_hour = 0;
+  _time.tm_wday = (_time.tm_wday + 1) % 7;
+  uint8_t days = daysInMonth[_time.tm_mon] + ((_time.tm_mon == 1 && _time.tm_year % 4 == 0) ? 1 : 0);
+  if (++_time.tm_mday <= days) return;
+  _time.tm_mday = 1;
+  if (++_time.tm_mon < 12) return;
+  _time.tm_mon = 0;
+  _time.tm_year++;
+}
+
+/**
+ * Build the packed telegram of the current minute with dcf77_encode_frame(),
+ * the encoder the host tools use as well
+ */
+void DCF77Simulator::encodeFrame()
+{
+  dcf77_time time = {};
+
+  time.minute = _time.tm_min;
+  time.hour   = _time.tm_hour;
+  time.mday   = _time.tm_mday;
+  time.wday   = (_time.tm_wday == 0) ? 7 : _time.tm_wday;   // DCF77 Mo=1 ... So=7
+  time.month  = _time.tm_mon + 1;
+  time.year   = _time.tm_year - 100;
+  time.isdst  = (_time.tm_isdst > 0) ? 1 : 0;                // MESZ or MEZ
+  _frame = dcf77_encode_frame(&time);
+}
+
+/**
+ * 16 bit xorshift, cheap enough for the interrupt handler
+ */
+uint16_t DCF77Simulator::random16()
+{
+  _lfsr ^= _lfsr << 7;
+  _lfsr ^= _lfsr >> 9;
+  _lfsr ^= _lfsr << 8;
+  return _lfsr;
+}
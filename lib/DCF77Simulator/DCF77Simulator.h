@@ -0,0 +1,77 @@
+/**
+ * Header       DCF77Simulator.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Declaration of the class DCF77Simulator, a synthetic DCF77
+ *              signal source driven by Timer2 which feeds the edges 
+ *              directly into a DCF77Decoder. No receiver is needed, so the
+ *              decoder can be tested on the bench, at night or under simavr.
+ * 
+ * Constructor
+ * arguments    DCF77Decoder &decoder   decoder which receives the edges
+ * 
+ * Remarks      Timer2 is used in CTC mode with 1 ms ticks, therefore tone()
+ *              and PWM on pins 3 and 11 are not available while simulating.
+ *              Impairments are given in per mille per second:
+ *              glitch   a short spurious pulse within the pause
+ *              drop     a missing second pulse
+ *              jitter   pulse width varies by +/- jitter ms
+ *              A drift in ppm lengthens or shortens the simulated seconds
+ *              against millis(), like a resonator off its nominal frequency.
+ */
+
+#include <Arduino.h>
+#include <time.h>
+#include <DCF77Decoder.h>
+#ifndef _DCF77Simulator_H_
+#define _DCF77Simulator_H_
+
+#ifndef DCF77_SIM_GLITCH
+#define DCF77_SIM_GLITCH  0     // Glitch probability per mille per second
+#endif
+#ifndef DCF77_SIM_DROP
+#define DCF77_SIM_DROP    0     // Dropped pulse probability per mille per second
+#endif
+#ifndef DCF77_SIM_JITTER
+#define DCF77_SIM_JITTER  0     // Maximal pulse width deviation in ms
+#endif
+#ifndef DCF77_SIM_DRIFT
+#define DCF77_SIM_DRIFT   0     // Local clock slower (> 0) or faster (< 0) in ppm
+#endif
+#define SIM_GLITCHWIDTH   8     // Width of an injected glitch in ms
+
+class DCF77Simulator
+{
+  public:
+    DCF77Simulator(DCF77Decoder &decoder);
+    void begin(const tm &startTime);
+    void end();
+    void setImpairments(uint16_t glitch, uint16_t drop, uint8_t jitter);
+    void setReceiverPower(bool on);
+    void handleTick();
+    uint32_t getFrames();
+    uint16_t getMaxTickLoad();
+
+  private:
+    void     nextMinute();
+    void     encodeFrame();
+    uint16_t random16();
+    DCF77Decoder &_decoder;
+    tm            _time;
+    uint64_t      _frame = 0;         // packed telegram of the current minute
+    uint16_t      _ms = 0;            // ms within the current second
+    uint16_t      _msPerSecond = 1000;  // 999 or 1001 to apply the drift
+    int16_t       _drift = DCF77_SIM_DRIFT;
+    int16_t       _driftSum = 0;      // drift accumulated in us
+    volatile bool _powered = true;    // false emits no pulses
+    uint8_t       _second = 0;
+    uint8_t       _widthPulse = 0;    // 0 if the pulse of this second is dropped
+    uint16_t      _glitchAt = 0;      // 0 if no glitch in this second
+    uint16_t      _glitch = DCF77_SIM_GLITCH;
+    uint16_t      _drop = DCF77_SIM_DROP;
+    uint8_t       _jitter = DCF77_SIM_JITTER;
+    uint16_t      _lfsr = 0xACE1;
+    volatile uint32_t _frames = 0;
+    volatile uint8_t  _maxLoad = 0;   // longest tick in timer counts of 4 us
+};
+#endif
@@ -0,0 +1,137 @@
+/**
+ * Class        DCF77Stability.cpp
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Streaming Allan and time deviation of the local resonator
+ *              measured against the DCF77 second epochs
+ * 
+ * Board        Arduino Uno R3
+ * 
+ * References   https://tf.nist.gov/general/pdf/2220.pdf 
+ */
+
+#include <DCF77Stability.h>
+
+/**
+ * Feed the micros() timestamp of a second mark.
+ * The phase x is the deviation of the local time from the nominal
+ * 1 000 000 us per DCF77 second. A single missing second, like the 
+ * one at the minute mark, is bridged by interpolation.
+ */
+void DCF77Stability::addEpoch(uint32_t epoch)
+{
+  if (! _started)
+  {
+    reset();
+    _started = true;
+    addPhase(_n, _x);
+  }
+  else
+  {
+    uint32_t dt    = epoch - _lastEpoch;
+    uint32_t steps = (dt + 500000UL) / 1000000UL;
+    if (steps == 0) return;
+    int32_t x = _x + (int32_t)(dt - steps * 1000000UL);
+    if (steps == 2) addPhase(_n + 1, (_x + x) / 2);
+    _x  = x;
+    _n += steps;
+    addPhase(_n, _x);
+  }
+  _lastEpoch = epoch;
+}
+
+/**
+ * Feed phase x of second n into all octaves
+ */
+void DCF77Stability::addPhase(uint32_t n, int32_t x)
+{
+  for (uint8_t k = 0; k < DCF77_STAB_OCTAVES && (n & ((1UL << k) - 1)) == 0; k++)
+  {
+    addSample(_octave[k].raw, n >> k, x);
+  }
+  addMean(0, n, x);
+}
+
+/**
+ * Forget all samples
+ */
+void DCF77Stability::reset()
+{
+  memset(_octave, 0, sizeof(_octave));
+  _n = 0;
+  _x = 0;
+  _started = false;
+}
+
+/**
+ * Frequency offset of the local clock in ppm, 
+ * positive if the resonator runs fast
+ */
+float DCF77Stability::getOffsetPPM()
+{
+  return (_n > 0) ? (float)_x / _n : 0.0;
+}
+
+/**
+ * Print a plot ready table, one line per tau
+ */
+void DCF77Stability::printCSV()
+{
+  Console.print("# offset_ppm,"); Console.println(getOffsetPPM(), 3);
+  Console.println("tau_s,adev_ppb,tdev_us,samples");
+  for (uint8_t k = 0; k < DCF77_STAB_OCTAVES; k++)
+  {
+    Chain &raw  = _octave[k].raw;
+    Chain &mean = _octave[k].mean;
+    if (raw.cnt == 0) break;
+    Console.print(1UL << k); Console.print(',');
+    Console.print(sqrt(raw.sum / (2.0 * raw.cnt)) * 1000.0 / (1UL << k), 3); Console.print(',');
+    Console.print((mean.cnt > 0) ? sqrt(mean.sum / (6.0 * mean.cnt)) : 0.0, 3); Console.print(',');
+    Console.println(raw.cnt);
+  }
+}
+
+/**
+ * Append sample x with index idx to a chain and accumulate the 
+ * second difference if the last three samples are contiguous
+ */
+void DCF77Stability::addSample(Chain &c, uint32_t idx, int32_t x)
+{
+  if (c.fill > 0 && c.idx + 1 != idx) c.fill = 0;
+  if (c.fill == 2)
+  {
+    float d = (float)(x - 2 * c.xb + c.xa);
+    c.sum += d * d;
+    c.cnt++;
+  }
+  else
+  {
+    c.fill++;
+  }
+  c.xa  = c.xb;
+  c.xb  = x;
+  c.idx = idx;
+}
+
+/**
+ * Append the phase averaged over block idx of octave k and 
+ * combine two adjacent blocks into one block of octave k + 1
+ */
+void DCF77Stability::addMean(uint8_t k, uint32_t idx, int32_t x)
+{
+  for ( ; k < DCF77_STAB_OCTAVES; k++, idx >>= 1)
+  {
+    Octave &o = _octave[k];
+    addSample(o.mean, idx, x);
+    if ((idx & 1) == 0)
+    {
+      o.pend    = x;
+      o.pendIdx = idx;
+      o.hasPend = true;
+      return;
+    }
+    if (! o.hasPend || o.pendIdx + 1 != idx) return;
+    o.hasPend = false;
+    x = (o.pend + x) / 2;
+  }
+}
@@ -0,0 +1,66 @@
+/**
+ * Header       DCF77Stability.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Declaration of the class DCF77Stability which characterises
+ *              the local resonator against the DCF77 second marks.
+ *              From the micros() timestamps of the second epochs it estimates
+ *              the frequency offset, the Allan deviation (ADEV) and the 
+ *              time deviation (TDEV) for tau = 1, 2, 4 ... 2^(octaves-1) s.
+ * 
+ * Remarks      The estimators are streaming and use non-overlapping samples
+ *              of a decimation cascade, so memory grows with log2(tau) only:
+ *              51 bytes per octave. The default of 8 octaves (tau up to 
+ *              128 s) takes 408 bytes, 12 octaves (2048 s) already 612 bytes,
+ *              a third of the SRAM. Longer tau, up to days, are evaluated 
+ *              on the host from edge captures with tools/dcf77capture.py.
+ *              ADEV  = sqrt(<(x[i+2] - 2x[i+1] + x[i])^2> / 2) / tau 
+ *                      with x the phase sampled every tau seconds
+ *              TDEV  = sqrt(<(X[i+2] - 2X[i+1] + X[i])^2> / 6) 
+ *                      with X the phase averaged over blocks of tau seconds
+ */
+
+#include <Arduino.h>
+#include <DCF77Console.h>
+#ifndef _DCF77Stability_H_
+#define _DCF77Stability_H_
+
+#ifndef DCF77_STAB_OCTAVES
+#define DCF77_STAB_OCTAVES 8    // tau = 1 s .. 128 s
+#endif
+
+class DCF77Stability
+{
+  public:
+    void addEpoch(uint32_t epoch);
+    void reset();
+    float getOffsetPPM();
+    void printCSV();
+
+  private:
+    typedef struct 
+    { 
+      int32_t  xa, xb;      // the last two phase samples in us
+      uint32_t idx;         // sample index of xb
+      uint8_t  fill;        // number of valid samples 0..2
+      float    sum;         // sum of squared second differences
+      uint32_t cnt;
+    } Chain;
+    typedef struct 
+    {
+      Chain    raw;         // phase decimated to tau
+      Chain    mean;        // phase averaged over tau
+      int32_t  pend;        // first half of the next mean
+      uint32_t pendIdx;
+      bool     hasPend;
+    } Octave;
+    void addPhase(uint32_t n, int32_t x);
+    void addSample(Chain &c, uint32_t idx, int32_t x);
+    void addMean(uint8_t k, uint32_t idx, int32_t x);
+    Octave   _octave[DCF77_STAB_OCTAVES];
+    uint32_t _lastEpoch = 0;
+    uint32_t _n = 0;        // seconds since the first epoch
+    int32_t  _x = 0;        // phase of the last epoch in us
+    bool     _started = false;
+};
+#endif
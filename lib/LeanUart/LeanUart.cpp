@@ -0,0 +1,191 @@
+/**
+ * Class        LeanUart.cpp
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Interrupt driven USART0 driver with configurable rings
+ * 
+ * Board        Arduino Uno R3
+ * 
+ * Remarks      Uses the USART RX complete and data register empty 
+ *              interrupts, only compiled with the build flag DCF77_LEAN_UART
+ */
+
+#include <LeanUart.h>
+#ifdef DCF77_LEAN_UART
+
+LeanUart LeanSerial;
+
+ISR(USART_RX_vect)
+{
+  LeanSerial.handleRx();
+}
+
+ISR(USART_UDRE_vect)
+{
+  LeanSerial.handleUdre();
+}
+
+/**
+ * 8N1 with double speed, which gives the smaller
+ * baud rate error at 115200 baud with 16 MHz
+ */
+void LeanUart::begin(uint32_t baud)
+{
+  UBRR0  = (F_CPU / 4 / baud - 1) / 2;
+  UCSR0A = _BV(U2X0);
+  UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+  UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+}
+
+/**
+ * Wait until everything is sent and switch the USART off
+ */
+void LeanUart::end()
+{
+  flush();
+  UCSR0B = 0;
+}
+
+/**
+ * Received bytes are passed to rxHandler in interrupt context
+ * instead of being queued, nullptr switches back to the RX ring
+ */
+void LeanUart::setRxHandler(void (*rxHandler)(uint8_t c))
+{
+  noInterrupts();
+  _rxHandler = rxHandler;
+  interrupts();
+}
+
+/**
+ * Called by the RX complete interrupt
+ */
+void LeanUart::handleRx()
+{
+  bool    error = UCSR0A & _BV(FE0);
+  uint8_t c     = UDR0;
+
+  if (error) return;
+  if (_rxHandler) 
+  {
+    _rxHandler(c);
+  }
+  else if (! _rx.push(c))
+  {
+    _rxOverruns++;
+  }
+}
+
+/**
+ * Called by the data register empty interrupt, 
+ * sends the next byte or stops when the ring is empty
+ */
+void LeanUart::handleUdre()
+{
+  uint8_t c;
+
+  if (_tx.pop(c)) 
+  {
+    UDR0 = c;
+  }
+  else 
+  {
+    UCSR0B &= ~_BV(UDRIE0);
+  }
+}
+
+/**
+ * Queue as many bytes as fit into the TX ring without waiting.
+ * Returns the number of bytes accepted.
+ */
+size_t LeanUart::writeNonBlocking(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+
+  while (n < size && _tx.push(buffer[n])) n++;
+  _tx.notePeak();
+  if (n > 0) UCSR0B |= _BV(UDRIE0);
+  return n;
+}
+
+/**
+ * Queue one byte, wait while the TX ring is full
+ */
+size_t LeanUart::write(uint8_t c)
+{
+  while (! _tx.push(c))
+  {
+    // with interrupts disabled nobody else empties the ring
+    if (! (SREG & 0x80) && (UCSR0A & _BV(UDRE0))) handleUdre();
+  }
+  _tx.notePeak();
+  UCSR0B |= _BV(UDRIE0);
+  return 1;
+}
+
+/**
+ * Queue a buffer, wait while the TX ring is full
+ */
+size_t LeanUart::write(const uint8_t *buffer, size_t size)
+{
+  for (size_t i = 0; i < size; i++) write(buffer[i]);
+  return size;
+}
+
+int LeanUart::availableForWrite()
+{
+  return LEAN_UART_TX_SIZE - 1 - _tx.size();
+}
+
+int LeanUart::available()
+{
+  _rx.notePeak();
+  return _rx.size();
+}
+
+int LeanUart::read()
+{
+  uint8_t c;
+  return _rx.pop(c) ? c : -1;
+}
+
+int LeanUart::peek()
+{
+  uint8_t c;
+  return _rx.peek(c) ? c : -1;
+}
+
+/**
+ * Wait until the TX ring is empty and the last byte has left
+ */
+void LeanUart::flush()
+{
+  while (! _tx.isEmpty()) 
+  {
+    if (! (SREG & 0x80) && (UCSR0A & _BV(UDRE0))) handleUdre();
+  }
+  while ((UCSR0B & _BV(TXEN0)) && ! (UCSR0A & _BV(UDRE0))) ;
+}
+
+/**
+ * Number of received bytes lost because the RX ring was full
+ */
+uint16_t LeanUart::getRxOverruns()
+{
+  return _rxOverruns;
+}
+
+/**
+ * Highest fill levels of the rings, RX as seen by available(), 
+ * TX right after writing
+ */
+uint8_t LeanUart::getRxPeak()
+{
+  return _rx.getPeak();
+}
+
+uint8_t LeanUart::getTxPeak()
+{
+  return _tx.getPeak();
+}
+#endif
@@ -0,0 +1,61 @@
+/**
+ * Header       LeanUart.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Declaration of the class LeanUart, a small interrupt driven
+ *              driver for USART0 of the ATmega328P which replaces the
+ *              Arduino HardwareSerial (2 fixed rings of 64 bytes).
+ *              - buffer sizes are set at build time
+ *              - write() blocks like HardwareSerial, writeNonBlocking() 
+ *                never waits and returns the number of bytes accepted,
+ *                e.g. for binary telemetry bursts
+ *              - an optional receive handler is called from the RX
+ *                interrupt with every byte, bypassing the RX ring
+ * 
+ * Remarks      Enabled with the build flag DCF77_LEAN_UART. The program must
+ *              not use Serial then, otherwise both drivers claim the USART
+ *              interrupts. Use the alias Console from DCF77Console.h.
+ */
+
+#include <Arduino.h>
+#include <SpscQueue.h>
+#ifndef _LeanUart_H_
+#define _LeanUart_H_
+
+#ifndef LEAN_UART_RX_SIZE
+#define LEAN_UART_RX_SIZE 16    // power of 2, max. 128
+#endif
+#ifndef LEAN_UART_TX_SIZE
+#define LEAN_UART_TX_SIZE 64    // power of 2, max. 128
+#endif
+
+class LeanUart : public Stream
+{
+  public:
+    void begin(uint32_t baud);
+    void end();
+    void setRxHandler(void (*rxHandler)(uint8_t c));
+    size_t writeNonBlocking(const uint8_t *buffer, size_t size);
+    virtual size_t write(uint8_t c);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    virtual int availableForWrite();
+    virtual int available();
+    virtual int read();
+    virtual int peek();
+    virtual void flush();
+    uint16_t getRxOverruns();
+    uint8_t getRxPeak();
+    uint8_t getTxPeak();
+    void handleRx();
+    void handleUdre();
+
+  private:
+    SpscQueue<uint8_t, LEAN_UART_RX_SIZE> _rx;
+    SpscQueue<uint8_t, LEAN_UART_TX_SIZE> _tx;
+    void (*_rxHandler)(uint8_t c) = nullptr;
+    volatile uint16_t _rxOverruns = 0;   // bytes lost because the RX ring was full
+};
+
+extern LeanUart LeanSerial;
+#endif
@@ -51,33 +51,176 @@
  */
 #include <Arduino.h>
 #include <DCF77Decoder.h>
+#include <SpscQueue.h>
+#ifdef DCF77_IDLE_SLEEP
+#include <avr/sleep.h>
+#endif
+#ifdef DCF77_SIMULATOR
+#include <DCF77Simulator.h>
+#endif
+#ifdef DCF77_INPUT_CAPTURE
+#include <DCF77Capture.h>
+#endif
+#ifdef DCF77_STABILITY
+#include <DCF77Stability.h>
+#endif
+#ifdef DCF77_INTERFERENCE
+#include <DCF77Interference.h>
+#endif
+#ifdef DCF77_DUTY_CYCLE
+#include <DCF77DutyCycle.h>
+#endif
+#ifdef DCF77_IRIG_B
+#include <DCF77IrigB.h>
+#endif
+#ifdef DCF77_MEMORY
+#include <DCF77Memory.h>
+#endif
+#if (defined(DCF77_ISR_CYCLES) || defined(DCF77_UART_CYCLES)) && (defined(DCF77_INPUT_CAPTURE) || defined(DCF77_IRIG_B))
+#error "DCF77_ISR_CYCLES and DCF77_UART_CYCLES need Timer1, which DCF77_INPUT_CAPTURE and DCF77_IRIG_B use"
+#endif
 char buf[128];
 
-#define CLEAR_LINE Serial.print("\r                                                                                                                        \r")
+#define CLEAR_LINE Console.print("\r                                                                                                                        \r")
 
 bool      timeFromStruct_tm  = false;
 uint32_t  msEvery            = 5000;
+#ifdef DCF77_INPUT_CAPTURE
+const int PIN_DCF77INPUT     = PIN_ICP1;
+#else
 const int PIN_DCF77INPUT     = 2;
+#endif
 const int PIN_DCF77INDICATOR = LED_BUILTIN;
+#ifdef DCF77_DUTY_CYCLE
+const int PIN_DCF77PON       = 4;             // PON of the receiver, low = on
+#endif
+const uint32_t NTP_OFFSET    = 2208988800UL;  // seconds from 1900 to 1970
+const uint32_t MAX_HOLDOVER  = 3600;          // stratum 16 after 1 hour without signal
 tm        dcf77Time;
 
+// A command is a key, for the keys in ARG_KEYS followed by up to 
+// MAX_ARGS numbers and the end of the line. parseCommand() assembles
+// it byte by byte, with DCF77_LEAN_UART in the RX interrupt, and loop()
+// runs the action of every completed command.
+#define MAX_ARGS 2
+const char ARG_KEYS[] = "ip";
+typedef struct { char key; uint8_t nbrArgs; uint32_t args[MAX_ARGS]; } Command;
+SpscQueue<Command, 4> commands;
+Command   command;            // the command being executed
+
 // Forward declaration of menu actions
 void showTelegram();
 void showDateTime();
 void setPrintInterval();
+void setTimePrior();
+void showNtpTime();
+void showLatency();
+void showMetrics();
+#ifdef DCF77_TRACE
+void dumpTrace();
+#endif
+#ifdef DCF77_ISR_CYCLES
+void showIsrCycles();
+#endif
+#ifdef DCF77_UART_CYCLES
+void showUartCycles();
+#endif
 void showMenu();
+#ifdef DCF77_SIMULATOR
+void showSimulator();
+#endif
+#ifdef DCF77_STABILITY
+void showStability();
+#endif
+#ifdef DCF77_INTERFERENCE
+void showInterference();
+#endif
+#ifdef DCF77_DUTY_CYCLE
+void showDutyCycle();
+#endif
+#ifdef DCF77_IRIG_B
+void showIrig();
+#endif
+#ifdef DCF77_MEMORY
+void showMemory();
+void sendMemoryRecord();
+#endif
 
 typedef struct { const char key; const char *txt; void (&action)(); } MenuItem;
 MenuItem menu[] = 
 {
   { 's', "[s] Show received time telegram",                  showTelegram },
   { 't', "[t] Show time from struct tm every interval sec" , showDateTime },
-  { 'i', "[i] Set print interval [sec]",                     setPrintInterval },
+  { 'i', "[i] Set print interval: <sec>",                    setPrintInterval },
+  { 'p', "[p] Set time prior: <UTC since 1970> <+/- sec>",   setTimePrior },
+  { 'n', "[n] Show NTP leap, stratum and timestamp",         showNtpTime },
+  { 'l', "[l] Show max. latency from edge to decoder",       showLatency },
+  { 'm', "[m] Show metrics in Prometheus format",            showMetrics },
+#ifdef DCF77_TRACE
+  { 'd', "[d] Dump trace buffer",                            dumpTrace },
+#endif
+#ifdef DCF77_ISR_CYCLES
+  { 'c', "[c] Show interrupt entry cycles",                  showIsrCycles },
+#endif
+#ifdef DCF77_UART_CYCLES
+  { 'u', "[u] Show console driver cycles per byte",          showUartCycles },
+#endif
+#ifdef DCF77_SIMULATOR
+  { 'x', "[x] Show simulator statistics",                    showSimulator },
+#endif
+#ifdef DCF77_STABILITY
+  { 'a', "[a] Show Allan and time deviation as CSV",         showStability },
+#endif
+#ifdef DCF77_INTERFERENCE
+  { 'g', "[g] Show glitch frequencies and hourly pattern",   showInterference },
+#endif
+#ifdef DCF77_DUTY_CYCLE
+  { 'w', "[w] Show receiver duty cycle and energy",          showDutyCycle },
+#endif
+#ifdef DCF77_IRIG_B
+  { 'b', "[b] Show IRIG-B output state",                     showIrig },
+#endif
+#ifdef DCF77_MEMORY
+  { 'r', "[r] Show RAM, stack high-water and queue peaks",   showMemory },
+  { 'R', "[R] Send RAM figures as binary record",            sendMemoryRecord },
+#endif
   { 'S', "[S] Show menu",                                    showMenu },
 };
 constexpr int nbrMenuItems = sizeof(menu) / sizeof(menu[0]);
 
 DCF77Decoder myDCF77(PIN_DCF77INPUT, PIN_DCF77INDICATOR, dcf77Time);
+#if ! defined(DCF77_SIMULATOR) && ! defined(DCF77_INPUT_CAPTURE)
+DCF77_DECODER_VECTOR(INT0_vect, myDCF77)
+#endif
+#ifdef DCF77_ISR_CYCLES
+// Second decoder on pin 3 (INT1), its edges are made by toggling the pin as output
+const int    PIN_BENCH = 3;
+tm           benchTime;
+DCF77Decoder myBench(PIN_BENCH, PIN_DCF77INDICATOR, benchTime);
+DCF77_DECODER_VECTOR(INT1_vect, myBench)
+#endif
+#ifdef DCF77_SIMULATOR
+DCF77Simulator mySimulator(myDCF77);
+#endif
+#ifdef DCF77_INPUT_CAPTURE
+DCF77Capture myCapture;
+#endif
+#ifdef DCF77_STABILITY
+DCF77Stability myStability;
+#endif
+#ifdef DCF77_INTERFERENCE
+DCF77Interference myInterference;
+#endif
+#ifdef DCF77_DUTY_CYCLE
+DCF77DutyCycle myDutyCycle(myDCF77, PIN_DCF77PON);
+#endif
+#ifdef DCF77_IRIG_B
+DCF77IrigB myIrig(myDCF77);
+#endif
+#ifdef DCF77_MEMORY
+DCF77Memory myMemory;
+bool      memoryRecordPending = false;
+#endif
 
 /**
  * Returns true, as soon as msWait milliseconds have passed.
@@ -113,23 +256,338 @@ void showDateTime()
  */
 void setPrintInterval()
 {
-  int32_t value = 0;
+  uint32_t value = (command.nbrArgs > 0) ? command.args[0] : 0;
+
+  msEvery = (value < 1 || value > 86400UL) ? 1000 : value * 1000;
+  Console.print("Interval set to "); Console.print(msEvery/1000); Console.println(" sec");
+}
 
-  delay(2000);
-  while (Serial.available())
+/**
+ * Take an approximate UTC (seconds since 1970) and its 
+ * uncertainty in seconds, e.g. sent by the host with
+ * echo "p$(date +%s) 30" > /dev/ttyACM0
+ */
+void setTimePrior()
+{
+  uint32_t unixTime    = command.args[0];
+  uint32_t uncertainty = command.args[1];
+
+  if (command.nbrArgs < 2 || unixTime == 0 || uncertainty == 0)
   {
-    value = Serial.parseInt();
+    Console.println("Time prior ignored");
+    return;
   }
-  msEvery = (value < 1) ? 1000 : value * 1000;
-  Serial.print("Interval set to "); Serial.print(msEvery/1000); Serial.print(" sec");
-  delay(1000);
-  CLEAR_LINE;
+  myDCF77.setTimePrior(unixTime, min(uncertainty, 3600UL));
+  Console.print("Time prior set to "); Console.print(unixTime); 
+  Console.print(" +/- "); Console.print(uncertainty); Console.println(" sec");
+}
+
+#ifdef DCF77_SIMULATOR
+/**
+ * Print the number of simulated minutes and
+ * the longest execution time of the timer tick
+ */
+void showSimulator()
+{
+  Console.print("Simulated minutes: "); Console.print(mySimulator.getFrames());
+  Console.print(", max tick load: ");   Console.print(mySimulator.getMaxTickLoad()); Console.println(" us");
+}
+#endif
+
+#ifdef DCF77_STABILITY
+/**
+ * Print the resonator offset and the
+ * stability table measured so far
+ */
+void showStability()
+{
+  myStability.printCSV();
+}
+#endif
+
+#ifdef DCF77_INTERFERENCE
+/**
+ * Print the fingerprint of the
+ * interference seen so far
+ */
+void showInterference()
+{
+  myInterference.printReport();
+}
+#endif
+
+#ifdef DCF77_DUTY_CYCLE
+/**
+ * Print the receiver schedule, acquisition
+ * times, flywheel errors and energy
+ */
+void showDutyCycle()
+{
+  myDutyCycle.printReport();
+}
+#endif
+
+#ifdef DCF77_IRIG_B
+/**
+ * Print the state of the IRIG-B 
+ * output and its lock to DCF77
+ */
+void showIrig()
+{
+  myIrig.printReport();
+}
+#endif
+
+#ifdef DCF77_MEMORY
+/**
+ * Hand the fill levels of all queues 
+ * in this build to the RAM report
+ */
+void noteBuffers()
+{
+  myMemory.setBuffer(0, F("Edge queue"), myDCF77.getEdgePeak(), EDGE_QUEUE - 1);
+#ifdef DCF77_INPUT_CAPTURE
+  myMemory.setBuffer(1, F("Capture queue"), myCapture.getPeak(), CAPTURE_QUEUE - 1);
+#endif
+#ifdef DCF77_LEAN_UART
+  myMemory.setBuffer(2, F("UART RX"), LeanSerial.getRxPeak(), LEAN_UART_RX_SIZE - 1);
+  myMemory.setBuffer(3, F("UART TX"), LeanSerial.getTxPeak(), LEAN_UART_TX_SIZE - 1);
+#endif
+}
+
+/**
+ * Print static RAM, heap, stack high-water 
+ * mark, free RAM and the queue peaks
+ */
+void showMemory()
+{
+  noteBuffers();
+  myMemory.printReport();
+}
+
+/**
+ * Send the same figures as binary record for tools/dcf77memory.py,
+ * loop() retries until the record fits into the TX buffer
+ */
+void sendMemoryRecord()
+{
+  memoryRecordPending = true;
 }
+#endif
+
+/**
+ * Print the fields a SNTP server needs in one line:
+ * NTP <leap indicator> <stratum> <seconds since 1900>.<ms>
+ * The SNTP server of the host clock, tools/host/dcf77sntp.c, 
+ * sets leap and stratum by the same rules.
+ */
+void showNtpTime()
+{
+  uint32_t seconds = 0;
+  uint16_t ms      = 0;
+  uint8_t  leap    = 3;   // 3 = clock not synchronized
+  uint8_t  stratum = 16;
+
+  if (myDCF77.getUnixTime(seconds, ms))
+  {
+    leap    = (myDCF77.getFlags() & DCF77_FLAG_LEAP) ? 1 : 0;
+    stratum = (myDCF77.getHoldover() < MAX_HOLDOVER) ? 1 : 16;
+    seconds += NTP_OFFSET;
+  }
+  snprintf(buf, sizeof(buf), "NTP %u %u %lu.%03u", leap, stratum, (unsigned long)seconds, ms);
+  Console.println(buf);
+}
+
+/**
+ * Print the longest time an edge waited 
+ * in the interrupt handoff for loop()
+ */
+void showLatency()
+{
+  Console.print("Max. edge latency: "); Console.print(myDCF77.getMaxLatency()); Console.println(" us");
+}
+
+/**
+ * Print the decoder metrics, a host side 
+ * exporter forwards them to Prometheus
+ */
+void showMetrics()
+{
+  myDCF77.printMetrics();
+}
+
+#ifdef DCF77_TRACE
+/**
+ * Print the trace buffer for 
+ * conversion by tools/dcf77trace.py
+ */
+void dumpTrace()
+{
+  dcf77Trace.dump();
+}
+#endif
+
+#ifdef DCF77_ISR_CYCLES
+/**
+ * Count the CPU cycles of the interrupt entry with Timer1: from an 
+ * edge on pin 3 to the return from the vector of myBench, the handler
+ * of myBench called directly and the difference, the cost of entering
+ * and leaving the interrupt. The least of 64 runs counts, the others
+ * may include an interrupt of Timer0.
+ */
+void showIsrCycles()
+{
+  uint16_t read = 0xFFFF, idle = 0xFFFF, edge = 0xFFFF, direct = 0xFFFF, t;
+
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);             // 1 count per cycle
+  DDRD  |= _BV(PD3);
+  myBench.attach();
+  for (uint8_t i = 0; i < 64; i++)
+  {
+    // the edge, flagged while interrupts are off, is taken after the nop behind sei()
+    for (uint8_t taken = 0; taken < 2; taken++)
+    {
+      if (taken) EIMSK |= _BV(INT1); else EIMSK &= ~_BV(INT1);
+      cli();
+      t = TCNT1;
+      PIND = _BV(PD3);
+      __asm__ __volatile__ ("nop\n\tnop");
+      sei();
+      __asm__ __volatile__ ("nop");
+      t = TCNT1 - t;
+      if (taken) edge = min(edge, t); else idle = min(idle, t);
+      EIFR = _BV(INTF0) << INT1;
+    }
+    cli();
+    t = TCNT1;
+    t = TCNT1 - t;
+    read = min(read, t);
+    t = TCNT1;
+    myBench.handleInterrupt();
+    t = TCNT1 - t;
+    direct = min(direct, t);
+    sei();
+    myBench.loop();               // drains the edge queue of myBench
+  }
+  EIMSK &= ~_BV(INT1);
+  DDRD  &= ~_BV(PD3);
+  PORTD &= ~_BV(PD3);
+  TCCR1B = 0;
+
+  edge   -= idle;
+  direct -= read;
+  Console.print(F("Edge to return from vector: ")); Console.print(edge);          Console.println(F(" cycles"));
+  Console.print(F("Handler called directly:    ")); Console.print(direct);        Console.println(F(" cycles"));
+  Console.print(F("Entry and exit:             ")); Console.print(edge - direct); Console.println(F(" cycles"));
+}
+#endif
+
+#ifdef DCF77_UART_CYCLES
+/**
+ * Interrupt handlers of the console driver, 
+ * LeanSerial or Serial of the Arduino core
+ */
+inline void uartRx()
+{
+#ifdef DCF77_LEAN_UART
+  LeanSerial.handleRx();
+#else
+  Serial._rx_complete_irq();
+#endif
+}
+
+inline void uartUdre()
+{
+#ifdef DCF77_LEAN_UART
+  LeanSerial.handleUdre();
+#else
+  Serial._tx_udr_empty_irq();
+#endif
+}
+
+typedef struct { uint16_t least; uint16_t most; uint8_t n; } Cycles;
+
+void noteCycles(Cycles &c, uint16_t t)
+{
+  c.least = min(c.least, t);
+  c.most  = max(c.most, t);
+  c.n++;
+}
+
+void printCycles(const __FlashStringHelper *name, const Cycles &c)
+{
+  Console.print(name); 
+  Console.print(c.least); Console.print(F(" .. ")); Console.print(c.most); 
+  Console.print(F(" cycles, ")); Console.print(c.n); Console.println(F(" bytes"));
+}
+
+/**
+ * Count the CPU cycles per byte of the console driver with Timer1 and
+ * interrupts off, so the handlers are called here instead of by their
+ * interrupts: write() of 16 bytes, the UDRE handler for every byte it 
+ * sends and the RX handler for 16 received bytes, least and most. The 
+ * RX handler of LeanUart includes parseCommand(), the one of 
+ * HardwareSerial only queues the byte for loop(). Millis and the edges
+ * of the receiver are lost while it waits up to 10 s for the bytes.
+ */
+void showUartCycles()
+{
+  const uint8_t BYTES = 16;
+  Cycles   write = { 0xFFFF, 0, 0 }, udre = { 0xFFFF, 0, 0 }, rx = { 0xFFFF, 0, 0 };
+  uint16_t t, overflows = 0;
+  int      empty;
+
+  Console.println(F("Send a line of 16 blanks within 10 s"));
+  Console.flush();
+  empty  = Console.availableForWrite();
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);             // 1 count per cycle
+  TIFR1  = _BV(TOV1);
+  cli();
+  for (uint8_t i = 0; i < BYTES; i++)
+  {
+    t = TCNT1;
+    Console.write('-');
+    t = TCNT1 - t;
+    noteCycles(write, t);
+  }
+  while (Console.availableForWrite() < empty)
+  {
+    while (! (UCSR0A & _BV(UDRE0))) ;
+    t = TCNT1;
+    uartUdre();
+    t = TCNT1 - t;
+    noteCycles(udre, t);
+  }
+  // 2441 overflows of 4.096 ms are 10 s
+  while (rx.n < BYTES && overflows < 2441)
+  {
+    if (TIFR1 & _BV(TOV1))
+    {
+      TIFR1 = _BV(TOV1);
+      overflows++;
+    }
+    if (! (UCSR0A & _BV(RXC0))) continue;
+    t = TCNT1;
+    uartRx();
+    t = TCNT1 - t;
+    noteCycles(rx, t);
+  }
+  sei();
+  TCCR1B = 0;
+
+  Console.println();
+  printCycles(F("write():      "), write);
+  printCycles(F("UDRE handler: "), udre);
+  printCycles(F("RX handler:   "), rx);
+}
+#endif
 
 void showMenu()
 {
   // title is packed into a raw string
-  Serial.print(
+  Console.print(
   R"TITLE(
 -----------------
 DCF77 Radio Clock
@@ -138,22 +596,59 @@ DCF77 Radio Clock
 
   for (int i = 0; i < nbrMenuItems; i++)
   {
-  Serial.println(menu[i].txt);
+  Console.println(menu[i].txt);
+  }
+  Console.print("\nPress a key: ");
+}
+
+/**
+ * Assemble the commands from the received bytes, see Command.
+ * Digits form the numbers, any other byte separates them.
+ * Never blocks, with DCF77_LEAN_UART it runs in the RX interrupt.
+ */
+void parseCommand(uint8_t c)
+{
+  static Command next     = { 0, 0, { 0 } };
+  static bool    inNumber = false;
+
+  if (next.key == 0)
+  {
+    if (c <= ' ') return;   // line ends and blanks between commands
+    next.key     = c;
+    next.nbrArgs = 0;
+    inNumber     = false;
+    if (strchr(ARG_KEYS, c) != nullptr) return;
+  }
+  else if (c >= '0' && c <= '9')
+  {
+    if (! inNumber)
+    {
+      if (next.nbrArgs == MAX_ARGS) return;
+      next.args[next.nbrArgs++] = 0;
+      inNumber = true;
+    }
+    next.args[next.nbrArgs - 1] = 10 * next.args[next.nbrArgs - 1] + (c - '0');
+    return;
   }
-  Serial.print("\nPress a key: ");
+  else if (c != '\r' && c != '\n')
+  {
+    inNumber = false;
+    return;
+  }
+  commands.push(next);      // dropped if loop() is that far behind
+  next.key = 0;
 }
 
 /**
- * Get the keystroke from the operator and 
- * perform the corresponding action
+ * Perform the action of the command
+ * taken from the queue
  */
 void doMenu()
 {
-  char key = Serial.read();
   CLEAR_LINE;
   for (int i = 0; i < nbrMenuItems; i++)
   {
-  if (key == menu[i].key)
+  if (command.key == menu[i].key)
     {
     menu[i].action();
     break;
@@ -161,22 +656,40 @@ void doMenu()
   }
 }
 
-// Interrupt Service Routine
-// Wrapper for interrupt handler hidden in class DCF77Decoder
-void isr()
-{
-  myDCF77.handleInterrupt();  
-} 
-
 void initDCF77Decoder()
 {
   myDCF77.setVerbose(true);  // Print time telegram
-  attachInterrupt(digitalPinToInterrupt(PIN_DCF77INPUT), isr, CHANGE);
+#ifdef DCF77_SIMULATOR
+  // Synthetic signal instead of the receiver, starts at Sa 2016-03-05 09:39 MEZ
+  tm simStart;
+  simStart.tm_sec   = 0;
+  simStart.tm_min   = 39;
+  simStart.tm_hour  = 9;
+  simStart.tm_mday  = 5;
+  simStart.tm_wday  = 6;
+  simStart.tm_mon   = 2;
+  simStart.tm_year  = 116;
+  simStart.tm_isdst = 0;
+  mySimulator.begin(simStart);
+#elif defined(DCF77_INPUT_CAPTURE)
+  myCapture.begin();
+#else
+  myDCF77.attach();     // INT0, its vector is DCF77_DECODER_VECTOR(INT0_vect, myDCF77)
+#endif
+#ifdef DCF77_DUTY_CYCLE
+  myDutyCycle.begin(DCF77_DUTY_PERIOD, DCF77_DUTY_WINDOW);
+#endif
+#ifdef DCF77_IRIG_B
+  myIrig.begin();
+#endif
 }
 
 void setup()
 {
-  Serial.begin(115200);
+  Console.begin(115200);
+#ifdef DCF77_LEAN_UART
+  Console.setRxHandler(parseCommand);
+#endif
   initDCF77Decoder();
   showMenu();
 }
@@ -185,16 +698,77 @@ void loop()
 {
   static uint32_t msPrevious = millis();
 
+#ifdef DCF77_INPUT_CAPTURE
+  // hand the hardware timestamped edges to the decoder queue
+  int      edgeModes[4];
+  uint32_t edgeMillis[4], edgeMicros[4];
+  uint8_t  nbrEdges = myCapture.readEdges(edgeModes, edgeMillis, edgeMicros, 4);
+  for (uint8_t i = 0; i < nbrEdges; i++)
+  {
+    myDCF77.handleEdge(edgeModes[i], edgeMillis[i], edgeMicros[i]);
+  }
+#endif
   myDCF77.loop(); // keep decoding signal received from DCF77
+#ifdef DCF77_DUTY_CYCLE
+  myDutyCycle.loop();
+#ifdef DCF77_SIMULATOR
+  mySimulator.setReceiverPower(myDutyCycle.isReceiverOn());
+#endif
+#endif
+#if defined(DCF77_STABILITY) || defined(DCF77_IRIG_B)
+  uint32_t epoch;
+  while (myDCF77.getSecondEpoch(epoch))
+  {
+#ifdef DCF77_STABILITY
+    myStability.addEpoch(epoch);
+#endif
+#ifdef DCF77_IRIG_B
+    myIrig.addEpoch(epoch);
+#endif
+  }
+#endif
+#ifdef DCF77_IRIG_B
+  myIrig.loop();
+#endif
+#ifdef DCF77_INTERFERENCE
+  uint32_t glitch;
+  while (myDCF77.getGlitchEpoch(glitch))
+  {
+    myInterference.addGlitch(glitch, myDCF77.isReady() ? dcf77Time.tm_hour : IF_NOHOUR);
+  }
+#endif
 
   // Print time in customized format when timeFromStruct_tm is 
   // set to true, which implies that setVerbose(false) is called.
   // The decoder fills in the time info into the tm structure 
   // you supplied in the constructor
+  // The line is dropped if the host does not keep up, it never stalls loop()
   if (waitIsOver(msPrevious, msEvery) && myDCF77.isReady() && timeFromStruct_tm)
   {
-    strftime(buf, sizeof(buf), "%a %F %T", &dcf77Time);
-    Serial.println(buf);
+    size_t n = strftime(buf, sizeof(buf) - 2, "%a %F %T", &dcf77Time);
+    buf[n++] = '\r';
+    buf[n++] = '\n';
+    consoleWriteNonBlocking((const uint8_t *)buf, n);
+  }
+#ifndef DCF77_LEAN_UART
+  while (Console.available()) parseCommand(Console.read());
+#endif
+  while (commands.pop(command)) doMenu();
+#ifdef DCF77_MEMORY
+  if (memoryRecordPending)
+  {
+    noteBuffers();
+    memoryRecordPending = ! myMemory.writeRecord();
+  }
+#endif
+
+#ifdef DCF77_IDLE_SLEEP
+  // Nothing to do, sleep until the next interrupt instead of polling.
+  // Timer0 wakes up the CPU at least every 1.024 ms.
+  if (! myDCF77.hasPendingEdges() && ! Console.available() && commands.isEmpty())
+  {
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_mode();
   }
-  if (Serial.available()) doMenu();
+#endif
 }
@@ -0,0 +1,385 @@
+/**
+ * Program      test_main.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Unit tests of the decoding core (lib/DCF77Core) on the host
+ *
+ * Usage        pio test -e native
+ */
+
+#include <unity.h>
+#include <DCF77Core.h>
+#include <DCF77Thresholds.h>
+#include <DCF77Bank.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/**
+ * Decoded time of a telegram encoded from the given fields
+ */
+static int decode(uint8_t year, uint8_t month, uint8_t mday, uint8_t wday,
+                  uint8_t hour, uint8_t minute, int8_t isdst, dcf77_time *time)
+{
+  dcf77_time t = { minute, hour, mday, wday, month, year, isdst, DCF77_OK, 0, { 0 } };
+  return dcf77_decode_frame(dcf77_encode_frame(&t), time);
+}
+
+static void test_unix_time_2024(void)
+{
+  dcf77_time t;
+  TEST_ASSERT_EQUAL_INT(DCF77_OK, decode(24, 2, 29, 4, 1, 0, 0, &t));   // Do 2024-02-29 01:00 MEZ
+  TEST_ASSERT_EQUAL_UINT32(1709164800UL, dcf77_unix_time(&t));
+}
+
+static void test_unix_time_after_2038(void)
+{
+  dcf77_time t;
+  TEST_ASSERT_EQUAL_INT(DCF77_OK, decode(38, 1, 19, 2, 4, 15, 0, &t));  // Di 2038-01-19 04:15 MEZ
+  TEST_ASSERT_EQUAL_UINT32(2147483700UL, dcf77_unix_time(&t));          // past INT32_MAX
+}
+
+static void test_unix_time_2099(void)
+{
+  dcf77_time t;
+  TEST_ASSERT_EQUAL_INT(DCF77_OK, decode(99, 12, 31, 4, 23, 59, 0, &t)); // Do 2099-12-31 23:59 MEZ
+  TEST_ASSERT_EQUAL_UINT32(4102441140UL, dcf77_unix_time(&t));
+  TEST_ASSERT_EQUAL_UINT32(4102441140UL, dcf77_unix_time_days(dcf77_day_number(&t), &t));
+  TEST_ASSERT_EQUAL_INT(DCF77_OK, decode(99, 6, 30, 2, 12, 0, 1, &t));   // Di 2099-06-30 12:00 MESZ
+  TEST_ASSERT_EQUAL_UINT32(4086496800UL, dcf77_unix_time(&t));
+}
+
+static void test_from_unix_2099(void)
+{
+  dcf77_time t;
+  dcf77_from_unix(4102441140UL, 0, &t);
+  TEST_ASSERT_EQUAL_UINT8(99, t.year);
+  TEST_ASSERT_EQUAL_UINT8(12, t.month);
+  TEST_ASSERT_EQUAL_UINT8(31, t.mday);
+  TEST_ASSERT_EQUAL_UINT8(4, t.wday);
+  TEST_ASSERT_EQUAL_UINT8(23, t.hour);
+  TEST_ASSERT_EQUAL_UINT8(59, t.minute);
+}
+
+static void test_clock_keeps_fractions(void)
+{
+  // input capture: 4 us ticks, every edge 249 ticks past a whole ms
+  dcf77_clock clock;
+  uint64_t    total = 0;
+  uint32_t    ticks = 0xFFFF0000UL;   // the tick counter wraps during the test
+  uint32_t    ms    = 0;
+  dcf77_clock_init(&clock, ticks, 1000, 250);
+  for (uint32_t i = 0; i < 100000UL; i++)
+  {
+    uint32_t delta = 250UL * (i % 800) + 249;
+    ticks += delta;
+    total += delta;
+    ms = dcf77_clock_millis(&clock, ticks);
+    if (ms != 1000 + total / 250) break;
+  }
+  TEST_ASSERT_EQUAL_UINT32(1000 + total / 250, ms);
+  TEST_ASSERT_EQUAL_UINT16(total % 250, clock.remainder);
+}
+
+/**
+ * Feed the pulses of a telegram beginning at start ms, without the
+ * pulses of the seconds in drops and with a short glitch after the 
+ * pulse of second glitch (none if >= FRAMEBITS)
+ */
+static void push_telegram(dcf77_ctx *ctx, dcf77_slots *slots, uint32_t start, uint64_t frame, 
+                          uint64_t drops, uint8_t glitch)
+{
+  for (uint8_t second = 0; second < FRAMEBITS; second++)
+  {
+    uint32_t rise = start + 1000UL * second;
+    if ((drops >> second) & 1) continue;
+    dcf77_push_framed_edge(ctx, slots, rise, 1);
+    dcf77_push_framed_edge(ctx, slots, rise + (((frame >> second) & 1) ? P1 : P0), 0);
+    if (second != glitch) continue;
+    dcf77_push_framed_edge(ctx, slots, rise + 500, 1);
+    dcf77_push_framed_edge(ctx, slots, rise + 510, 0);
+  }
+}
+
+static void test_framed_edge_repairs_slip(void)
+{
+  // sync in minute 0, framing confirmed in minute 1, a glitch adds a second to minute 2
+  dcf77_ctx   ctx;
+  dcf77_slots slots;
+  dcf77_time  t;
+  dcf77_init(&ctx);
+  dcf77_slots_init(&slots);
+  for (uint8_t m = 0; m < 3; m++)
+  {
+    dcf77_from_unix(1709161080UL + 60 * m, 0, &t);
+    uint64_t frame = dcf77_encode_frame(&t);
+    push_telegram(&ctx, &slots, 1000 + 60000UL * m, frame, 0, (m == 2) ? 30 : 0xFF);
+    TEST_ASSERT_EQUAL_INT(DCF77_EV_MINUTE, dcf77_push_framed_edge(&ctx, &slots, 61000UL + 60000UL * m, 1));
+    if (m == 0) continue;
+    TEST_ASSERT_EQUAL_UINT8((m == 2) ? DCF77_FIX_SLIP | DCF77_FIX_REBUILT : 0, slots.repairs);
+    TEST_ASSERT_TRUE(ctx.frame == frame);
+  }
+  TEST_ASSERT_EQUAL_UINT8(FRAMEBITS + 1, ctx.nbrBits);
+}
+
+static void test_framed_edge_rejects_stale_bits(void)
+{
+  // 01:40 then 01:41 MEZ without the pulses of bits 21 and 28: the counted
+  // telegram keeps both bits of 01:40 and passes the parity check
+  dcf77_ctx   ctx;
+  dcf77_slots slots;
+  dcf77_time  t;
+  uint64_t    drops = ((uint64_t)1 << 21) | ((uint64_t)1 << 28);
+  dcf77_init(&ctx);
+  dcf77_slots_init(&slots);
+  for (uint8_t m = 0; m < 3; m++)
+  {
+    dcf77_from_unix(1709164800UL + 60 * (39 + m), 0, &t);
+    push_telegram(&ctx, &slots, 1000 + 60000UL * m, dcf77_encode_frame(&t), (m == 2) ? drops : 0, 0xFF);
+    TEST_ASSERT_EQUAL_INT(DCF77_EV_MINUTE, dcf77_push_framed_edge(&ctx, &slots, 61000UL + 60000UL * m, 1));
+  }
+  TEST_ASSERT_EQUAL_UINT8(FRAMEBITS, ctx.nbrBits);
+  TEST_ASSERT_EQUAL_INT(DCF77_OK, dcf77_check_frame(ctx.frame));
+  TEST_ASSERT_EQUAL_INT(DCF77_OK, dcf77_decode_frame(ctx.frame, &t));
+  TEST_ASSERT_EQUAL_UINT8(40, t.minute);
+  TEST_ASSERT_EQUAL_UINT8(DCF77_FIX_REJECTED, slots.repairs);
+}
+
+static void test_framed_edges_decode_rebuilt_frame(void)
+{
+  // the stream of test_framed_edge_repairs_slip as one batch: the telegram
+  // with the glitch is rebuilt and valid, unframed it has a wrong length
+  uint32_t    times[3 * 2 * (FRAMEBITS + 1) + 1];
+  uint8_t     levels[sizeof(times) / sizeof(times[0])];
+  dcf77_frame frames[4];
+  dcf77_time  t[4];
+  dcf77_ctx   ctx;
+  dcf77_slots slots;
+  size_t      n = 0;
+  for (uint8_t m = 0; m < 3; m++)
+  {
+    dcf77_from_unix(1709161080UL + 60 * m, 0, &t[0]);
+    uint64_t frame = dcf77_encode_frame(&t[0]);
+    for (uint8_t second = 0; second < FRAMEBITS; second++)
+    {
+      uint32_t rise = 1000 + 60000UL * m + 1000UL * second;
+      times[n] = rise;                                         levels[n++] = 1;
+      times[n] = rise + (((frame >> second) & 1) ? P1 : P0);   levels[n++] = 0;
+      if (m != 2 || second != 30) continue;
+      times[n] = rise + 500;                                   levels[n++] = 1;
+      times[n] = rise + 510;                                   levels[n++] = 0;
+    }
+  }
+  times[n] = 181000UL; levels[n++] = 1;
+
+  dcf77_init(&ctx);
+  dcf77_slots_init(&slots);
+  TEST_ASSERT_EQUAL_UINT32(2, (uint32_t)dcf77_push_framed_edges(&ctx, &slots, times, levels, n, frames, 4));
+  TEST_ASSERT_EQUAL_UINT8(DCF77_FIX_SLIP | DCF77_FIX_REBUILT, frames[1].repairs);
+  TEST_ASSERT_EQUAL_UINT32(2, (uint32_t)dcf77_decode_frames(frames, t, 2));
+  TEST_ASSERT_EQUAL_UINT32(1709161080UL + 120, dcf77_unix_time(&t[1]));
+
+  dcf77_init(&ctx);
+  TEST_ASSERT_EQUAL_UINT32(2, (uint32_t)dcf77_push_edges(&ctx, times, levels, n, frames, 4));
+  TEST_ASSERT_EQUAL_UINT32(1, (uint32_t)dcf77_decode_frames(frames, t, 2));
+}
+
+/**
+ * Feed the grid the pulses from second first of the minute beginning at
+ * the UTC seconds start until dcf77_grid_lock() decides with the prior
+ * firstUnix, returns its result, the second of the last pulse in *last
+ */
+static int lock_grid(dcf77_ctx *ctx, dcf77_slots *slots, uint32_t start, uint8_t first, 
+                     uint32_t firstUnix, uint16_t uncertainty, uint8_t *last)
+{
+  dcf77_grid grid;
+  dcf77_time t;
+  int        result = -1;
+  dcf77_init(ctx);
+  dcf77_slots_init(slots);
+  dcf77_grid_init(&grid);
+  for (uint32_t i = first; i < first + 60UL && result < 0; i++)
+  {
+    if (i % 60 == 59) continue;                      // no pulse before the minute mark
+    dcf77_from_unix(start + 60 * (i / 60) + 60, 0, &t);   // telegram sent in the minute of i
+    uint64_t frame = dcf77_encode_frame(&t);
+    *last  = dcf77_grid_push(&grid, 5000 + 1000UL * (i - first), (frame >> (i % 60)) & 1);
+    result = dcf77_grid_lock(&grid, firstUnix, uncertainty, ctx, slots);
+  }
+  return result;
+}
+
+static void test_grid_locks_in_mid_minute(void)
+{
+  // first pulse at second 30, candidates of every second within the
+  // first minute count before the right one and must not reject it
+  dcf77_ctx   ctx;
+  dcf77_slots slots;
+  dcf77_time  t;
+  uint8_t     last;
+  TEST_ASSERT_EQUAL_INT(1, lock_grid(&ctx, &slots, 1709161080UL, 30, 1709161080UL + 30 - 15, 20, &last));
+  TEST_ASSERT_EQUAL_UINT8(59, last);                 // second 29 of the next minute
+  TEST_ASSERT_EQUAL_UINT8(29, slots.lastSlot);
+  TEST_ASSERT_EQUAL_UINT8(30, ctx.seconds);
+  TEST_ASSERT_EQUAL_UINT8(1, ctx.synchronized);
+  TEST_ASSERT_EQUAL_INT(DCF77_OK, dcf77_decode_frame(ctx.frame, &t));
+  TEST_ASSERT_EQUAL_UINT32(1709161080UL + 120, dcf77_unix_time(&t));
+  TEST_ASSERT_EQUAL_UINT32(64000UL - 29000UL, slots.lastMillis - slots.lastSlot * 1000UL);
+}
+
+static void test_grid_rejects_wrong_date(void)
+{
+  // a prior one day off agrees in time zone and time, but not in the date
+  dcf77_ctx   ctx;
+  dcf77_slots slots;
+  uint8_t     last;
+  TEST_ASSERT_EQUAL_INT(0, lock_grid(&ctx, &slots, 1709161080UL, 0, 1709161080UL + 86400UL, 300, &last));
+  TEST_ASSERT_EQUAL_UINT8(0, ctx.synchronized);
+  TEST_ASSERT_EQUAL_INT(1, lock_grid(&ctx, &slots, 1709161080UL, 0, 1709161080UL + 250, 300, &last));
+  TEST_ASSERT_EQUAL_UINT8(FRAMEBITS - 1, last);
+}
+
+/**
+ * Random stream of edges with pulse widths and pauses around all the
+ * windows, mostly alternating levels and now and then a repeated one
+ */
+static void random_edges(uint32_t *times, uint8_t *levels, size_t n, uint32_t seed)
+{
+  static const uint16_t widths[] = { P0, P1, P0 - JITTER, P0 + JITTER, P1 - JITTER, P1 + JITTER, 
+                                     MIN_SYNCGAP - JITTER, MAX_SYNCGAP + JITTER, 900, 1850, 5 };
+  uint32_t t = 0xFFFF0000UL;   // the timestamps wrap during the test
+  uint8_t  level = 0;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    t += widths[seed % (sizeof(widths) / sizeof(widths[0]))] + (int8_t)(seed >> 24) % 3;
+    if ((seed >> 8) % 16) level ^= 1;
+    times[i]  = t;
+    levels[i] = level;
+  }
+}
+
+static void test_classify_batch_equals_push_edge(void)
+{
+  uint32_t  times[2000];
+  uint8_t   levels[2000], events[2000];
+  dcf77_ctx ctx, ref;
+
+  for (uint32_t seed = 1; seed <= 20; seed++)
+  {
+    random_edges(times, levels, 2000, seed);
+    dcf77_init(&ctx);
+    ctx.startPulse = times[0] - 150;
+    ctx.endPulse   = times[0] - 1850;
+    ref = ctx;
+    for (size_t base = 0; base < 2000; base += 500)
+    { // in batches, each continuing from the state after the last one
+      dcf77_classify_batch(&ref, times + base, levels + base, 500, events + base);
+      for (size_t i = base; i < base + 500; i++)
+      {
+        TEST_ASSERT_EQUAL_INT(dcf77_push_edge(&ctx, times[i], levels[i]), events[i]);
+      }
+      ref = ctx;
+    }
+  }
+}
+
+static void test_find_sync_gap_equals_push_edge(void)
+{
+  uint32_t  times[2000];
+  uint8_t   levels[2000];
+  dcf77_ctx ctx, ref;
+
+  for (uint32_t seed = 1; seed <= 20; seed++)
+  {
+    random_edges(times, levels, 2000, seed);
+    dcf77_init(&ctx);
+    ctx.endPulse = times[0] - 500;
+    for (size_t base = 0; base < 2000; )
+    {
+      ref = ctx;
+      size_t found = base + dcf77_find_sync_gap(&ref, times + base, levels + base, 2000 - base);
+      size_t i     = base;
+      while (i < 2000 && dcf77_push_edge(&ctx, times[i], levels[i]) != DCF77_EV_MINUTE) i++;
+      TEST_ASSERT_EQUAL_UINT32((uint32_t)i, (uint32_t)found);
+      base = i + 1;
+    }
+  }
+}
+
+static void test_bank_equals_contexts(void)
+{
+  enum { CHANNELS = 8, EDGES = 1000, BATCH = 50 };
+  static uint32_t  times[CHANNELS][EDGES], batchTimes[CHANNELS * BATCH], batchChannels[CHANNELS * BATCH];
+  static uint8_t   levels[CHANNELS][EDGES], batchLevels[CHANNELS * BATCH];
+  static uint64_t  memory[CHANNELS * 3];
+  dcf77_bank_frame frames[CHANNELS * BATCH];
+  dcf77_ctx        ctx[CHANNELS];
+  dcf77_bank       bank;
+  size_t           nbrFrames = 0;
+
+  TEST_ASSERT_TRUE(sizeof(memory) >= dcf77_bank_size(CHANNELS));
+  dcf77_bank_init(&bank, CHANNELS, memory);
+  for (uint32_t c = 0; c < CHANNELS; c++)
+  {
+    random_edges(times[c], levels[c], EDGES, 100 + c);
+    dcf77_init(&ctx[c]);
+  }
+  for (size_t base = 0; base < EDGES; base += BATCH)
+  { // one batch sorted by channel, each channel with a run of its edges
+    size_t n = 0, expected = 0;
+    for (uint32_t c = 0; c < CHANNELS; c++)
+    {
+      for (size_t i = base; i < base + BATCH; i++, n++)
+      {
+        batchChannels[n] = c;
+        batchTimes[n]    = times[c][i];
+        batchLevels[n]   = levels[c][i];
+      }
+    }
+    nbrFrames = dcf77_bank_push_edges(&bank, batchChannels, batchTimes, batchLevels, n, frames, n);
+    for (uint32_t c = 0; c < CHANNELS; c++)
+    {
+      for (size_t i = base; i < base + BATCH; i++)
+      {
+        uint64_t frame = ctx[c].frame;
+        uint8_t  sync  = ctx[c].synchronized;
+        if (dcf77_push_edge(&ctx[c], times[c][i], levels[c][i]) != DCF77_EV_MINUTE || ! sync) continue;
+        TEST_ASSERT_TRUE(expected < nbrFrames);
+        TEST_ASSERT_EQUAL_UINT32(c, frames[expected].channel);
+        TEST_ASSERT_EQUAL_UINT32(times[c][i], frames[expected].markTime);
+        TEST_ASSERT_EQUAL_UINT8(ctx[c].nbrBits, frames[expected].nbrBits);
+        TEST_ASSERT_TRUE(frame == frames[expected].frame);
+        expected++;
+      }
+    }
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)expected, (uint32_t)nbrFrames);
+  }
+  for (uint32_t c = 0; c < CHANNELS; c++)
+  {
+    TEST_ASSERT_TRUE(ctx[c].frame == bank.frame[c]);
+    TEST_ASSERT_EQUAL_UINT8(ctx[c].seconds, bank.seconds[c]);
+  }
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_unix_time_2024);
+  RUN_TEST(test_unix_time_after_2038);
+  RUN_TEST(test_unix_time_2099);
+  RUN_TEST(test_from_unix_2099);
+  RUN_TEST(test_clock_keeps_fractions);
+  RUN_TEST(test_framed_edge_repairs_slip);
+  RUN_TEST(test_framed_edge_rejects_stale_bits);
+  RUN_TEST(test_framed_edges_decode_rebuilt_frame);
+  RUN_TEST(test_grid_locks_in_mid_minute);
+  RUN_TEST(test_grid_rejects_wrong_date);
+  RUN_TEST(test_classify_batch_equals_push_edge);
+  RUN_TEST(test_find_sync_gap_equals_push_edge);
+  RUN_TEST(test_bank_equals_contexts);
+  return UNITY_END();
+}
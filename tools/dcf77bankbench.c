@@ -0,0 +1,167 @@
+/**
+ * Program      dcf77bankbench.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Compares the decoder bank (DCF77Bank.h) with an array of one
+ *              dcf77_ctx per channel, which is the state a DCF77Decoder 
+ *              object wraps. Prints edges per second, bytes per channel and
+ *              the number and sum of the telegrams, which must be equal for
+ *              all runs. The array of contexts with the edges sorted by 
+ *              channel is the baseline the bank has to beat.
+ * 
+ * Build        cc -O3 -march=native -Ilib/DCF77Core tools/dcf77bankbench.c \
+ *                 lib/DCF77Core/DCF77Core.c lib/DCF77Core/DCF77Bank.c -o dcf77bankbench
+ * 
+ * Usage        ./dcf77bankbench [channels] [seconds]     default 10000 180
+ */
+
+#define _POSIX_C_SOURCE 199309L   // clock_gettime() with -std=c99
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <DCF77Core.h>
+#include <DCF77Bank.h>
+
+#define RUNS 5      // each variant is timed this often, the best run counts
+
+typedef struct { uint32_t channel; uint32_t time; uint8_t level; } Edge;
+
+static int byTime(const void *a, const void *b)
+{
+  const Edge *x = (const Edge *)a, *y = (const Edge *)b;
+  return (x->time > y->time) - (x->time < y->time);
+}
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t nbrChannels = (argc > 1) ? (uint32_t)atol(argv[1]) : 10000;
+  uint32_t nbrSeconds  = (argc > 2) ? (uint32_t)atol(argv[2]) : 180;
+  uint32_t *offset     = malloc(nbrChannels * sizeof(uint32_t));
+  uint32_t *start      = malloc(nbrChannels * sizeof(uint32_t));
+  size_t   perSecond   = 2 * (size_t)nbrChannels;
+  Edge     *edges      = malloc(nbrSeconds * perSecond * sizeof(Edge));
+  size_t   *batchStart = malloc((nbrSeconds + 1) * sizeof(size_t));
+  size_t   nbrEdges    = 0;
+
+  srand(77);
+  for (uint32_t c = 0; c < nbrChannels; c++)
+  {
+    offset[c] = rand() % 1000;                          // phase of the receiver clock
+    start[c]  = 1700000000UL + 60 * (rand() % 100000);   // time of the first minute mark
+  }
+  // one batch per second, the edges of each channel in channel order
+  for (uint32_t s = 0; s < nbrSeconds; s++)
+  {
+    batchStart[s] = nbrEdges;
+    for (uint32_t c = 0; c < nbrChannels; c++)
+    {
+      uint32_t second = s % 60;
+      dcf77_time minute;
+      dcf77_from_unix(start[c] + 60 * (s / 60 + 1), 0, &minute);
+      uint64_t frame  = dcf77_encode_frame(&minute);
+      if (second == 59) continue;
+      uint32_t t = 1000 * s + offset[c];
+      edges[nbrEdges++] = (Edge){ c, t, 1 };
+      edges[nbrEdges++] = (Edge){ c, t + (((frame >> second) & 1) ? 200 : 100), 0 };
+    }
+  }
+  batchStart[nbrSeconds] = nbrEdges;
+
+  uint32_t *channels = malloc(nbrEdges * sizeof(uint32_t));
+  uint32_t *times    = malloc(nbrEdges * sizeof(uint32_t));
+  uint8_t  *levels   = malloc(nbrEdges);
+  dcf77_bank_frame *bankFrames = malloc(nbrChannels * sizeof(dcf77_bank_frame));
+  size_t   framesTime = 0, framesChannel = 0, framesBank = 0;
+  uint64_t sumTime = 0, sumChannel = 0, sumBank = 0;   // sums of the telegrams
+
+  for (size_t i = 0; i < nbrEdges; i++)
+  {
+    channels[i] = edges[i].channel;
+    times[i]    = edges[i].time;
+    levels[i]   = edges[i].level;
+  }
+
+  // 1. array of contexts, edges in arrival order (channels in random order)
+  Edge *arrival = malloc(nbrEdges * sizeof(Edge));
+  for (uint32_t s = 0; s < nbrSeconds; s++)
+  {
+    size_t n = batchStart[s + 1] - batchStart[s];
+    for (size_t i = 0; i < n; i++) arrival[batchStart[s] + i] = edges[batchStart[s] + i];
+    qsort(arrival + batchStart[s], n, sizeof(Edge), byTime);
+  }
+  dcf77_ctx *ctx    = malloc(nbrChannels * sizeof(dcf77_ctx));
+  void      *memory = malloc(dcf77_bank_size(nbrChannels));
+  dcf77_bank bank;
+  double    tTime = 1e9, tChannel = 1e9, tBank = 1e9;   // best of RUNS
+
+  for (int run = 0; run < RUNS; run++)
+  {
+    // 1. array of contexts, edges in arrival order (channels in random order)
+    framesTime = 0;
+    sumTime    = 0;
+    for (uint32_t c = 0; c < nbrChannels; c++) dcf77_init(&ctx[c]);
+    double t0 = now();
+    for (size_t i = 0; i < nbrEdges; i++)
+    {
+      dcf77_ctx *x    = &ctx[arrival[i].channel];
+      uint64_t  frame = x->frame;
+      uint8_t   sync  = x->synchronized;
+      if (dcf77_push_edge(x, arrival[i].time, arrival[i].level) == DCF77_EV_MINUTE && sync) 
+      {
+        framesTime++;
+        sumTime += frame;
+      }
+    }
+    if (now() - t0 < tTime) tTime = now() - t0;
+
+    // 2. array of contexts, edges sorted by channel
+    framesChannel = 0;
+    sumChannel    = 0;
+    for (uint32_t c = 0; c < nbrChannels; c++) dcf77_init(&ctx[c]);
+    t0 = now();
+    for (size_t i = 0; i < nbrEdges; i++)
+    {
+      dcf77_ctx *x    = &ctx[channels[i]];
+      uint64_t  frame = x->frame;
+      uint8_t   sync  = x->synchronized;
+      if (dcf77_push_edge(x, times[i], levels[i]) == DCF77_EV_MINUTE && sync) 
+      {
+        framesChannel++;
+        sumChannel += frame;
+      }
+    }
+    if (now() - t0 < tChannel) tChannel = now() - t0;
+
+    // 3. decoder bank, one batch per second sorted by channel
+    framesBank = 0;
+    sumBank    = 0;
+    dcf77_bank_init(&bank, nbrChannels, memory);
+    t0 = now();
+    for (uint32_t s = 0; s < nbrSeconds; s++)
+    {
+      size_t b = batchStart[s];
+      size_t n = dcf77_bank_push_edges(&bank, channels + b, times + b, levels + b, 
+                                       batchStart[s + 1] - b, bankFrames, nbrChannels);
+      for (size_t i = 0; i < n; i++) sumBank += bankFrames[i].frame;
+      framesBank += n;
+    }
+    if (now() - t0 < tBank) tBank = now() - t0;
+  }
+
+  printf("%u channels, %u s, %zu edges, best of %d runs\n", nbrChannels, nbrSeconds, nbrEdges, RUNS);
+  printf("%-26s %7.1f Medges/s %4zu bytes/channel %8zu telegrams %016llx\n", "contexts, arrival order", 
+         nbrEdges / tTime / 1e6, sizeof(dcf77_ctx), framesTime, (unsigned long long)sumTime);
+  printf("%-26s %7.1f Medges/s %4zu bytes/channel %8zu telegrams %016llx\n", "contexts, channel order", 
+         nbrEdges / tChannel / 1e6, sizeof(dcf77_ctx), framesChannel, (unsigned long long)sumChannel);
+  printf("%-26s %7.1f Medges/s %4zu bytes/channel %8zu telegrams %016llx\n", "bank, channel order", 
+         nbrEdges / tBank / 1e6, dcf77_bank_size(1), framesBank, (unsigned long long)sumBank);
+  return 0;
+}
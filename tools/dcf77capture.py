@@ -0,0 +1,376 @@
+#!/usr/bin/env python3
+"""
+Program      dcf77capture.py
+Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+
+Purpose      Offline analysis of recorded edge captures, for questions
+             which need more memory or a longer time span than the Uno has.
+             stability: frequency offset, Allan deviation (ADEV) and time
+             deviation (TDEV) of the local resonator against the DCF77
+             second marks for tau = 1, 2, 4 ... s up to a third of the
+             capture, i.e. days for a capture of a week.
+             interference: autocorrelation of the train of rejected pulses
+             in lags of 1 ms up to 4 s and of 4 s up to 2.3 h, the periods
+             of the sources in it and the glitches per hour of the day (UTC)
+             over the whole capture.
+
+Usage        python3 tools/dcf77capture.py stability capture.txt
+             python3 tools/dcf77capture.py stability --max-gap 10 -j 8 captures/*.txt
+             python3 tools/dcf77capture.py interference -j 8 captures/*.txt
+
+Captures     Same format as for dcf77optimize.py: one edge per line
+             't_ms level', level 1 is the start of a pulse. t_ms may have
+             decimals, e.g. from a logger with input capture. A wrap around
+             of an uint32_t millisecond counter is unwrapped.
+
+Remarks      The rising edge of every pulse of valid width is a second
+             epoch. Its phase is the deviation from 1000 ms per second.
+             Gaps of up to --max-gap seconds, like the missing pulse of
+             second 59, are interpolated, longer gaps split the capture
+             into runs which are evaluated separately and pooled.
+             The estimators are the decimation cascade of lib/DCF77Stability
+             with non-overlapping samples, streamed from the file with
+             memory for log2(tau) octaves instead of the whole capture.
+             Every capture is analyzed by a worker of its own, the sums
+             of all octaves are pooled, so -j 1 gives the same table.
+             The on-device estimator of DCF77_STABILITY resolves 1 us but
+             holds only DCF77_STAB_OCTAVES octaves of tau in 51 bytes each.
+             The capture resolves what the logger resolves, 1 ms for
+             millis(), so the short tau belong to the device and the long
+             ones to this tool.
+             The autocorrelation of DCF77_INTERFERENCE ends at 262 ms and
+             counts the hours in 16 bit since boot. Here slow sources like a
+             compressor switching every few minutes show up as well, the
+             hour of a glitch comes from the telegrams decoded in the
+             capture itself. Every glitch is paired with all glitches of
+             the lags before it, so a source is found even if it loses most
+             of its glitches or shares the line with another one, where
+             the intervals between consecutive glitches are just noise.
+             A period comes with its contrast, the glitch pairs at this
+             lag per pairs at random. The captures are correlated in
+             parallel and pooled.
+"""
+
+import argparse
+import collections
+import functools
+import itertools
+import math
+import multiprocessing
+import os
+import sys
+
+from dcf77optimize import DEFAULT, decode
+
+WRAP = 1 << 32                 # free running uint32_t ms counter
+SCALES = ((1, 4096), (4000, 2048))   # lag bins in ms and their number: 1 ms .. 4 s, 8 s .. 2.3 h
+NBRPEAKS = 3                   # periods reported per scale
+NEIGHBOURS = 16                # lags on either side for the background of a peak
+
+
+def read_edges(path):
+    """Yield (t_ms, rising) with the timestamps unwrapped"""
+    offset, last = 0, None
+    with open(path) as f:
+        for line in f:
+            fields = line.replace(",", " ").split()
+            if len(fields) != 2 or fields[0].startswith("#"):
+                continue
+            t = float(fields[0])
+            if last is not None and t + offset < last - WRAP / 2:
+                offset += WRAP
+            last = t + offset
+            yield last, int(fields[1]) != 0
+
+
+def pulses(edges, params=DEFAULT):
+    """Yield (rising edge, valid) of every pulse, valid if its
+    width lies in the window for 0 or 1"""
+    p0, p1, jitter = params[:3]
+    start = None
+    for t, rising in edges:
+        if rising:
+            start = t
+        elif start is not None:
+            width = t - start
+            yield start, abs(width - p0) < jitter or abs(width - p1) < jitter
+            start = None
+
+
+def epochs(edges, params=DEFAULT):
+    """Yield the rising edges of the pulses with a valid width for 0 or 1"""
+    return (t for t, valid in pulses(edges, params) if valid)
+
+
+def phase_samples(epochs, maxGap, stats):
+    """Yield the phase samples (n, x) of the epochs, x in s for second n.
+    Gaps of up to maxGap s are interpolated, a longer gap yields None to
+    end the run. Counts runs, seconds and the offset sums into stats."""
+    previous, n, x = None, 0, 0.0
+    for t in epochs:
+        if previous is None:
+            previous = t
+            stats["runs"] += 1
+            stats["seconds"] += 1
+            yield n, x
+            continue
+        steps = round((t - previous) / 1000.0)
+        if steps == 0:
+            continue
+        dt = t - previous - 1000.0 * steps
+        previous = t
+        n += steps
+        if steps > maxGap:
+            stats["runs"] += 1
+            stats["seconds"] += 1
+            yield None
+            x = 0.0
+            yield n, x
+            continue
+        first, x = x, x + dt / 1000.0
+        for k in range(1, steps):
+            yield n - steps + k, first + (x - first) * k / steps
+        yield n, x
+        stats["seconds"] += steps
+        stats["steps"] += steps
+        stats["sumDt"] += dt
+
+
+class Cascade:
+    """Streaming non-overlapping ADEV and TDEV like lib/DCF77Stability,
+    octave k holds the phase decimated to and averaged over 2^k s.
+    Memory grows with log2(tau) only."""
+
+    def __init__(self):
+        self.raw, self.mean, self.pend = [], [], []
+        self.first = None           # phase of second 0, a sample of every octave
+
+    def octave(self, k):
+        while len(self.raw) <= k:
+            # chain: last two samples, index of the last, fill, sum, count
+            self.raw.append([0.0, 0.0, 0, 0, 0.0, 0])
+            self.mean.append([0.0, 0.0, 0, 0, 0.0, 0])
+            self.pend.append(None)
+            if self.first is not None:
+                self.sample(self.raw[-1], 0, self.first)
+
+    @staticmethod
+    def sample(c, idx, x):
+        if c[3] > 0 and c[2] + 1 != idx:
+            c[3] = 0
+        if c[3] == 2:
+            d = x - 2 * c[1] + c[0]
+            c[4] += d * d
+            c[5] += 1
+        else:
+            c[3] += 1
+        c[0], c[1], c[2] = c[1], x, idx
+
+    def add(self, n, x):
+        """Feed phase x of second n into all octaves"""
+        if n == 0:
+            self.first = x
+        k = 0
+        while n & ((1 << k) - 1) == 0:
+            self.octave(k)
+            self.sample(self.raw[k], n >> k, x)
+            if n >> k == 0:
+                break
+            k += 1
+        k, idx = 0, n
+        while True:
+            self.octave(k)
+            self.sample(self.mean[k], idx, x)
+            if idx & 1 == 0:
+                self.pend[k] = (idx, x)
+                return
+            pend, self.pend[k] = self.pend[k], None
+            if pend is None or pend[0] + 1 != idx:
+                return
+            x = (pend[1] + x) / 2
+            k, idx = k + 1, idx >> 1
+
+    def cut(self):
+        """End a run, no difference spans the gap"""
+        for c in self.raw + self.mean:
+            c[3] = 0
+        self.pend = [None] * len(self.pend)
+
+    def sums(self):
+        return [(r[4], r[5], m[4], m[5]) for r, m in zip(self.raw, self.mean)]
+
+
+def analyze(path, maxGap):
+    """Stability sums of one capture, run in a worker"""
+    stats = {"runs": 0, "seconds": 0, "steps": 0, "sumDt": 0.0}
+    cascade = Cascade()
+    for sample in phase_samples(epochs(read_edges(path)), maxGap, stats):
+        if sample is None:
+            cascade.cut()
+        else:
+            cascade.add(*sample)
+    return path, stats, cascade.sums()
+
+
+def stability(args):
+    sums, steps, sumDt = [], 0, 0.0
+    with multiprocessing.Pool(min(args.jobs, len(args.captures))) as pool:
+        for path, stats, octaves in pool.imap(functools.partial(analyze, maxGap=args.max_gap), args.captures):
+            offset = 1000.0 * stats["sumDt"] / stats["steps"] if stats["steps"] else 0.0
+            print("%s: %d runs, %d s, offset %.3f ppm" % (path, stats["runs"], stats["seconds"], offset), file=sys.stderr)
+            steps += stats["steps"]
+            sumDt += stats["sumDt"]
+            for k, octave in enumerate(octaves):
+                if k == len(sums):
+                    sums.append([0.0, 0, 0.0, 0])
+                sums[k] = [a + b for a, b in zip(sums[k], octave)]
+    if not steps:
+        sys.exit("no second epochs found")
+    print("# offset_ppm,%.3f" % (1000.0 * sumDt / steps))
+    print("tau_s,adev_ppb,tdev_us,samples")
+    for k, (sumA, nA, sumT, nT) in enumerate(sums):
+        if nA == 0:
+            break
+        m = 1 << k
+        adev = math.sqrt(sumA / (2.0 * nA)) / m
+        tdev = math.sqrt(sumT / (6.0 * nT)) if nT else 0.0
+        print("%d,%.3f,%.3f,%d" % (m, adev * 1e9, tdev * 1e6, nA))
+
+
+def correlate(times, width, lags):
+    """Autocorrelation of a glitch train: the number of glitch pairs
+    for the lags 1 .. lags - 1 in bins of width ms. Only the bins of
+    the last lags bins which hold glitches are kept."""
+    acf = [0] * lags
+    window = collections.deque()          # [bin, glitches]
+
+    def complete():
+        # pair the last bin with the older ones
+        last, n = window[-1]
+        while last - window[0][0] >= lags:
+            window.popleft()
+        for other, m in itertools.islice(window, len(window) - 1):
+            acf[last - other] += n * m
+
+    for t in times:
+        b = int(t // width)
+        if window and window[-1][0] == b:
+            window[-1][1] += 1
+            continue
+        if window:
+            complete()
+        window.append([b, 1])
+    if window:
+        complete()
+    return acf
+
+
+def fundamentals(acf, exposure, width, first):
+    """Periods in ms of the glitch train with their contrast, the pairs at
+    the period per pairs at random. The pairs are divided by the time the
+    captures overlap at that lag. Lags 4 sigma above the median of their
+    neighbourhood, sigma from the spread or from the counting noise, form
+    peaks at the centroid of their excess. In ascending lag, a peak which
+    is not a multiple of a shorter one away from it is a fundamental. Its
+    period is refined by the spacing of the next multiples, which cancels
+    the offset of the centroid of a burst. The fundamentals with the most
+    glitch pairs above random come first."""
+    lags = len(acf)
+    rate = [a / e if e > 0 else 0.0 for a, e in zip(acf, exposure)]
+    peaks, peak = [], None                # [excess rate, lag * excess rate, contrast, first lag, excess pairs]
+    for j in range(first, lags):
+        around = sorted(rate[max(first, j - NEIGHBOURS):j] + rate[j + 1:j + NEIGHBOURS + 1])
+        median = around[len(around) // 2]
+        spread = 1.4826 * sorted(abs(r - median) for r in around)[len(around) // 2]
+        floor = max(1.0, math.sqrt(median * exposure[j])) / exposure[j] if exposure[j] > 0 else float("inf")
+        if rate[j] - median < 4 * max(spread, floor):
+            peak = None
+            continue
+        if peak is None:
+            peak = [0.0, 0.0, 0.0, j, 0.0]
+            peaks.append(peak)
+        peak[0] += rate[j] - median
+        peak[1] += j * (rate[j] - median)
+        peak[2] = max(peak[2], rate[j] / max(median, 1.0 / exposure[j]))
+        peak[4] += (rate[j] - median) * exposure[j]
+    # a peak from the first lag on is the tail of lag 0, a burst
+    peaks = [(lag / excess, contrast, pairs) for excess, lag, contrast, start, pairs in peaks if start > first]
+    found = []                            # (first peak, period, contrast, excess pairs)
+    for lag, contrast, pairs in peaks:
+        if any(abs(lag - start - round((lag - start) / period) * period) <= 1.5 + lag / 200
+               for start, period, _, _ in found):
+            continue
+        period, k = lag, 1
+        while lag + k * period + 2 < lags:
+            near = min((j for j, _, _ in peaks), key=lambda j: abs(j - (lag + k * period)))
+            if abs(near - (lag + k * period)) > max(2, period / 8):
+                break
+            period = (near - lag) / k
+            k += 1
+        found.append((lag, period, contrast, pairs))
+    found.sort(key=lambda peak: peak[3], reverse=True)
+    return [(period * width, contrast) for _, period, contrast, _ in found[:NBRPEAKS]]
+
+
+def glitch_train(path):
+    """Autocorrelations and glitches per hour of one capture, run in a worker"""
+    edges = list(read_edges(path))
+    marks = decode([(int(t), rising) for t, rising in edges], DEFAULT)
+    times, perHour, k = [], [0] * 25, 0     # index 24: no telegram to tell the time
+    for t, valid in pulses(edges):
+        if valid:
+            continue
+        times.append(t)
+        # UTC from the nearest decoded minute mark
+        while k + 1 < len(marks) and abs(marks[k + 1][0] - t) < abs(marks[k][0] - t):
+            k += 1
+        if marks:
+            mark, unix = marks[k]
+            perHour[int(unix + (t - mark) / 1000) // 3600 % 24] += 1
+        else:
+            perHour[24] += 1
+    span = edges[-1][0] - edges[0][0] if edges else 0.0
+    train = [(correlate(times, width, lags), [max(0.0, span - j * width) for j in range(lags)]) for width, lags in SCALES]
+    return path, len(marks), len(times), perHour, train
+
+
+def interference(args):
+    glitches, perHour = 0, [0] * 25
+    acfs = [([0] * lags, [0.0] * lags) for _, lags in SCALES]
+    with multiprocessing.Pool(min(args.jobs, len(args.captures))) as pool:
+        for path, telegrams, n, hours, train in pool.imap(glitch_train, args.captures):
+            print("%s: %d glitches, %d telegrams" % (path, n, telegrams), file=sys.stderr)
+            glitches += n
+            perHour = [a + b for a, b in zip(perHour, hours)]
+            acfs = [tuple([a + b for a, b in zip(sums, more)] for sums, more in zip(scale, other))
+                    for scale, other in zip(acfs, train)]
+    print("# glitches,%d" % glitches)
+    print("period_ms,freq_Hz,contrast")
+    first = 1
+    for (width, lags), (acf, exposure) in zip(SCALES, acfs):
+        for period, contrast in fundamentals(acf, exposure, width, first):
+            print("%.2f,%.4f,%.1f" % (period, 1000.0 / period, contrast))
+        first = 2
+    print("hour_utc,glitches")
+    for h, n in enumerate(perHour):
+        print("%s,%d" % (h if h < 24 else "--", n))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Offline analysis of DCF77 edge captures")
+    commands = parser.add_subparsers(dest="command", required=True)
+    p = commands.add_parser("stability", help="resonator offset, ADEV and TDEV against the second marks")
+    p.add_argument("captures", nargs="+", help="edge captures, 't_ms level' per line")
+    p.add_argument("--max-gap", type=int, default=10, help="seconds without pulse which are interpolated")
+    p.add_argument("-j", "--jobs", type=int, default=os.cpu_count(), help="captures analyzed in parallel")
+    p.set_defaults(run=stability)
+    p = commands.add_parser("interference", help="glitch periods from the autocorrelation and glitches per hour")
+    p.add_argument("captures", nargs="+", help="edge captures, 't_ms level' per line")
+    p.add_argument("-j", "--jobs", type=int, default=os.cpu_count(), help="captures analyzed in parallel")
+    p.set_defaults(run=interference)
+    args = parser.parse_args()
+    args.run(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,278 @@
+/**
+ * Program      dcf77corebench.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Throughput of the extracted core (libdcf77) on one signal
+ *              stream: edges per second through dcf77_push_edge() and
+ *              dcf77_push_edges(), telegrams per second through the checks
+ *              and the decoding, with and without the date and time zone
+ *              cached as DCF77Decoder does, also in TSC ticks per telegram
+ *              on x86.
+ *              The branch free dcf77_classify_batch() and the gap search
+ *              dcf77_find_sync_gap() must find the same minute marks.
+ *              Then the batch throughput of many concurrent streams: each
+ *              thread owns contexts contexts and pushes one minute of 
+ *              edges per context and call with dcf77_push_edges(), for 
+ *              1, 2, 4 .. threads threads.
+ *              Prints the number and sum of the results, which must be
+ *              equal for the paths doing the same work.
+ *
+ * Build        cc -O3 -pthread -Ilib/DCF77Core tools/dcf77corebench.c \
+ *                 lib/DCF77Core/DCF77Core.c -o dcf77corebench
+ *
+ * Usage        ./dcf77corebench [minutes] [threads] [contexts]
+ *              default 200000, the number of cores, 1000 per thread
+ */
+
+#define _POSIX_C_SOURCE 200112L   // clock_gettime() and pthread barriers with -std=c99
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <DCF77Core.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TICKS() __rdtsc()
+#else
+#define TICKS() 0ULL
+#endif
+
+#define EDGES_PER_MINUTE (2 * DCF77_FRAMEBITS)
+
+typedef struct
+{
+  const uint32_t *times;     // edges of the stream, shared read only
+  const uint8_t  *levels;
+  uint32_t nbrMinutes;       // minutes pushed into every context
+  uint32_t nbrContexts;
+  pthread_barrier_t *barrier;
+  size_t   nbrFrames;        // results of the thread
+  uint64_t sum;
+} Worker;
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * One thread with its own contexts, fed minute by minute round robin,
+ * so every call is a batch of one minute of one stream
+ */
+static void *work(void *arg)
+{
+  Worker      *w      = (Worker *)arg;
+  dcf77_ctx   *ctx    = malloc(w->nbrContexts * sizeof(dcf77_ctx));
+  dcf77_frame frame;
+
+  for (uint32_t c = 0; c < w->nbrContexts; c++) dcf77_init(&ctx[c]);
+  w->nbrFrames = 0;
+  w->sum       = 0;
+  pthread_barrier_wait(w->barrier);
+  for (uint32_t m = 0; m < w->nbrMinutes; m++)
+  {
+    const uint32_t *times  = w->times + (size_t)m * EDGES_PER_MINUTE;
+    const uint8_t  *levels = w->levels + (size_t)m * EDGES_PER_MINUTE;
+    for (uint32_t c = 0; c < w->nbrContexts; c++)
+    {
+      if (dcf77_push_edges(&ctx[c], times, levels, EDGES_PER_MINUTE, &frame, 1))
+      {
+        w->nbrFrames++;
+        w->sum += frame.frame;
+      }
+    }
+  }
+  pthread_barrier_wait(w->barrier);
+  free(ctx);
+  return NULL;
+}
+
+static void report(const char *name, size_t n, const char *unit, double seconds, size_t count, uint64_t sum)
+{
+  printf("%-28s %8.1f M%s/s %10zu results %016llx\n", name, n / seconds / 1e6, unit, count, (unsigned long long)sum);
+}
+
+/**
+ * Time stamp counter ticks per item, if there is one
+ */
+static void reportTicks(size_t n, uint64_t ticks)
+{
+  if (ticks) printf("%-28s %8.1f TSC ticks per telegram\n", "", (double)ticks / n);
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t   nbrMinutes = (argc > 1) ? (uint32_t)atol(argv[1]) : 200000;
+  long       nbrCores   = sysconf(_SC_NPROCESSORS_ONLN);
+  uint32_t   maxThreads = (argc > 2) ? (uint32_t)atol(argv[2]) : (nbrCores > 0 ? (uint32_t)nbrCores : 1);
+  uint32_t   nbrContexts = (argc > 3) ? (uint32_t)atol(argv[3]) : 1000;
+  size_t     maxEdges   = (size_t)nbrMinutes * EDGES_PER_MINUTE;
+  uint32_t   *times     = malloc(maxEdges * sizeof(uint32_t));
+  uint8_t    *levels    = malloc(maxEdges);
+  dcf77_frame *frames   = malloc(nbrMinutes * sizeof(dcf77_frame));
+  dcf77_time *decoded   = malloc(nbrMinutes * sizeof(dcf77_time));
+  uint32_t   start      = 1700000000UL;   // UTC of the first minute mark
+  size_t     nbrEdges   = 0;
+  dcf77_ctx  ctx;
+  dcf77_time t;
+
+  // one telegram per minute with 0.1 s pulses for 0 and 0.2 s for 1
+  for (uint32_t m = 0; m < nbrMinutes; m++)
+  {
+    dcf77_from_unix(start + 60 * (m + 1), 0, &t);
+    uint64_t frame = dcf77_encode_frame(&t);
+    for (uint32_t second = 0; second < DCF77_FRAMEBITS; second++)
+    {
+      uint32_t rise = 60000UL * m + 1000UL * second;
+      times[nbrEdges] = rise;
+      levels[nbrEdges++] = 1;
+      times[nbrEdges] = rise + (((frame >> second) & 1) ? 200 : 100);
+      levels[nbrEdges++] = 0;
+    }
+  }
+
+  // 1. one edge per call
+  size_t   nbrFrames = 0;
+  uint64_t sum = 0;
+  dcf77_init(&ctx);
+  double t0 = now();
+  for (size_t i = 0; i < nbrEdges; i++)
+  {
+    uint64_t frame = ctx.frame;
+    uint8_t  sync  = ctx.synchronized;
+    if (dcf77_push_edge(&ctx, times[i], levels[i]) == DCF77_EV_MINUTE && sync)
+    {
+      nbrFrames++;
+      sum += frame;
+    }
+  }
+  report("dcf77_push_edge", nbrEdges, "edges", now() - t0, nbrFrames, sum);
+
+  // 2. caller owned arrays
+  dcf77_init(&ctx);
+  t0 = now();
+  nbrFrames = dcf77_push_edges(&ctx, times, levels, nbrEdges, frames, nbrMinutes);
+  double tBatch = now() - t0;
+  sum = 0;
+  for (size_t i = 0; i < nbrFrames; i++) sum += frames[i].frame;
+  report("dcf77_push_edges", nbrEdges, "edges", tBatch, nbrFrames, sum);
+
+  // 3. branch free classification and sync gap search, the same minute marks
+  uint8_t *events = malloc(nbrEdges);
+  size_t  nbrMarks = 0;
+  sum = 0;
+  dcf77_init(&ctx);
+  t0 = now();
+  dcf77_classify_batch(&ctx, times, levels, nbrEdges, events);
+  double tClassify = now() - t0;
+  for (size_t i = 0; i < nbrEdges; i++)
+  {
+    if (events[i] != DCF77_EV_MINUTE) continue;
+    nbrMarks++;
+    sum += i;
+  }
+  report("dcf77_classify_batch", nbrEdges, "edges", tClassify, nbrMarks, sum);
+
+  nbrMarks = 0;
+  sum = 0;
+  dcf77_init(&ctx);
+  t0 = now();
+  for (size_t i = 0; (i += dcf77_find_sync_gap(&ctx, times + i, levels + i, nbrEdges - i)) < nbrEdges; i++)
+  {
+    nbrMarks++;
+    sum += i;
+    ctx.endPulse = times[i];
+  }
+  report("dcf77_find_sync_gap", nbrEdges, "edges", now() - t0, nbrMarks, sum);
+
+  // 4. markers and parity only
+  size_t nbrValid = 0;
+  t0 = now();
+  uint64_t k0 = TICKS();
+  for (size_t i = 0; i < nbrFrames; i++) nbrValid += (dcf77_check_frame(frames[i].frame) == DCF77_OK);
+  uint64_t ticks = TICKS() - k0;
+  report("dcf77_check_frame", nbrFrames, "frames", now() - t0, nbrValid, 0);
+  reportTicks(nbrFrames, ticks);
+
+  // 5. full decoding and UTC of every telegram
+  sum = 0;
+  t0 = now();
+  k0 = TICKS();
+  nbrValid = dcf77_decode_frames(frames, decoded, nbrFrames);
+  for (size_t i = 0; i < nbrFrames; i++) sum += dcf77_unix_time(&decoded[i]);
+  ticks = TICKS() - k0;
+  report("dcf77_decode_frames + unix", nbrFrames, "frames", now() - t0, nbrValid, sum);
+  reportTicks(nbrFrames, ticks);
+
+  // 6. time of day only, date, time zone and UTC at midnight cached as DCF77Decoder does
+  uint32_t segment  = 0;
+  uint32_t midnight = 0;
+  nbrValid = 0;
+  sum = 0;
+  t0 = now();
+  k0 = TICKS();
+  for (size_t i = 0; i < nbrFrames; i++)
+  {
+    uint64_t frame = frames[i].frame;
+    uint32_t s = ((uint32_t)(frame >> 36) & 0x7FFFFFUL) | ((uint32_t)(frame >> 16) & 7) << 23;
+    int status;
+    if (s == segment)
+    {
+      status = dcf77_decode_clock(frame, &t);
+    }
+    else
+    {
+      status   = dcf77_decode_frame(frame, &t);
+      segment  = (status == DCF77_OK) ? s : 0;
+      midnight = dcf77_unix_time(&t) - t.hour * 3600UL - t.minute * 60UL;
+    }
+    if (status != DCF77_OK) continue;
+    nbrValid++;
+    sum += midnight + t.hour * 3600UL + t.minute * 60UL;
+  }
+  ticks = TICKS() - k0;
+  report("decode_clock + cached date", nbrFrames, "frames", now() - t0, nbrValid, sum);
+  reportTicks(nbrFrames, ticks);
+
+  printf("%u minutes, %zu edges, %zu bytes per stream\n", nbrMinutes, nbrEdges, sizeof(dcf77_ctx));
+
+  // 7. many streams on several threads, about as many edges per thread as above
+  uint32_t perContext = nbrMinutes / (nbrContexts ? nbrContexts : 1);
+  if (perContext < 2) perContext = 2;
+  if (perContext > nbrMinutes) perContext = nbrMinutes;
+  Worker    *workers = malloc(maxThreads * sizeof(Worker));
+  pthread_t *threads = malloc(maxThreads * sizeof(pthread_t));
+  for (uint32_t nbrThreads = 1; ; nbrThreads = (2 * nbrThreads < maxThreads) ? 2 * nbrThreads : maxThreads)
+  {
+    pthread_barrier_t barrier;
+    char name[40];
+    pthread_barrier_init(&barrier, NULL, nbrThreads + 1);
+    for (uint32_t i = 0; i < nbrThreads; i++)
+    {
+      workers[i] = (Worker){ times, levels, perContext, nbrContexts, &barrier, 0, 0 };
+      pthread_create(&threads[i], NULL, work, &workers[i]);
+    }
+    pthread_barrier_wait(&barrier);    // all contexts initialized
+    t0 = now();
+    pthread_barrier_wait(&barrier);    // all batches pushed
+    double elapsed = now() - t0;
+    nbrFrames = 0;
+    sum = 0;
+    for (uint32_t i = 0; i < nbrThreads; i++)
+    {
+      pthread_join(threads[i], NULL);
+      nbrFrames += workers[i].nbrFrames;
+      sum       += workers[i].sum;
+    }
+    pthread_barrier_destroy(&barrier);
+    snprintf(name, sizeof(name), "%u x %u streams", nbrThreads, nbrContexts);
+    report(name, (size_t)nbrThreads * nbrContexts * perContext * EDGES_PER_MINUTE, "edges", elapsed, nbrFrames, sum);
+    if (nbrThreads >= maxThreads) break;
+  }
+  printf("%u minutes per stream, one minute per call, %ld cores\n", perContext, nbrCores);
+  return 0;
+}
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""
+Program      dcf77duty.py
+Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+
+Purpose      Models a duty cycled receiver (build flag DCF77_DUTY_CYCLE):
+             charge per day and worst flywheel error for a range of wake
+             periods, so the period can be chosen before the clock is
+             deployed. The firmware report (key [w]) gives the measured
+             counterpart, e.g. with the simulator and DCF77_SIM_DRIFT.
+
+Usage        python3 tools/dcf77duty.py --ppm 300 --window 5
+             python3 tools/dcf77duty.py --periods 60,360,720 --battery 2600
+
+Remarks      A wake locks on the time prior as soon as its pulses cover
+             time zone, time and date of one minute, which takes 36 to
+             59 s depending on the second of the wake, on average 52 s,
+             see dcf77_grid_lock() in lib/DCF77Core. A fraction of the windows
+             fails (--failures) and keeps the receiver on for the whole
+             window. Between wakes the error grows with the resonator drift.
+             The MCU is awake while the receiver is on, for the watchdog
+             calibration (0.5 s) and for the rest of the pause that is
+             shorter than a watchdog period, and sleeps in power down
+             otherwise. --sleep-ua is the current of a bare ATmega328P, on
+             an Uno board the USB chip, regulator and LED draw tens of mA
+             all the time, give the measured board current then.
+"""
+
+import argparse
+
+AWAKE_OFF = 0.5 + 0.25         # s per pause: calibration, on average half a short period
+
+
+def model(period, window, args):
+    """Return (duty, awake, receiver mAh/day, total mAh/day, worst error in s)"""
+    acquisition = (1 - args.failures) * args.acquisition + args.failures * window * 60
+    duty = min(1.0, acquisition / (period * 60))
+    awake = min(1.0, (acquisition + AWAKE_OFF) / (period * 60))
+    receiver = args.rx_ua * duty * 24 / 1000
+    total = (args.mcu_ua * awake + args.sleep_ua * (1 - awake)) * 24 / 1000 + receiver
+    # a failed window doubles the time without correction, the
+    # watchdog carries the time while asleep
+    error = period * 60 * (1 + args.failures) * (args.ppm + args.sleep_ppm) / 1e6
+    return duty, awake, receiver, total, error
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Energy and time error of a duty cycled DCF77 receiver")
+    parser.add_argument("--periods", default="30,60,120,360,720,1440", help="wake periods in minutes")
+    parser.add_argument("--window", type=int, default=5, help="maximal minutes with receiver on")
+    parser.add_argument("--acquisition", type=float, default=52, help="mean seconds from wake to lock")
+    parser.add_argument("--failures", type=float, default=0.05, help="fraction of windows without lock")
+    parser.add_argument("--ppm", type=float, default=1000, help="resonator drift, DCF77_FLYWHEEL_PPM")
+    parser.add_argument("--rx-ua", type=float, default=100, help="receiver current, DCF77_RX_UA")
+    parser.add_argument("--sleep-ppm", type=float, default=20000, help="drift of the calibrated watchdog, DCF77_SLEEP_PPM")
+    parser.add_argument("--mcu-ua", type=float, default=15000, help="MCU current when awake, DCF77_MCU_UA")
+    parser.add_argument("--sleep-ua", type=float, default=10, help="current in power down, DCF77_SLEEP_UA")
+    parser.add_argument("--battery", type=float, default=0, help="battery capacity in mAh")
+    args = parser.parse_args()
+
+    print("%8s %8s %8s %12s %12s %10s%s" % ("period", "duty %", "awake %", "rx mAh/d", "total mAh/d", "error s",
+                                             " %8s" % "days" if args.battery else ""))
+    for period in (int(p) for p in args.periods.split(",")):
+        duty, awake, receiver, total, error = model(period, args.window, args)
+        days = " %8.1f" % (args.battery / total) if args.battery else ""
+        print("%8d %8.2f %8.2f %12.3f %12.1f %10.1f%s" % (period, 100 * duty, 100 * awake, receiver, total, error, days))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,255 @@
+#!/usr/bin/env python3
+"""
+Program      dcf77fleet.py
+Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+
+Purpose      Load generator for the host side of a fleet of radio clocks.
+             Runs thousands of virtual clocks in one process. Each clock
+             decodes its own synthetic DCF77 signal with individual
+             impairments and streams the lines the firmware prints (NTP
+             line every second, decoded time every minute) over its own
+             pseudo terminal or TCP port, in real time or accelerated.
+
+Usage        python3 tools/dcf77fleet.py --clocks 2000 --speed 10 --map ptys.txt
+             python3 tools/dcf77fleet.py --clocks 500 --tcp 17700 --burst 5
+             python3 tools/dcf77fleet.py --clocks 1000 --speed 0 --seconds 600
+
+Remarks      --speed 0 runs as fast as possible. Burstiness: --burst N
+             holds the lines of N seconds and writes them at once,
+             --aligned lets all clocks write at the start of the second
+             instead of spread over it. Impairments per clock are drawn
+             from the ranges --glitch, --drop (per mille per second) and
+             --jitter (ms). Lines which do not fit into a full pty or
+             socket buffer are dropped and counted, like on a serial port.
+             Every clock decodes with lib/DCF77Core through libdcf77.py and
+             the default thresholds, framed by time slots and published at
+             the minute mark as DCF77Decoder does. The published times are
+             checked against the simulated ones and the wrong ones counted.
+"""
+
+import argparse
+import errno
+import os
+import random
+import selectors
+import socket
+import sys
+import time
+import tty
+
+from dcf77optimize import DEFAULT
+from libdcf77 import Core, Time, DCF77_FRAMEBITS, DCF77_EV_MINUTE, DCF77_OK, DCF77_FIX_REJECTED
+
+NTP_OFFSET = 2208988800        # seconds from 1900 to 1970
+MAX_HOLDOVER = 3600            # stratum 16 after 1 hour without signal
+SLOTS = 10                     # write slots per second when not aligned
+WEEKDAY = ("--", "Mo", "Di", "Mi", "Do", "Fr", "Sa", "So")
+JITTER = DEFAULT[2]
+
+
+class Clock:
+    """One virtual clock: signal impairments, decoder state and output"""
+
+    def __init__(self, index, args, rng, core):
+        self.index = index
+        self.phase = rng.randrange(1000)       # ms from the true second to the local one
+        self.glitch = rng.randint(*args.glitch)
+        self.drop = rng.randint(*args.drop)
+        self.jitter = rng.randint(*args.jitter)
+        self.rng = random.Random(rng.random())
+        self.core = core
+        self.ctx, self.slots, self.time = core.context(), core.slots(), Time()
+        self.prepared = None                   # (frame, unix, line) decoded ahead of the minute mark
+        self.minuteUnix = self.minuteMs = None
+        self.published = self.wrong = 0
+        self.pending = []
+        self.fd = self.slave = self.path = None
+        self.clients = []
+
+    def push(self, t, rising, unix):
+        """Feed one edge, publish the prepared telegram at its minute mark,
+        unix is the UTC of the minute mark the simulator sent last"""
+        synced = self.ctx.synchronized
+        if self.core.dcf77_push_framed_edge(self.ctx, self.slots, t, rising) != DCF77_EV_MINUTE:
+            return
+        # slipped and not rebuilt, or bits missing and not confirmed: not published
+        if synced and not self.slots.repairs & DCF77_FIX_REJECTED:
+            # prepared in second 59 unless the slots have rebuilt the telegram since
+            if self.prepared is None or self.prepared[0] != self.ctx.frame:
+                self.prepare()
+            frame, minuteUnix, line = self.prepared
+            if line is not None:
+                self.pending.append(line)
+                self.published += 1
+                self.wrong += minuteUnix != unix
+            if minuteUnix is not None:
+                self.minuteUnix, self.minuteMs = minuteUnix, t
+        self.prepared = None
+
+    def prepare(self):
+        """Check and decode the telegram of the running minute, like
+        prepareMinute() of the decoder"""
+        core, t, frame = self.core, self.time, self.ctx.frame
+        unix = line = None
+        if core.dcf77_check_frame(frame) == DCF77_OK:
+            if core.dcf77_decode_frame(frame, t) == DCF77_OK:
+                unix = core.dcf77_unix_time(t)
+            line = "%3s 20%02d-%02d-%02d %02d:%02d:%02d %4s DCF77\n" % (
+                WEEKDAY[t.wday], t.year, t.month, t.mday,
+                t.hour, t.minute, 0, "MESZ" if t.isdst > 0 else "MEZ")
+        self.prepared = (frame, unix, line)
+
+    def second(self, s, frame, unix):
+        """Simulate second s of the run, frame is the telegram of its minute,
+        unix the UTC of the minute mark which began it"""
+        rng, t0, sec = self.rng, 1000 * s + self.phase, s % 60
+        edges = []
+        if sec < 59 and rng.randrange(1000) >= self.drop:
+            width = (200 if (frame >> sec) & 1 else 100) + rng.randint(-self.jitter, self.jitter)
+            edges += [(t0, True), (t0 + width, False)]
+        if rng.randrange(1000) < self.glitch:
+            g = t0 + 300 + rng.randrange(600)
+            edges += [(g, True), (g + 8, False)]
+        for t, rising in edges:
+            self.push(t & 0xFFFFFFFF, rising, unix)
+        now = t0 + 999
+        # all bits are in and the pulse of second 59 is missing: the next edge is the minute mark
+        ctx = self.ctx
+        if ctx.synchronized and ctx.seconds == DCF77_FRAMEBITS and self.prepared is None and \
+                (now - ctx.startPulse) & 0xFFFFFFFF > 1000 + JITTER:
+            self.prepare()
+        # NTP line of the firmware, key [n]
+        if self.minuteUnix is None:
+            self.pending.append("NTP 3 16 0.000\n")
+        else:
+            elapsed = now - self.minuteMs
+            stratum = 1 if elapsed // 1000 < MAX_HOLDOVER else 16
+            self.pending.append("NTP 0 %d %d.%03d\n" % (stratum, self.minuteUnix + elapsed // 1000 + NTP_OFFSET,
+                                                       elapsed % 1000))
+
+
+class Fleet:
+    def __init__(self, args):
+        self.args = args
+        rng = random.Random(args.seed)
+        self.core = Core()
+        self.clocks = [Clock(i, args, rng, self.core) for i in range(args.clocks)]
+        self.selector = selectors.DefaultSelector()
+        self.records = self.bytes = self.dropped = 0
+        for clock in self.clocks:
+            if args.tcp:
+                listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+                listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+                listener.bind(("127.0.0.1", args.tcp + clock.index))
+                listener.listen(4)
+                listener.setblocking(False)
+                self.selector.register(listener, selectors.EVENT_READ, clock)
+                clock.path = "tcp:%d" % (args.tcp + clock.index)
+            else:
+                clock.fd, clock.slave = os.openpty()
+                tty.setraw(clock.slave)
+                os.set_blocking(clock.fd, False)
+                clock.path = os.ttyname(clock.slave)
+        if args.map:
+            with open(args.map, "w") as f:
+                for clock in self.clocks:
+                    f.write("clock%d %s glitch=%d drop=%d jitter=%d\n" % (
+                        clock.index, clock.path, clock.glitch, clock.drop, clock.jitter))
+
+    def accept(self):
+        for key, _ in self.selector.select(0):
+            conn, _ = key.fileobj.accept()
+            conn.setblocking(False)
+            key.data.clients.append(conn)
+
+    def flush(self, clock):
+        data = "".join(clock.pending).encode()
+        n = len(clock.pending)
+        clock.pending = []
+        self.records += n
+        if clock.fd is not None:
+            self.write(lambda d: os.write(clock.fd, d), data, n)
+            return
+        for conn in list(clock.clients):
+            if not self.write(conn.send, data, n):
+                clock.clients.remove(conn)
+                conn.close()
+
+    def write(self, write, data, n):
+        """Write without blocking, returns False if the peer is gone"""
+        try:
+            sent = write(data)
+        except OSError as e:
+            if e.errno in (errno.EPIPE, errno.ECONNRESET):
+                return False
+            if e.errno not in (errno.EAGAIN, errno.EWOULDBLOCK, errno.EIO):
+                raise
+            sent = 0
+        self.bytes += sent
+        if sent < len(data):
+            self.dropped += n
+        return True
+
+    def run(self):
+        args = self.args
+        slots = [[] for _ in range(1 if args.aligned else SLOTS)]
+        for clock in self.clocks:
+            slots[clock.phase * len(slots) // 1000].append(clock)
+        base = int(time.time()) // 60 * 60 + 60     # true UTC at second 0 of the run
+        startWall = lastReport = time.monotonic()
+        lastRecords = lastBytes = 0
+        s = 0
+        while not args.seconds or s < args.seconds:
+            # second s of the run belongs to the telegram announcing the next minute
+            frame = self.core.encode(base + 60 * (s // 60 + 1))
+            for i, group in enumerate(slots):
+                if args.speed:
+                    delay = startWall + (s + i / len(slots)) / args.speed - time.monotonic()
+                    if delay > 0:
+                        time.sleep(delay)
+                if args.tcp:
+                    self.accept()
+                for clock in group:
+                    clock.second(s, frame, base + 60 * (s // 60))
+                    if (s + 1) % args.burst == 0:
+                        self.flush(clock)
+            s += 1
+            wall = time.monotonic()
+            if wall - lastReport >= args.report:
+                locked = sum(1 for c in self.clocks if c.minuteUnix is not None)
+                print("t=%ds records %.0f/s bytes %.0f/s dropped %d locked %d/%d" % (
+                    s, (self.records - lastRecords) / (wall - lastReport), (self.bytes - lastBytes) / (wall - lastReport),
+                    self.dropped, locked, len(self.clocks)), file=sys.stderr)
+                lastReport, lastRecords, lastBytes = wall, self.records, self.bytes
+        wall = time.monotonic() - startWall
+        print("%d clocks, %d s simulated in %.1f s, %.0f records/s, %d dropped, %d times published, %d wrong" % (
+            len(self.clocks), s, wall, self.records / wall, self.dropped,
+            sum(c.published for c in self.clocks), sum(c.wrong for c in self.clocks)), file=sys.stderr)
+
+
+def span(text):
+    """'lo:hi' or a single value"""
+    values = [int(v) for v in text.split(":")]
+    return (values[0], values[-1])
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Fleet of virtual DCF77 clocks streaming over ptys or TCP")
+    parser.add_argument("--clocks", type=int, default=1000)
+    parser.add_argument("--speed", type=float, default=1, help="simulated seconds per second, 0 = unthrottled")
+    parser.add_argument("--seconds", type=int, default=0, help="simulated seconds to run, 0 = forever")
+    parser.add_argument("--tcp", type=int, default=0, help="first TCP port, one per clock, instead of ptys")
+    parser.add_argument("--map", help="file listing the pty or port of every clock")
+    parser.add_argument("--burst", type=int, default=1, help="seconds of lines written at once")
+    parser.add_argument("--aligned", action="store_true", help="all clocks write at the same instant")
+    parser.add_argument("--glitch", type=span, default=span("0:10"), help="per mille per second")
+    parser.add_argument("--drop", type=span, default=span("0:5"), help="per mille per second")
+    parser.add_argument("--jitter", type=span, default=span("0:20"), help="ms")
+    parser.add_argument("--report", type=float, default=5, help="seconds between rate reports")
+    parser.add_argument("--seed", type=int, default=77)
+    args = parser.parse_args()
+    Fleet(args).run()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,175 @@
+/**
+ * Program      dcf77irigmodel.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Host model of the IRIG-B output (DCF77Irig.h, class DCF77IrigB).
+ *              Timer1 runs in fast PWM mode with double buffered period and
+ *              pulse width, latched at BOTTOM. The compare interrupt calls
+ *              dcf77_irig_load() after a random latency, loop() feeds the
+ *              DCF77 second epochs and plans the frames after another one.
+ *              The resonator is off by --ppm, epochs jitter and get lost.
+ *              The generated waveform is decoded again and compared with
+ *              the true time: labels, on time error against the true second,
+ *              element period spread and missed interrupt deadlines.
+ *
+ * Build        cc -O2 -Ilib/DCF77Core tools/dcf77irigmodel.c \
+ *                 lib/DCF77Core/DCF77Core.c lib/DCF77Core/DCF77Irig.c -lm -o dcf77irigmodel
+ *
+ * Usage        ./dcf77irigmodel [seconds] [ppm] [isr_us] [loop_ms] [jitter_us] [drop_%]
+ *              default          3600      300   100      50        2000        5
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <DCF77Core.h>
+#include <DCF77Irig.h>
+
+#define START_UNIX 1709161080UL    // 2024-02-28 22:58:00 UTC, the day and year roll over in MEZ
+#define SETTLE     60              // seconds before the statistics start
+
+static double ppm;
+
+static int64_t toLocal(int64_t trueUs) { return trueUs + (int64_t)llround(trueUs * ppm / 1e6); }
+static int64_t toTrue(int64_t localUs) { return (int64_t)llround(localUs / (1 + ppm / 1e6)); }
+static uint32_t uniform(uint32_t n)    { return n ? (uint32_t)(rand() % (n + 1)) : 0; }
+
+/**
+ * BCD digit of n elements starting at first
+ */
+static int digit(const int *value, int first, int n)
+{
+  int v = 0;
+  for (int i = 0; i < n; i++) v += value[first + i] << i;
+  return v;
+}
+
+/**
+ * Decode the pulse widths of one frame, -1 if it is malformed
+ */
+static int64_t decode(const uint16_t *widths)
+{
+  int value[100];
+
+  for (int e = 0; e < 100; e++)
+  {
+    int w = widths[e] * DCF77_IRIG_TICK_US;
+    value[e] = (w < 3500) ? 0 : (w < 6500) ? 1 : 2;
+    if ((value[e] == 2) != (e == 0 || e % 10 == 9)) return -1;
+  }
+  int sec  = digit(value, 1, 4) + 10 * digit(value, 6, 3);
+  int min  = digit(value, 10, 4) + 10 * digit(value, 15, 3);
+  int hour = digit(value, 20, 4) + 10 * digit(value, 25, 2);
+  int doy  = digit(value, 30, 4) + 10 * digit(value, 35, 4) + 100 * digit(value, 40, 2);
+  int year = digit(value, 50, 4) + 10 * digit(value, 55, 4);
+  int sbs  = 0;
+  for (int i = 0; i < 9; i++) sbs |= value[80 + i] << i;
+  for (int i = 0; i < 8; i++) sbs |= value[90 + i] << (9 + i);
+  if (sbs != (hour * 60 + min) * 60 + sec) return -1;
+
+  dcf77_time jan1 = { 0 };
+  jan1.year = (uint8_t)year; jan1.month = 1; jan1.mday = 1;
+  return (int64_t)(dcf77_day_number(&jan1) + doy - 1) * 86400 + sbs;
+}
+
+int main(int argc, char **argv)
+{
+  long     seconds  = argc > 1 ? atol(argv[1]) : 3600;
+  uint32_t isrMax   = argc > 3 ? atoi(argv[3]) : 100;
+  uint32_t loopMax  = (argc > 4 ? atoi(argv[4]) : 50) * 1000;
+  uint32_t jitter   = argc > 5 ? atoi(argv[5]) : 2000;
+  int      drop     = argc > 6 ? atoi(argv[6]) : 5;
+  ppm = argc > 2 ? atof(argv[2]) : 300;
+
+  dcf77_irig irig;
+  dcf77_irig_init(&irig);
+  srand(77);
+
+  // timer state, local us, registers as latched and as buffered
+  int64_t  bottom = toLocal(1234567), planAt = -1;
+  int64_t  epochTrue = 1000000, epochStamp = toLocal(epochTrue), epochAt = epochStamp;
+  uint16_t top = 2499, ocr = DCF77_IRIG_MARK - 1, topBuf = top, ocrBuf = ocr;
+  uint16_t widths[100];
+  int64_t  starts[100];
+  long     frames = 0, wrong = 0, malformed = 0, missed = 0, dark = 0, nbrPhase = 0;
+  double   maxPhase = 0, sumPhase = 0, sumPhase2 = 0, maxSpread = 0;
+  int      element = DCF77_IRIG_ELEMENTS - 1;   // the first BOTTOM starts element 0
+
+  while (toTrue(bottom) < (int64_t)seconds * 1000000)
+  {
+    // BOTTOM: the buffered registers are latched, the pulse starts
+    top = topBuf;
+    ocr = ocrBuf;
+    element = (element + 1) % 100;
+    widths[element] = ocr + 1;
+    starts[element] = bottom;
+    int64_t compare = bottom + (int64_t)(ocr + 1) * DCF77_IRIG_TICK_US;
+    int64_t isr     = compare + uniform(isrMax);
+    int64_t end     = bottom + (int64_t)(top + 1) * DCF77_IRIG_TICK_US;
+
+    // loop(): epochs and plans due before the interrupt
+    for (;;)
+    {
+      int64_t due = (planAt >= 0 && planAt < epochAt) ? planAt : epochAt;
+      if (due >= isr) break;
+      if (due == planAt)
+      {
+        int64_t  t  = toTrue(planAt);
+        uint32_t ms = (uint32_t)((t / 1000) % 1000);
+        uint32_t start;
+        if (dcf77_irig_take(&irig, &start))
+          dcf77_irig_plan(&irig, start, (uint32_t)planAt, START_UNIX + (uint32_t)(t / 1000000), ms, 1);
+        planAt = -1;
+      }
+      else
+      {
+        if ((int)uniform(99) >= drop) dcf77_irig_epoch(&irig, (uint32_t)epochStamp);
+        epochTrue += 1000000;
+        epochStamp = toLocal(epochTrue + (int64_t)uniform(2 * jitter) - jitter);
+        epochAt    = epochStamp + 100000 + uniform(loopMax);   // decided at the falling edge
+      }
+    }
+    if (isr >= end) missed++;
+
+    // compare interrupt: registers of the next element
+    uint8_t wasEnabled = irig.frame[irig.front].enabled;
+    topBuf = dcf77_irig_load(&irig, (uint32_t)bottom, &ocrBuf);
+    if (irig.started && planAt < 0) planAt = isr + uniform(loopMax);
+
+    if (element == 99)
+    { // a frame is complete, check what a receiver sees
+      frames++;
+      if (! wasEnabled) { dark++; }
+      else if (toTrue(starts[0]) / 1000000 >= SETTLE)
+      {
+        int64_t label = decode(widths);
+        int64_t t0    = toTrue(starts[0]);
+        int64_t sec   = (t0 + 500000) / 1000000;
+        double  phase = (double)(t0 - sec * 1000000);
+        if (label < 0) malformed++;
+        else if (label != (int64_t)(START_UNIX + sec)) wrong++;
+        nbrPhase++;
+        sumPhase  += phase;
+        sumPhase2 += phase * phase;
+        if (fabs(phase) > maxPhase) maxPhase = fabs(phase);
+        double mean = (double)(toTrue(starts[99]) - toTrue(starts[0])) / 99;
+        for (int e = 1; e < 100; e++)
+        {
+          double spread = fabs((double)(toTrue(starts[e]) - toTrue(starts[e - 1])) - mean);
+          if (spread > maxSpread) maxSpread = spread;
+        }
+      }
+    }
+    bottom = end;
+  }
+
+  double mean = nbrPhase ? sumPhase / nbrPhase : 0;
+  printf("%ld s, resonator %+.0f ppm, interrupt latency <= %u us, loop latency <= %u ms, epoch jitter +/-%u us, %d%% lost\n",
+         seconds, ppm, isrMax, loopMax / 1000, jitter, drop);
+  printf("frames %ld, dark %ld, late %u, wrong label %ld, malformed %ld, missed deadlines %ld\n",
+         frames, dark, irig.late, wrong, malformed, missed);
+  printf("on time error after %d s: mean %.1f us, rms %.1f us, max %.0f us\n",
+         SETTLE, mean, nbrPhase ? sqrt(sumPhase2 / nbrPhase) : 0, maxPhase);
+  printf("element period spread within a frame: max %.1f us, local second %u us\n", maxSpread, irig.usPerSecond);
+  return (wrong || malformed || missed) ? 1 : 0;
+}
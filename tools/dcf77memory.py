@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""
+Program      dcf77memory.py
+Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+
+Purpose      Decodes the binary RAM records of the DCF77 radio clock (key
+             [R], build flag DCF77_MEMORY) from a serial log and prints the
+             RAM budget, the stack high-water mark and the queue peaks, one
+             line per record. The record format is described in
+             lib/DCF77Memory/DCF77Memory.h.
+
+Usage        python3 tools/dcf77memory.py log.bin
+             cat /dev/ttyACM0 | python3 tools/dcf77memory.py
+
+Remarks      Text between the records is skipped, records with a wrong
+             checksum or version are counted and ignored.
+"""
+
+import struct
+import sys
+
+SYNC = b"\xd7\x4d"
+VERSION = 1
+RAM_SIZE = 2048                # ATmega328P
+BUFFERS = ("edge queue", "capture queue", "uart rx", "uart tx")   # setBuffer() index in the sketch
+
+
+def read_records(data):
+    """Yield the payloads of all valid records, count the broken ones"""
+    bad, pos = 0, 0
+    while True:
+        pos = data.find(SYNC, pos)
+        if pos < 0 or pos + 3 > len(data):
+            break
+        n = data[pos + 2]
+        end = pos + 3 + n
+        if end >= len(data):
+            break
+        payload = data[pos + 3:end]
+        if sum(payload) & 0xFF != data[end] or n < 12 or payload[0] != VERSION:
+            bad += 1
+            pos += 1
+            continue
+        yield payload
+        pos = end + 1
+    if bad:
+        print("%d broken records skipped" % bad, file=sys.stderr)
+
+
+def decode(payload):
+    """Return the dict of one record"""
+    _, static, heap, peak, free, headroom, nbr = struct.unpack_from("<B5HB", payload)
+    buffers = [struct.unpack_from("<BB", payload, 12 + 2 * i) for i in range(nbr)]
+    return {"static": static, "heap": heap, "stack_peak": peak, "free": free,
+            "headroom": headroom, "buffers": buffers}
+
+
+def main():
+    data = open(sys.argv[1], "rb").read() if len(sys.argv) > 1 else sys.stdin.buffer.read()
+    for record in (decode(p) for p in read_records(data)):
+        line = "static %4d heap %4d stack peak %4d headroom %4d free %4d (%4.1f %% of RAM unused)" % (
+            record["static"], record["heap"], record["stack_peak"], record["headroom"], record["free"],
+            100.0 * record["headroom"] / RAM_SIZE)
+        for i, (peak, capacity) in enumerate(record["buffers"]):
+            if capacity:
+                line += ", %s %d/%d" % (BUFFERS[i] if i < len(BUFFERS) else "buffer %d" % i, peak, capacity)
+        print(line)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,256 @@
+#!/usr/bin/env python3
+"""
+Program      dcf77optimize.py
+Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+
+Purpose      Searches the pulse classification thresholds P0, P1, JITTER,
+             MIN_SYNCGAP and MAX_SYNCGAP for a receiver model on recorded
+             edge captures and writes the best set as a receiver profile
+             header, selected at build time with the flag DCF77_PROFILE.
+
+Usage        python3 tools/dcf77optimize.py [options] capture ...
+             python3 tools/dcf77optimize.py --name hkw captures/*.txt \\
+                     -o lib/DCF77Core/profiles/DCF77Profile_hkw.h
+
+Captures     Text files with one edge per line, 't_ms level', where level 1
+             is the start of a pulse (rising edge at the decoder input) and
+             t_ms is a free running millisecond timestamp. Lines starting
+             with '#' are ignored. Optional label lines 'L t_ms unix' give
+             the true UTC time in seconds of the minute mark at t_ms.
+
+Remarks      Captures without labels are labelled from their own decoded
+             telegrams: the frames decoded with a few wide reference
+             profiles are kept only if they agree with their neighbours on
+             a common time line. Each candidate is then scored by correct
+             frames minus a penalty for every false lock, i.e. a telegram
+             which passes all checks but carries the wrong time.
+             The candidates are evaluated in parallel on all cores.
+             Every capture is decoded with lib/DCF77Core through 
+             tools/libdcf77.py (needs a C compiler), framed by the time
+             slots like the clock does, dcf77_push_framed_edges() and
+             dcf77_decode_frames(). Compiling the core for every candidate
+             takes longer than the search, so the search runs the tuning
+             build, whose thresholds are set at run time. The default and
+             the ranked candidates are decoded again with the core compiled
+             with their thresholds as constants, as in a profile, and the
+             program stops if a single telegram differs.
+"""
+
+import argparse
+import datetime
+import itertools
+import multiprocessing
+import os
+import sys
+
+from libdcf77 import Core, Edges, Tuning
+
+DEFAULT = (100, 200, 35, 1800, 1900)   # P0, P1, JITTER, MIN_SYNCGAP, MAX_SYNCGAP
+NAMES = ("P0", "P1", "JITTER", "MIN_SYNCGAP", "MAX_SYNCGAP")
+COMMENTS = ("Pulse width of 100 ms means bit = 0",
+            "Pulse width of 200 ms means bit = 1",
+            "Uncertainty of measured pulse width",
+            "Minimal synchronization gap at sec 59",
+            "Maximal synchronization gap at sec 59")
+REFERENCES = [DEFAULT, (100, 200, 45, 1800, 1900), (110, 210, 45, 1750, 1950), (90, 190, 45, 1750, 1950)]
+NEIGHBOURHOOD = 30 * 60000             # ms within which labels confirm each other
+
+_captures = []                         # per worker process
+_core = None
+
+
+def read_capture(path):
+    """Return (edges, labels) of a capture file"""
+    edges, labels = [], {}
+    with open(path) as f:
+        for line in f:
+            fields = line.replace(",", " ").split()
+            if not fields or fields[0].startswith("#"):
+                continue
+            if fields[0] == "L" and len(fields) == 3:
+                labels[int(fields[1]) & 0xFFFFFFFF] = int(fields[2])
+            elif len(fields) == 2:
+                edges.append((int(fields[0]) & 0xFFFFFFFF, int(fields[1]) != 0))
+    return edges, labels
+
+
+def tuned(params):
+    """The tuning core of this process, set to the thresholds params"""
+    global _core
+    if _core is None:
+        _core = Tuning()
+    if _core.params != params:
+        _core.set_thresholds(params)
+    return _core
+
+
+def decode(edges, params):
+    """Return [(markTime, unix)] of the telegrams accepted with params,
+    edges [(t_ms, rising)] or prepared Edges"""
+    return tuned(params).decode(edges)
+
+
+def consistent(a, b):
+    """Two (markTime, unix) pairs lie on the same time line"""
+    return b[1] - a[1] == 60 * round((b[0] - a[0]) / 60000)
+
+
+def label(edges):
+    """Labels from the largest group of mutually consistent reference frames"""
+    pairs = sorted(set(itertools.chain.from_iterable(decode(edges, p) for p in REFERENCES)))
+    parent = list(range(len(pairs)))
+
+    def root(i):
+        while parent[i] != i:
+            parent[i] = parent[parent[i]]
+            i = parent[i]
+        return i
+
+    for i, a in enumerate(pairs):
+        for j in range(i + 1, len(pairs)):
+            if pairs[j][0] - a[0] > NEIGHBOURHOOD:
+                break
+            if pairs[j][0] != a[0] and consistent(a, pairs[j]):
+                parent[root(j)] = root(i)
+    groups = {}
+    for i in range(len(pairs)):
+        groups.setdefault(root(i), []).append(pairs[i])
+    best = max(groups.values(), key=len, default=[])
+    return dict(best) if len(best) > 1 else {}
+
+
+def expected(anchors, mark):
+    """True time of a minute mark, from the nearest label"""
+    nearest = min(anchors, key=lambda m: abs(m - mark))
+    return anchors[nearest] + 60 * round((mark - nearest) / 60000)
+
+
+def init_worker(captures):
+    global _captures
+    _captures = [(Edges(edges), anchors, minutes) for edges, anchors, minutes in captures]
+
+
+def evaluate(params):
+    """Return (params, correct, false locks) over all captures"""
+    correct = falseLocks = 0
+    for edges, anchors, _ in _captures:
+        for mark, unix in decode(edges, params):
+            if unix == expected(anchors, mark):
+                correct += 1
+            else:
+                falseLocks += 1
+    return params, correct, falseLocks
+
+
+def check(params):
+    """First telegram in which the tuning core and the core compiled with
+    params disagree, as (params, capture index, (markTime, unix)), or None"""
+    core = Core(params)
+    for i, (edges, _, _) in enumerate(_captures):
+        tuning, native = decode(edges, params), core.decode(edges)
+        if tuning != native:
+            return params, i, min(set(tuning) ^ set(native), default=None)
+    return None
+
+
+def label_capture(path):
+    edges, labels = read_capture(path)
+    anchors = labels or label(edges)
+    minutes = (edges[-1][0] - edges[0][0]) // 60000 - 1 if len(edges) > 1 else 0
+    return path, edges, anchors, max(minutes, 0)
+
+
+def span(text):
+    """'lo:hi:step' or a single value"""
+    values = [int(v) for v in text.split(":")]
+    return [values[0]] if len(values) == 1 else list(range(values[0], values[1] + 1, values[2] if len(values) > 2 else 1))
+
+
+def candidates(args):
+    for p0, p1, jitter, minSync, maxSync in itertools.product(args.p0, args.p1, args.jitter, args.min_sync, args.max_sync):
+        if p0 + jitter <= p1 - jitter and minSync < maxSync and p1 + jitter < minSync - jitter:
+            yield (p0, p1, jitter, minSync, maxSync)
+
+
+def header(name, params, correct, falseLocks, minutes, nbrCaptures):
+    guard = "_DCF77Profile_%s_H_" % name.upper()
+    lines = ["/**",
+             " * Header       DCF77Profile_%s.h" % name,
+             " * Author       generated by tools/dcf77optimize.py on %s" % datetime.date.today().isoformat(),
+             " * ",
+             " * Purpose      Pulse classification thresholds for the receiver %s" % name,
+             " *              %d captures, %d of %d minutes decoded, %d false locks" % (nbrCaptures, correct, minutes, falseLocks),
+             " * ",
+             " * Remarks      Select with the build flag",
+             " *              '-D DCF77_PROFILE=\"profiles/DCF77Profile_%s.h\"'" % name,
+             " */",
+             "",
+             "#ifndef %s" % guard,
+             "#define %s" % guard,
+             ""]
+    for n, v, c in zip(NAMES, params, COMMENTS):
+        lines.append("#define %-11s %-8d // %s" % (n, v, c))
+    lines += ["#endif", ""]
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Optimize the DCF77 pulse thresholds for a receiver")
+    parser.add_argument("captures", nargs="+", help="edge captures, 't_ms level' per line")
+    parser.add_argument("-o", "--output", help="profile header to write, default stdout")
+    parser.add_argument("--name", default="custom", help="receiver name used in the header")
+    parser.add_argument("--p0", type=span, default=span("70:150:10"))
+    parser.add_argument("--p1", type=span, default=span("170:250:10"))
+    parser.add_argument("--jitter", type=span, default=span("20:50:5"))
+    parser.add_argument("--min-sync", type=span, default=span("1750:1850:50"))
+    parser.add_argument("--max-sync", type=span, default=span("1850:1950:50"))
+    parser.add_argument("--penalty", type=int, default=10, help="weight of a false lock against a decoded frame")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count())
+    parser.add_argument("--top", type=int, default=10, help="number of ranked candidates to list")
+    args = parser.parse_args()
+
+    with multiprocessing.Pool(args.jobs) as pool:
+        captures, paths = [], []
+        for path, edges, anchors, minutes in pool.imap(label_capture, args.captures):
+            print("%s: %d edges, %d minutes, %d labels" % (path, len(edges), minutes, len(anchors)), file=sys.stderr)
+            if anchors:
+                captures.append((edges, anchors, minutes))
+                paths.append(path)
+    if not captures:
+        sys.exit("no capture could be labelled")
+    minutes = sum(c[2] for c in captures)
+
+    grid = list(candidates(args))
+    print("%d candidates on %d captures, %d jobs" % (len(grid), len(captures), args.jobs), file=sys.stderr)
+    def score(r):
+        params, correct, falseLocks = r
+        distance = sum(abs(a - b) for a, b in zip(params, DEFAULT))
+        return (correct - args.penalty * falseLocks, -falseLocks, -distance)
+
+    with multiprocessing.Pool(args.jobs, init_worker, (captures,)) as pool:
+        results = list(pool.imap_unordered(evaluate, grid, chunksize=max(1, len(grid) // (8 * args.jobs))))
+        results.sort(key=score, reverse=True)
+        checked = list(dict.fromkeys([DEFAULT] + [r[0] for r in results[:args.top]]))
+        for mismatch in pool.imap_unordered(check, checked):
+            if mismatch:
+                params, i, telegram = mismatch
+                sys.exit("tuning and profile builds of libdcf77 disagree with %s on %s, telegram %s" % (" ".join(map(str, params)), paths[i], telegram))
+    print("%d candidates checked against their profile build" % len(checked), file=sys.stderr)
+    print("%-28s %8s %6s" % ("P0 P1 JITTER MIN MAX", "decoded", "false"), file=sys.stderr)
+    for params, correct, falseLocks in results[:args.top]:
+        print("%-28s %8d %6d" % (" ".join(map(str, params)), correct, falseLocks), file=sys.stderr)
+    for params, correct, falseLocks in results:
+        if params == DEFAULT:
+            print("default: %d decoded, %d false" % (correct, falseLocks), file=sys.stderr)
+
+    params, correct, falseLocks = results[0]
+    text = header(args.name, params, correct, falseLocks, minutes, len(captures))
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,475 @@
+#!/usr/bin/env python3
+"""
+Program      dcf77store.py
+Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+
+Purpose      Columnar store for the per second series of a fleet of radio
+             clocks: offset of the second epoch (us), pulse width (ms) and
+             quality score, kept for months on the host. The rows of one
+             clock are cut into blocks of one hour. In a block the timestamps
+             are compressed with delta-of-delta and every value column on
+             its own with the XOR scheme of Gorilla (Pelkonen et al., VLDB
+             2015), so a scan decompresses only the columns it asks for.
+             The index keeps first and last timestamp, row count and min
+             and max of every column per block.
+
+Usage        python3 tools/dcf77store.py bench --clocks 20 --seconds 86400
+             python3 tools/dcf77store.py import store/ series.txt
+             python3 tools/dcf77store.py scan store/ --clock 7 --start 1709161080 --end 1709164680
+             python3 tools/dcf77store.py summary store/ --clock 7 --start 1709161080 --end 1709247480
+
+Files        <store>/blocks.dat   compressed blocks, append only
+             <store>/index.dat    one entry per block, read at open
+             import reads lines 'clock unix offset_us width_ms quality',
+             per clock in time order, lines starting with '#' are ignored.
+
+Remarks      Lossless: the float64 values come back bit exact. A range scan
+             binary searches the blocks of the clock and reads only those
+             overlapping the window. summary answers blocks lying entirely
+             inside the window from the index and decodes only the two
+             blocks at its edges. bench runs on synthetic fleet data with
+             resonator drift, receiver jitter, lost seconds and a quality
+             score. It reports ingest rate, compression ratio against
+             float64 rows and scan throughput, and checks the round trip.
+"""
+
+import argparse
+import bisect
+import math
+import os
+import random
+import shutil
+import struct
+import sys
+import tempfile
+import time
+from array import array
+
+COLUMNS = ("offset_us", "width_ms", "quality")
+BLOCK_SECONDS = 3600             # blocks are cut at the full hour
+MAGIC = b"DCF77ST1"
+HEAD = struct.Struct("<IqqIQI")  # clock, first, last, rows, offset in blocks.dat, bytes of the timestamps
+COLUMN = struct.Struct("<Idd")   # bytes, min, max
+RAW_ROW = 8 + 8 * len(COLUMNS)   # int64 timestamp and float64 values
+
+# delta-of-delta buckets: prefix, prefix bits, value bits
+DOD_BUCKETS = ((0b10, 2, 7), (0b110, 3, 9), (0b1110, 4, 12))
+
+
+class BitWriter:
+    """Appends bit fields MSB first, whole bytes are moved out every 64 bits"""
+
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = self.n = 0
+
+    def write(self, value, bits):
+        self.acc = (self.acc << bits) | value
+        self.n += bits
+        if self.n >= 64:
+            rest = self.n & 7
+            self.out += (self.acc >> rest).to_bytes((self.n - rest) >> 3, "big")
+            self.acc &= (1 << rest) - 1
+            self.n = rest
+
+    def getvalue(self):
+        if self.n:
+            pad = -self.n & 7
+            self.out += (self.acc << pad).to_bytes((self.n + pad) >> 3, "big")
+            self.acc = self.n = 0
+        return bytes(self.out)
+
+
+class BitReader:
+    """Reads bit fields of up to 64 bits, each read touches 9 bytes at most"""
+
+    def __init__(self, data):
+        self.data = data + bytes(9)
+        self.pos = 0
+
+    def read(self, bits):
+        i, shift = self.pos >> 3, self.pos & 7
+        self.pos += bits
+        chunk = int.from_bytes(self.data[i:i + 9], "big")
+        return (chunk >> (72 - shift - bits)) & ((1 << bits) - 1)
+
+
+def encode_times(times):
+    """First delta in 32 bits, then delta-of-delta: '0' or bucket or '1111' + 32 bits"""
+    w = BitWriter()
+    if len(times) < 2:
+        return w.getvalue()
+    delta = times[1] - times[0]
+    w.write(delta, 32)
+    for i in range(2, len(times)):
+        d = times[i] - times[i - 1]
+        dod, delta = d - delta, d
+        if dod == 0:
+            w.write(0, 1)
+            continue
+        for prefix, prefixBits, bits in DOD_BUCKETS:
+            bias = (1 << (bits - 1)) - 1
+            if -bias <= dod <= bias + 1:
+                w.write(prefix, prefixBits)
+                w.write(dod + bias, bits)
+                break
+        else:
+            w.write(0b1111, 4)
+            w.write((dod + (1 << 31)) & 0xFFFFFFFF, 32)
+    return w.getvalue()
+
+
+def decode_times(data, first, rows):
+    times = [first]
+    if rows < 2:
+        return times
+    r = BitReader(data)
+    delta = r.read(32)
+    t = first + delta
+    times.append(t)
+    for _ in range(rows - 2):
+        if r.read(1):
+            if not r.read(1):
+                delta += r.read(7) - 63
+            elif not r.read(1):
+                delta += r.read(9) - 255
+            elif not r.read(1):
+                delta += r.read(12) - 2047
+            else:
+                delta += r.read(32) - (1 << 31)
+        t += delta
+        times.append(t)
+    return times
+
+
+def encode_values(values):
+    """Gorilla XOR: '0' same value, '10' bits inside the previous window,
+    '11' + 5 bits leading zeros + 6 bits length - 1 + the meaningful bits"""
+    words = array("Q")
+    words.frombytes(array("d", values).tobytes())
+    w = BitWriter()
+    prev = words[0]
+    w.write(prev, 64)
+    lead = trail = -1
+    for x in words[1:]:
+        xor, prev = x ^ prev, x
+        if xor == 0:
+            w.write(0, 1)
+            continue
+        l = min(64 - xor.bit_length(), 31)
+        t = (xor & -xor).bit_length() - 1
+        if lead >= 0 and l >= lead and t >= trail:
+            w.write(0b10, 2)
+            w.write(xor >> trail, 64 - lead - trail)
+        else:
+            lead, trail = l, t
+            w.write(0b11, 2)
+            w.write(lead, 5)
+            w.write(63 - lead - trail, 6)
+            w.write(xor >> trail, 64 - lead - trail)
+    return w.getvalue()
+
+
+def decode_values(data, rows):
+    r = BitReader(data)
+    prev = r.read(64)
+    words = array("Q", [prev])
+    lead = trail = 0
+    for _ in range(rows - 1):
+        if r.read(1):
+            if r.read(1):
+                lead = r.read(5)
+                trail = 64 - lead - (r.read(6) + 1)
+            prev ^= r.read(64 - lead - trail) << trail
+        words.append(prev)
+    values = array("d")
+    values.frombytes(words.tobytes())
+    return values
+
+
+def finite(values):
+    """min and max without NaN, NaN if there is no number"""
+    numbers = [v for v in values if not math.isnan(v)]
+    return (min(numbers), max(numbers)) if numbers else (math.nan, math.nan)
+
+
+class Block:
+    """Index entry of one block"""
+    __slots__ = ("clock", "first", "last", "rows", "offset", "timeBytes", "columns")
+
+    def __init__(self, clock, first, last, rows, offset, timeBytes, columns):
+        self.clock, self.first, self.last, self.rows = clock, first, last, rows
+        self.offset, self.timeBytes, self.columns = offset, timeBytes, columns   # [(bytes, min, max)]
+
+    def pack(self):
+        return HEAD.pack(self.clock, self.first, self.last, self.rows, self.offset, self.timeBytes) + \
+            b"".join(COLUMN.pack(*c) for c in self.columns)
+
+    def columnOffset(self, k):
+        return self.offset + self.timeBytes + sum(c[0] for c in self.columns[:k])
+
+
+class Store:
+    def __init__(self, path):
+        os.makedirs(path, exist_ok=True)
+        self.entry = HEAD.size + COLUMN.size * len(COLUMNS)
+        self.blocks = {}          # clock -> blocks in time order
+        self.firsts = {}          # clock -> first timestamps of its blocks, for bisect
+        self.pending = {}         # clock -> (times, columns) not yet written
+        self.stats = {"blocks": 0, "bytes": 0}
+        indexPath = os.path.join(path, "index.dat")
+        if not os.path.exists(indexPath):
+            with open(indexPath, "wb") as f:
+                f.write(MAGIC + struct.pack("<B", len(COLUMNS)))
+        with open(indexPath, "rb") as f:
+            head = f.read(len(MAGIC) + 1)
+            if head[:len(MAGIC)] != MAGIC or head[-1] != len(COLUMNS):
+                raise ValueError("%s is not a store with the columns %s" % (indexPath, ", ".join(COLUMNS)))
+            while True:
+                raw = f.read(self.entry)
+                if len(raw) < self.entry:
+                    break
+                fields = HEAD.unpack_from(raw)
+                columns = [COLUMN.unpack_from(raw, HEAD.size + k * COLUMN.size) for k in range(len(COLUMNS))]
+                self.addBlock(Block(*fields, columns))
+        self.index = open(indexPath, "ab")
+        self.data = open(os.path.join(path, "blocks.dat"), "a+b")
+
+    def addBlock(self, block):
+        self.blocks.setdefault(block.clock, []).append(block)
+        self.firsts.setdefault(block.clock, []).append(block.first)
+
+    def append(self, clock, t, values):
+        """Add one row, the rows of a clock must come in time order"""
+        pending = self.pending.get(clock)
+        if pending is None:
+            last = self.blocks[clock][-1].last if clock in self.blocks else None
+            if last is not None and t <= last:
+                raise ValueError("clock %d: time %d not after %d" % (clock, t, last))
+            pending = self.pending[clock] = ([], [[] for _ in COLUMNS])
+        times, columns = pending
+        if times and (t <= times[-1] or t // BLOCK_SECONDS != times[0] // BLOCK_SECONDS):
+            if t <= times[-1]:
+                raise ValueError("clock %d: time %d not after %d" % (clock, t, times[-1]))
+            self.writeBlock(clock)
+            times, columns = self.pending[clock] = ([], [[] for _ in COLUMNS])
+        times.append(t)
+        for column, v in zip(columns, values):
+            column.append(float(v))
+
+    def writeBlock(self, clock):
+        times, columns = self.pending.pop(clock)
+        if not times:
+            return
+        streams = [encode_times(times)] + [encode_values(c) for c in columns]
+        self.data.seek(0, os.SEEK_END)
+        offset = self.data.tell()
+        self.data.write(b"".join(streams))
+        block = Block(clock, times[0], times[-1], len(times), offset, len(streams[0]),
+                      [(len(s),) + finite(c) for s, c in zip(streams[1:], columns)])
+        self.index.write(block.pack())
+        self.addBlock(block)
+
+    def flush(self):
+        for clock in list(self.pending):
+            self.writeBlock(clock)
+        self.data.flush()
+        self.index.flush()
+
+    def close(self):
+        self.flush()
+        self.data.close()
+        self.index.close()
+
+    def touching(self, clock, start, end):
+        """Blocks of clock overlapping [start, end]"""
+        blocks = self.blocks.get(clock, [])
+        i = max(bisect.bisect_right(self.firsts.get(clock, []), start) - 1, 0)
+        while i < len(blocks) and blocks[i].first <= end:
+            if blocks[i].last >= start:
+                yield blocks[i]
+            i += 1
+
+    def read(self, offset, size):
+        self.data.seek(offset)
+        self.stats["bytes"] += size
+        return self.data.read(size)
+
+    def decode(self, block, ks):
+        """Timestamps and the columns ks of a block"""
+        self.stats["blocks"] += 1
+        times = decode_times(self.read(block.offset, block.timeBytes), block.first, block.rows)
+        return times, [decode_values(self.read(block.columnOffset(k), block.columns[k][0]), block.rows) for k in ks]
+
+    def scan(self, clock, start, end, names=COLUMNS):
+        """Yield (t, values of names) of clock for start <= t <= end"""
+        self.flush()
+        ks = [COLUMNS.index(n) for n in names]
+        for block in self.touching(clock, start, end):
+            times, columns = self.decode(block, ks)
+            lo = bisect.bisect_left(times, start)
+            hi = bisect.bisect_right(times, end)
+            for i in range(lo, hi):
+                yield (times[i],) + tuple(c[i] for c in columns)
+
+    def summary(self, clock, start, end, name):
+        """(rows, min, max) of a column over [start, end]"""
+        self.flush()
+        k = COLUMNS.index(name)
+        rows, lo, hi = 0, math.inf, -math.inf
+        for block in self.touching(clock, start, end):
+            if start <= block.first and block.last <= end:
+                n, bmin, bmax = block.rows, block.columns[k][1], block.columns[k][2]
+            else:
+                times, (values,) = self.decode(block, [k])
+                values = values[bisect.bisect_left(times, start):bisect.bisect_right(times, end)]
+                n = len(values)
+                bmin, bmax = finite(values) if n else (math.nan, math.nan)
+            rows += n
+            if not math.isnan(bmin):
+                lo, hi = min(lo, bmin), max(hi, bmax)
+        return rows, (lo if rows else math.nan), (hi if rows else math.nan)
+
+    def size(self):
+        self.flush()
+        return self.data.seek(0, os.SEEK_END) + self.index.tell()
+
+
+def synthetic(clocks, seconds, start, seed):
+    """Rows (clock, t, offset_us, width_ms, quality) of a fleet, second by second.
+    Every clock has its own resonator drift, receiver jitter and loss rate,
+    the offset is stepped back by the clock discipline once it exceeds 10 ms,
+    quality is the share of the pulses received in the last minute."""
+    rng = random.Random(seed)
+    fleet = []
+    for _ in range(clocks):
+        fleet.append({"ppm": rng.uniform(-50, 50), "noise": rng.randint(20, 2000),
+                      "jitter": rng.randint(0, 20), "loss": rng.randint(0, 50),
+                      "offset": rng.uniform(-5000, 5000), "history": [1] * 60, "good": 60,
+                      "rng": random.Random(rng.random())})
+    for s in range(seconds):
+        t = start + s
+        for clock, c in enumerate(fleet):
+            r = c["rng"]
+            c["offset"] += c["ppm"]
+            if abs(c["offset"]) > 10000:
+                c["offset"] = 0.0
+            ok = r.randrange(1000) >= c["loss"]
+            c["good"] += ok - c["history"][s % 60]
+            c["history"][s % 60] = ok
+            if not ok:
+                continue
+            width = (200 if r.random() < 0.3 else 100) + r.randint(-c["jitter"], c["jitter"])
+            yield clock, t, round(c["offset"] + r.gauss(0, c["noise"])), width, c["good"] / 60
+
+
+def bench(args):
+    path = args.path or tempfile.mkdtemp(prefix="dcf77store")
+    if args.path and os.path.exists(os.path.join(path, "index.dat")):
+        sys.exit("%s exists already, bench needs an empty store" % path)
+    start = 1709161200      # 2024-02-29 00:00 UTC, blocks aligned to the hour
+    try:
+        store = Store(path)
+        rows, keep = 0, {}
+        t0 = time.perf_counter()
+        for clock, t, *values in synthetic(args.clocks, args.seconds, start, args.seed):
+            store.append(clock, t, values)
+            if clock == 0:
+                keep[t] = tuple(float(v) for v in values)
+            rows += 1
+        store.flush()
+        ingest = time.perf_counter() - t0
+        size = store.size()
+        raw = rows * RAW_ROW
+        blocks = [b for clock in store.blocks.values() for b in clock]
+        print("ingest   %d clocks x %d s: %d rows in %.1f s, %.0f rows/s" % (
+            args.clocks, args.seconds, rows, ingest, rows / ingest))
+        print("size     %d bytes raw, %d stored in %d blocks, ratio %.1f" % (raw, size, len(blocks), raw / size))
+        timeBits = 8.0 * sum(b.timeBytes for b in blocks) / rows
+        print("bits/row timestamp %.2f, %s" % (timeBits, ", ".join(
+            "%s %.2f" % (n, 8.0 * sum(b.columns[k][0] for b in blocks) / rows) for k, n in enumerate(COLUMNS))))
+
+        # range scans: random clock and window, all columns and one column
+        rng = random.Random(args.seed + 1)
+        total = store.data.seek(0, os.SEEK_END)
+        for names in (COLUMNS, COLUMNS[:1]):
+            store.stats = {"blocks": 0, "bytes": 0}
+            found = 0
+            t0 = time.perf_counter()
+            for _ in range(args.queries):
+                clock = rng.randrange(args.clocks)
+                length = rng.randint(60, args.window)
+                a = start + rng.randrange(max(args.seconds - length, 1))
+                found += sum(1 for _ in store.scan(clock, a, a + length, names))
+            wall = time.perf_counter() - t0
+            print("scan     %d queries on %s: %d rows in %.2f s, %.0f rows/s, %.1f blocks and %.2f %% of the data per query" % (
+                args.queries, "+".join(names), found, wall, found / wall,
+                store.stats["blocks"] / args.queries, 100.0 * store.stats["bytes"] / args.queries / total))
+
+        store.stats = {"blocks": 0, "bytes": 0}
+        t0 = time.perf_counter()
+        for _ in range(args.queries):
+            clock = rng.randrange(args.clocks)
+            a = start + rng.randrange(args.seconds)
+            store.summary(clock, a, a + args.seconds // 2, "offset_us")
+        wall = time.perf_counter() - t0
+        print("summary  %d queries over %d s: %.1f ms per query, %.1f blocks decoded per query" % (
+            args.queries, args.seconds // 2, 1000 * wall / args.queries, store.stats["blocks"] / args.queries))
+
+        back = {t: tuple(v) for t, *v in store.scan(0, start, start + args.seconds)}
+        same = back.keys() == keep.keys() and all(
+            struct.pack("<3d", *back[t]) == struct.pack("<3d", *keep[t]) for t in keep)
+        print("check    clock 0 round trip of %d rows %s" % (len(keep), "bit exact" if same else "FAILED"))
+        store.close()
+        return 0 if same else 1
+    finally:
+        if not args.path:
+            shutil.rmtree(path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compressed columnar store for per second series of DCF77 clocks")
+    sub = parser.add_subparsers(dest="command", required=True)
+    p = sub.add_parser("bench", help="ingest, compress and scan synthetic fleet data")
+    p.add_argument("--clocks", type=int, default=20)
+    p.add_argument("--seconds", type=int, default=86400, help="seconds of data per clock")
+    p.add_argument("--queries", type=int, default=200)
+    p.add_argument("--window", type=int, default=4 * 3600, help="longest scan window in s")
+    p.add_argument("--path", help="keep the store in this directory, default a temporary one")
+    p.add_argument("--seed", type=int, default=77)
+    p = sub.add_parser("import", help="append rows 'clock unix offset_us width_ms quality'")
+    p.add_argument("store")
+    p.add_argument("input", nargs="?", help="default stdin")
+    for name in ("scan", "summary"):
+        p = sub.add_parser(name, help="rows of a clock and window" if name == "scan" else "rows, min and max")
+        p.add_argument("store")
+        p.add_argument("--clock", type=int, required=True)
+        p.add_argument("--start", type=int, default=0, help="unix seconds")
+        p.add_argument("--end", type=int, default=2 ** 62, help="unix seconds")
+        p.add_argument("--columns", default=",".join(COLUMNS))
+    args = parser.parse_args()
+
+    if args.command == "bench":
+        return bench(args)
+    store = Store(args.store)
+    if args.command == "import":
+        with (open(args.input) if args.input else sys.stdin) as f:
+            for line in f:
+                fields = line.split()
+                if len(fields) == 2 + len(COLUMNS) and not fields[0].startswith("#"):
+                    store.append(int(fields[0]), int(fields[1]), [float(v) for v in fields[2:]])
+    elif args.command == "scan":
+        names = args.columns.split(",")
+        print("unix " + " ".join(names))
+        for row in store.scan(args.clock, args.start, args.end, names):
+            print(" ".join(repr(v) for v in row))
+    else:
+        for name in args.columns.split(","):
+            rows, lo, hi = store.summary(args.clock, args.start, args.end, name)
+            print("%-10s rows %d min %r max %r" % (name, rows, lo, hi))
+    store.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""
+Program      dcf77trace.py
+Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+
+Purpose      Converts a trace dump of the DCF77 radio clock (key [d], build
+             flag DCF77_TRACE) into Chrome trace JSON, which can be opened
+             in https://ui.perfetto.dev or chrome://tracing.
+
+Usage        python3 tools/dcf77trace.py dump.txt > trace.json
+             python3 tools/dcf77trace.py < dump.txt > trace.json
+
+Remarks      Lines not starting with 'T ' are ignored, so a complete
+             serial log can be fed. The 32 bit tick counter (4 us) is 
+             unwrapped, several dumps in one log are concatenated.
+"""
+
+import json
+import sys
+
+TICK_US = 4
+
+# Event ids, keep in sync with lib/DCF77Decoder/DCF77Trace.h
+TR_RISING, TR_FALLING, TR_BIT0, TR_BIT1, TR_GLITCH, TR_MINUTE, TR_CHECK, TR_PUBLISH, TR_OVERRUN = range(1, 10)
+
+TRACKS = {"signal": 1, "decoder": 2, "publish": 3}
+CHECKS = {0x01: "minute parity", 0x02: "hour parity", 0x04: "date parity",
+          0x08: "marker", 0x10: "range", 0x20: "length"}
+
+
+def read_events(lines):
+    """Yield (us, id, arg) with the tick counter unwrapped"""
+    last, offset = None, 0
+    for line in lines:
+        fields = line.split()
+        if len(fields) != 4 or fields[0] != "T":
+            continue
+        ticks, ev, arg = (int(f) for f in fields[1:])
+        if last is not None and ticks < last and last - ticks > 1 << 31:
+            offset += 1 << 32
+        last = ticks
+        yield (ticks + offset) * TICK_US, ev, arg
+
+
+def instant(name, track, us, args=None):
+    return {"name": name, "ph": "i", "s": "t", "ts": us, "pid": 1,
+            "tid": TRACKS[track], "args": args or {}}
+
+
+def convert(lines):
+    events = [{"name": "thread_name", "ph": "M", "pid": 1, "tid": tid,
+               "args": {"name": name}} for name, tid in TRACKS.items()]
+    rising = None
+    for us, ev, arg in read_events(lines):
+        if ev == TR_RISING:
+            rising = us
+            events.append({"name": "edge queue", "ph": "C", "ts": us, "pid": 1, "args": {"size": arg}})
+        elif ev == TR_FALLING:
+            if rising is not None:
+                events.append({"name": "pulse", "ph": "X", "ts": rising, "dur": us - rising,
+                               "pid": 1, "tid": TRACKS["signal"]})
+            rising = None
+        elif ev in (TR_BIT0, TR_BIT1):
+            events.append(instant("bit %d" % (ev - TR_BIT0), "decoder", us, {"seconds": arg}))
+        elif ev == TR_GLITCH:
+            events.append(instant("glitch", "decoder", us, {"seconds": arg}))
+        elif ev == TR_MINUTE:
+            events.append(instant("minute mark", "decoder", us, {"seconds": arg}))
+        elif ev == TR_CHECK:
+            failed = [name for bit, name in CHECKS.items() if arg & bit]
+            events.append(instant("check " + ("ok" if not failed else "failed"), "decoder", us,
+                                  {"failed": failed}))
+        elif ev == TR_PUBLISH:
+            events.append(instant("publish", "publish", us, {"minute": arg}))
+        elif ev == TR_OVERRUN:
+            events.append(instant("edge overrun", "signal", us, {"overruns": arg}))
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def main():
+    if len(sys.argv) > 1:
+        with open(sys.argv[1]) as f:
+            trace = convert(f)
+    else:
+        trace = convert(sys.stdin)
+    json.dump(trace, sys.stdout, indent=1)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
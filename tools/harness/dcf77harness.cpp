@@ -0,0 +1,206 @@
+/**
+ * Program      dcf77harness.cpp
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Runs the decoder of the clock on the host against the
+ *              DCF77Simulator, with a fake millis() advanced by 1 ms per
+ *              step, and checks every published time against the time the
+ *              simulator sent. The figures quoted for the time prior, the
+ *              early decision, the publishing at the minute mark, the slot
+ *              framing and the duty cycled receiver come from this program.
+ *
+ * Build        g++ -std=gnu++11 -O2 -Itools/harness/stub -Ilib/DCF77Core \
+ *                  -Ilib/DCF77Decoder -Ilib/DCF77Simulator -Ilib/DCF77DutyCycle \
+ *                  [-D DCF77_EARLY_DECISION] [-D DCF77_DUTY_CYCLE ...] [-D DCF77_TRACE] \
+ *                  tools/harness/dcf77harness.cpp tools/harness/stub/Arduino.cpp \
+ *                  lib/DCF77Core/DCF77Core.c lib/DCF77Decoder/DCF77Decoder.cpp \
+ *                  lib/DCF77Decoder/DCF77Trace.cpp lib/DCF77Simulator/DCF77Simulator.cpp \
+ *                  lib/DCF77DutyCycle/DCF77DutyCycle.cpp -o dcf77harness
+ *
+ * Usage        ./dcf77harness [options]
+ *              -m minutes   simulated minutes (default 60)
+ *              -g glitch    glitches per mille per second
+ *              -d drop      dropped pulses per mille per second
+ *              -j jitter    pulse width jitter in ms
+ *              -p error     send a time prior that is error seconds off
+ *              -u seconds   uncertainty of the prior (default 300)
+ *              -w ppm       the watchdog runs slow by ppm (default 30000)
+ *              -n           add the real time spent to micros(), for latencies
+ *              -M           print the metrics at the end
+ *              -T           dump the trace buffer at the end (DCF77_TRACE)
+ *              -v           echo the console output of the clock
+ *
+ * Remarks      The simulator starts at Mi 2024-02-28 23:58 MEZ. A published
+ *              time is correct if it is the minute the simulator has just
+ *              completed, every other published time is a false lock.
+ *              With DCF77_SIM_DRIFT the simulated minutes are stretched.
+ *              One step is one ms of the resonator. In power down the 
+ *              simulator keeps running as the real signal would, the fake
+ *              millis() stands still and an emulated watchdog with the 
+ *              error -w wakes the decoder up again.
+ */
+
+#include <unistd.h>
+#include <HarnessClock.h>
+#include <DCF77Simulator.h>
+#ifdef DCF77_DUTY_CYCLE
+#include <DCF77DutyCycle.h>
+#endif
+
+#define START_UNIX   1709161080UL   // 2024-02-28 22:58 UTC, the first telegram
+#define START_MS     500            // millis() at the start of the simulation
+
+extern "C" void TIMER2_COMPA_vect(void);
+#ifdef DCF77_EARLY_DECISION
+extern "C" void TIMER0_COMPB_vect(void);
+extern "C" volatile unsigned long timer0_overflow_count;   // stub Arduino.cpp
+#endif
+
+static uint32_t correct = 0;        // published times equal to the simulated one
+static uint32_t falseLocks = 0;     // published times which are wrong
+static uint32_t firstLock = 0;      // millis() when the first time was published
+static long     wdtError = 30000;   // ppm the watchdog is slower than nominal
+
+#ifdef DCF77_POWER_DOWN
+extern "C" void WDT_vect(void);
+
+/**
+ * Count the watchdog period in real ms, nominal 16 ms * 2^prescaler.
+ * Wakes the MCU from power down and calls the interrupt when it is over.
+ */
+static void watchdogTick()
+{
+  if (!(WDTCSR & _BV(WDIE))) return;
+  uint8_t  prescaler = ((WDTCSR >> WDP3) & 1) << 3 | (WDTCSR & 7);
+  uint32_t period    = (uint32_t)((16UL << prescaler) * (1.0 + wdtError * 1e-6) + 0.5);
+  if (++harnessClock.wdtTicks < period) return;
+  harnessClock.wdtTicks = 0;
+  harnessClock.asleep   = false;
+  WDT_vect();
+}
+#endif
+
+/**
+ * UTC of the minute mark at millis() ms. The first mark after
+ * the start closes the minute before the first telegram.
+ */
+static uint32_t simulatedUnix(uint32_t ms)
+{
+  double minutes = (int32_t)(ms - START_MS) / (60000.0 * (1.0 - DCF77_SIM_DRIFT * 1e-6));
+  return START_UNIX + 60 * (uint32_t)(minutes + 0.5) - 60;
+}
+
+/**
+ * Check the time strings printed by the decoder,
+ * format DCF77TIMEFORMAT, e.g. "Do 2024-02-29 00:03:00 MEZ DCF77"
+ */
+void harnessLine(const char *line)
+{
+  const size_t length = 34;   // the time string follows the bits of the telegram
+  size_t     n = strlen(line);
+  char       wday[4], zone[5];
+  int        year, month, mday, hour, minute, second;
+  dcf77_time expected;
+
+  if (n < length || strcmp(line + n - 6, " DCF77") != 0) return;
+  if (sscanf(line + n - length, "%3s 20%d-%d-%d %d:%d:%d %4s DCF77", wday, &year, &month, &mday,
+             &hour, &minute, &second, zone) != 8) return;
+  if (firstLock == 0) firstLock = millis();
+  // locked with a prior in mid minute: the minute began second s ago
+  dcf77_from_unix(simulatedUnix(millis() - second * 1000UL), 0, &expected);
+  if (year == expected.year && month == expected.month && mday == expected.mday &&
+      hour == expected.hour && minute == expected.minute && strcmp(zone, "MEZ") == 0)
+  {
+    correct++;
+  }
+  else
+  {
+    falseLocks++;
+    if (! harnessClock.echo) printf("false lock at %lu ms: %s\n", millis(), line);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t minutes = 60;
+  uint16_t glitch = 0, drop = 0, uncertainty = 300;
+  uint8_t  jitter = 0;
+  long     priorError = 0;
+  bool     prior = false, metrics = false, trace = false;
+  int      option;
+
+  while ((option = getopt(argc, argv, "m:g:d:j:p:u:w:nMTv")) != -1)
+  {
+    switch (option)
+    {
+      case 'm': minutes = atol(optarg); break;
+      case 'g': glitch = atoi(optarg); break;
+      case 'd': drop = atoi(optarg); break;
+      case 'j': jitter = atoi(optarg); break;
+      case 'p': prior = true; priorError = atol(optarg); break;
+      case 'u': uncertainty = atoi(optarg); break;
+      case 'w': wdtError = atol(optarg); break;
+      case 'n': harnessClock.realMicros = true; break;
+      case 'M': metrics = true; break;
+      case 'T': trace = true; break;
+      case 'v': harnessClock.echo = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-m minutes] [-g glitch] [-d drop] [-j jitter] [-p error] [-u seconds] [-w ppm] [-nMTv]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  tm dcf77Time = {};
+  tm start = {};
+  start.tm_year = 124; start.tm_mon = 1; start.tm_mday = 28; start.tm_wday = 3;
+  start.tm_hour = 23;  start.tm_min = 58;
+  DCF77Decoder   decoder(2, 13, dcf77Time);
+  DCF77Simulator simulator(decoder);
+  simulator.setImpairments(glitch, drop, jitter);
+  simulator.begin(start);
+  while (millis() < START_MS) harnessTick();
+  if (prior) decoder.setTimePrior(START_UNIX - 60 + priorError, uncertainty);
+#ifdef DCF77_DUTY_CYCLE
+  DCF77DutyCycle dutyCycle(decoder, 4);
+  dutyCycle.begin(DCF77_DUTY_PERIOD, DCF77_DUTY_WINDOW);
+  decoder.setVerbose(false);
+#endif
+
+  for (uint32_t i = 0; i < minutes * 60000UL; i++)
+  {
+    if (! harnessClock.asleep) harnessTick();
+    TIMER2_COMPA_vect();
+#ifdef DCF77_POWER_DOWN
+    watchdogTick();
+    if (harnessClock.asleep) continue;
+#endif
+#ifdef DCF77_EARLY_DECISION
+    static unsigned long overflows = 0;   // compare B fires once per Timer0 period
+    if (timer0_overflow_count != overflows)
+    {
+      overflows = timer0_overflow_count;
+      if (TIMSK0 & _BV(OCIE0B)) TIMER0_COMPB_vect();
+    }
+#endif
+    decoder.loop();
+#ifdef DCF77_DUTY_CYCLE
+    dutyCycle.loop();
+    simulator.setReceiverPower(dutyCycle.isReceiverOn());
+#endif
+  }
+
+  harnessClock.echo = true;
+  printf("\n%lu minutes, glitch %u, drop %u, jitter %u: %lu correct, %lu false locks",
+         (unsigned long)minutes, glitch, drop, jitter, (unsigned long)correct, (unsigned long)falseLocks);
+  if (firstLock) printf(", first lock after %lu s", (unsigned long)(firstLock - START_MS) / 1000);
+  printf("\n");
+#ifdef DCF77_DUTY_CYCLE
+  dutyCycle.printReport();
+#endif
+  if (metrics) decoder.printMetrics();
+#ifdef DCF77_TRACE
+  if (trace) dcf77Trace.dump();
+#endif
+  (void)trace;
+  return 0;
+}
@@ -0,0 +1,136 @@
+/**
+ * Module       Arduino.cpp
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Host implementation of the Arduino stand-in: fake clock,
+ *              register variables and a serial port which hands complete
+ *              lines to the harness and optionally echoes them to stdout.
+ */
+
+#define _POSIX_C_SOURCE 199309L   // clock_gettime()
+#include <Arduino.h>
+#include <stdarg.h>
+#include <time.h>
+#include <avr/sleep.h>
+#include "HarnessClock.h"
+
+volatile uint8_t  TCNT0, TCCR0A, TCCR0B, TIMSK0, TIFR0, OCR0A, OCR0B;
+volatile uint8_t  TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+volatile uint16_t TCNT1, OCR1A, OCR1B, ICR1;
+volatile uint8_t  TCCR2A, TCCR2B, TIMSK2, TIFR2, OCR2A, OCR2B, TCNT2, ASSR, GTCCR;
+volatile uint8_t  UCSR0A, UCSR0B, UCSR0C, UDR0, UBRR0H, UBRR0L;
+volatile uint16_t UBRR0, SP;
+volatile uint8_t  PORTB, PORTD, DDRB, DDRD, PINB, PIND, SREG, SMCR, MCUSR, PRR, WDTCSR;
+volatile uint8_t  PCICR, PCIFR, PCMSK2, EICRA, EIMSK, EIFR;
+extern "C" { volatile unsigned long timer0_millis, timer0_overflow_count; }
+
+HarnessClock harnessClock = {};
+HardwareSerial Serial;
+
+static long long nanoseconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Advance the fake clock by one ms, as Timer0 would. 
+ * timer0_millis may have been advanced by the program.
+ */
+void harnessTick()
+{
+  harnessClock.ms       = ++timer0_millis;
+  timer0_overflow_count = harnessClock.ms * 1000 / 1024;
+  TCNT0                 = (harnessClock.ms * 1000 / 4) % 256;
+  if (harnessClock.realMicros) harnessClock.tickNs = nanoseconds();
+}
+
+unsigned long millis() { return timer0_millis; }
+
+/**
+ * Simulated us, plus the real time spent in this tick if realMicros is
+ * set, so latencies measured with micros() show the host CPU time
+ */
+unsigned long micros()
+{
+  unsigned long us = timer0_millis * 1000UL;
+  if (harnessClock.realMicros) us += (unsigned long)((nanoseconds() - harnessClock.tickNs) / 1000);
+  return us;
+}
+
+/**
+ * Power down stops the fake clock until the harness 
+ * fires the watchdog, other sleep modes return at once
+ */
+void set_sleep_mode(int mode) { harnessClock.sleepMode = mode; }
+void sleep_mode() { if (harnessClock.sleepMode == SLEEP_MODE_PWR_DOWN) harnessClock.asleep = true; }
+void wdt_reset() { harnessClock.wdtTicks = 0; }
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+int  digitalRead(uint8_t) { return LOW; }
+void noInterrupts() {}
+void interrupts() {}
+void delay(unsigned long) {}
+void delayMicroseconds(unsigned int) {}
+void attachInterrupt(uint8_t, void (*)(void), int) {}
+void detachInterrupt(uint8_t) {}
+
+void HardwareSerial::begin(unsigned long) {}
+int  HardwareSerial::available() { return 0; }
+int  HardwareSerial::read() { return -1; }
+int  HardwareSerial::peek() { return -1; }
+
+/**
+ * Collect the output in lines for harnessLine()
+ */
+size_t HardwareSerial::write(uint8_t c)
+{
+  static char   line[256];
+  static size_t n = 0;
+
+  if (harnessClock.echo) putchar(c);
+  if (c == '\n' || n == sizeof(line) - 1)
+  {
+    line[n] = 0;
+    harnessLine(line);
+    n = 0;
+  }
+  else if (c != '\r')
+  {
+    line[n++] = c;
+  }
+  return 1;
+}
+
+static size_t printTo(Print &p, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static size_t printTo(Print &p, const char *format, ...)
+{
+  char    text[64];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  return p.write((const uint8_t *)text, (n < (int)sizeof(text)) ? n : sizeof(text) - 1);
+}
+
+size_t Print::print(const __FlashStringHelper *s) { return print((const char *)s); }
+size_t Print::print(const char *s) { return write(s); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+size_t Print::print(unsigned char v, int) { return printTo(*this, "%u", v); }
+size_t Print::print(int v, int) { return printTo(*this, "%d", v); }
+size_t Print::print(unsigned int v, int) { return printTo(*this, "%u", v); }
+size_t Print::print(long v, int) { return printTo(*this, "%ld", v); }
+size_t Print::print(unsigned long v, int) { return printTo(*this, "%lu", v); }
+size_t Print::print(double v, int digits) { return printTo(*this, "%.*f", digits, v); }
+size_t Print::println(const __FlashStringHelper *s) { return print(s) + println(); }
+size_t Print::println(const char *s) { return print(s) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(unsigned char v, int base) { return print(v, base) + println(); }
+size_t Print::println(int v, int base) { return print(v, base) + println(); }
+size_t Print::println(unsigned int v, int base) { return print(v, base) + println(); }
+size_t Print::println(long v, int base) { return print(v, base) + println(); }
+size_t Print::println(unsigned long v, int base) { return print(v, base) + println(); }
+size_t Print::println(double v, int digits) { return print(v, digits) + println(); }
+size_t Print::println() { return write((const uint8_t *)"\r\n", 2); }
@@ -0,0 +1,103 @@
+/**
+ * Header       Arduino.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Minimal stand-in for the Arduino core, just enough to build
+ *              the libraries of the clock on the host for dcf77harness.
+ *              Time is a fake clock advanced by the harness, registers are
+ *              plain variables and the serial port writes to stdout.
+ */
+
+#ifndef _Arduino_H_
+#define _Arduino_H_
+
+#define F_CPU 16000000UL
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#define HIGH         1
+#define LOW          0
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+#define CHANGE       1
+#define LED_BUILTIN  13
+
+typedef uint8_t byte;
+template<class A, class B> auto min(A a, B b) -> decltype(a + b) { return a < b ? a : b; }
+template<class A, class B> auto max(A a, B b) -> decltype(a + b) { return a > b ? a : b; }
+
+unsigned long millis();
+unsigned long micros();
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int  digitalRead(uint8_t pin);
+void noInterrupts();
+void interrupts();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void attachInterrupt(uint8_t irq, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t irq);
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : -1))
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+class Print 
+{
+  public:
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) { size_t n = 0; while (size--) n += write(*buffer++); return n; }
+    size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+    virtual int availableForWrite() { return 64; }
+    virtual void flush() {}
+    size_t print(const __FlashStringHelper *s);
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(unsigned char v, int base = 10);
+    size_t print(int v, int base = 10);
+    size_t print(unsigned int v, int base = 10);
+    size_t print(long v, int base = 10);
+    size_t print(unsigned long v, int base = 10);
+    size_t print(double v, int digits = 2);
+    size_t println(const __FlashStringHelper *s);
+    size_t println(const char *s);
+    size_t println(char c);
+    size_t println(unsigned char v, int base = 10);
+    size_t println(int v, int base = 10);
+    size_t println(unsigned int v, int base = 10);
+    size_t println(long v, int base = 10);
+    size_t println(unsigned long v, int base = 10);
+    size_t println(double v, int digits = 2);
+    size_t println();
+};
+
+class Stream : public Print 
+{
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+class HardwareSerial : public Stream 
+{
+  public:
+    void begin(unsigned long baud);
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t c);
+    using Print::write;
+    void _rx_complete_irq() {}
+    void _tx_udr_empty_irq() {}
+};
+extern HardwareSerial Serial;
+#endif
@@ -0,0 +1,26 @@
+/**
+ * Header       HarnessClock.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Fake clock and output hook shared by the Arduino stand-in
+ *              and the harness
+ */
+
+#ifndef _HarnessClock_H_
+#define _HarnessClock_H_
+
+typedef struct
+{
+  unsigned long ms;          // millis()
+  bool      realMicros;      // add the real time spent in the tick to micros()
+  long long tickNs;          // real time at the start of the tick
+  bool      echo;            // copy the console output to stdout
+  int       sleepMode;       // set_sleep_mode()
+  bool      asleep;          // in power down, Timer0 stands still
+  unsigned long wdtTicks;    // real ms since the watchdog was reset
+} HarnessClock;
+
+extern HarnessClock harnessClock;
+void harnessTick();
+void harnessLine(const char *line);   // every complete console line, defined by the harness
+#endif
@@ -0,0 +1,14 @@
+/**
+ * Header       avr/interrupt.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Interrupt vectors become plain functions the harness calls
+ */
+
+#ifndef _AVR_INTERRUPT_H_
+#define _AVR_INTERRUPT_H_
+
+#define ISR(vector) extern "C" void vector(void)
+#define sei()
+#define cli()
+#endif
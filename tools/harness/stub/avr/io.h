@@ -0,0 +1,93 @@
+/**
+ * Header       avr/io.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      ATmega328P registers and bits used by the libraries, as 
+ *              plain variables for the host build of dcf77harness
+ */
+
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+#include <stdint.h>
+
+extern volatile uint8_t  TCNT0, TCCR0A, TCCR0B, TIMSK0, TIFR0, OCR0A, OCR0B;
+extern volatile uint8_t  TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+extern volatile uint16_t TCNT1, OCR1A, OCR1B, ICR1;
+extern volatile uint8_t  TCCR2A, TCCR2B, TIMSK2, TIFR2, OCR2A, OCR2B, TCNT2, ASSR, GTCCR;
+extern volatile uint8_t  UCSR0A, UCSR0B, UCSR0C, UDR0, UBRR0H, UBRR0L;
+extern volatile uint16_t UBRR0, SP;
+extern volatile uint8_t  PORTB, PORTD, DDRB, DDRD, PINB, PIND, SREG, SMCR, MCUSR, PRR, WDTCSR;
+extern volatile uint8_t  PCICR, PCIFR, PCMSK2, EICRA, EIMSK, EIFR;
+
+#define _BV(b)   (1 << (b))
+#define RAMEND   0x8FF
+
+#define CS00     0
+#define CS01     1
+#define CS02     2
+#define OCIE0B   2
+#define OCF0B    2
+#define CS10     0
+#define CS11     1
+#define CS12     2
+#define WGM10    0
+#define WGM11    1
+#define WGM12    3
+#define WGM13    4
+#define COM1A0   6
+#define COM1A1   7
+#define COM1B1   5
+#define ICES1    6
+#define ICNC1    7
+#define ICIE1    5
+#define ICF1     5
+#define TOIE1    0
+#define TOV1     0
+#define OCIE1A   1
+#define OCIE1B   2
+#define OCF1B    2
+#define CS20     0
+#define CS21     1
+#define CS22     2
+#define WGM20    0
+#define WGM21    1
+#define WGM22    3
+#define OCIE2A   1
+#define OCF2A    1
+#define TOIE2    0
+#define RXEN0    4
+#define TXEN0    3
+#define RXCIE0   7
+#define UDRIE0   5
+#define U2X0     1
+#define UDRE0    5
+#define RXC0     7
+#define TXC0     6
+#define UCSZ00   1
+#define UCSZ01   2
+#define FE0      4
+#define DOR0     3
+#define UPE0     2
+#define PB0      0
+#define PB1      1
+#define PD2      2
+#define PD3      3
+#define ISC00    0
+#define ISC01    1
+#define INT0     0
+#define INT1     1
+#define INTF0    0
+#define WDIF     7
+#define WDIE     6
+#define WDP3     5
+#define WDCE     4
+#define WDE      3
+#define WDP2     2
+#define WDP1     1
+#define WDP0     0
+#define PCIE2    2
+#define PCIF2    2
+#define PCINT16  0
+#define WDRF     3
+#endif
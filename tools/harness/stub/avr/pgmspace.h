@@ -0,0 +1,19 @@
+/**
+ * Header       avr/pgmspace.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Flash is ordinary memory on the host
+ */
+
+#ifndef _AVR_PGMSPACE_H_
+#define _AVR_PGMSPACE_H_
+
+#define PROGMEM
+#define PSTR(s)            (s)
+#define pgm_read_byte(p)   (*(const uint8_t *)(p))
+#define pgm_read_word(p)   (*(const uint16_t *)(p))
+#define pgm_read_dword(p)  (*(const uint32_t *)(p))
+#define pgm_read_ptr(p)    (*(void * const *)(p))
+#define memcpy_P           memcpy
+#define strlen_P           strlen
+#endif
@@ -0,0 +1,16 @@
+/**
+ * Header       avr/sleep.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Sleep modes, sleep_mode() returns at once on the host,
+ *              in power down the harness stops the fake clock
+ */
+
+#ifndef _AVR_SLEEP_H_
+#define _AVR_SLEEP_H_
+
+#define SLEEP_MODE_IDLE      0
+#define SLEEP_MODE_PWR_DOWN  2
+void set_sleep_mode(int mode);
+void sleep_mode();
+#endif
@@ -0,0 +1,12 @@
+/**
+ * Header       avr/wdt.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      Watchdog reset, restarts the emulated watchdog period
+ */
+
+#ifndef _AVR_WDT_H_
+#define _AVR_WDT_H_
+
+void wdt_reset();
+#endif
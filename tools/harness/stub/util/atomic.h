@@ -0,0 +1,14 @@
+/**
+ * Header       util/atomic.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ * 
+ * Purpose      The harness is single threaded, an atomic block is a block
+ */
+
+#ifndef _UTIL_ATOMIC_H_
+#define _UTIL_ATOMIC_H_
+
+#define ATOMIC_BLOCK(type) for (int _done = 0; !_done; _done = 1)
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#endif
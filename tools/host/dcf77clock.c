@@ -0,0 +1,452 @@
+/**
+ * Program      dcf77clock.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      DCF77 clock on a Linux host: a real-time thread waits for
+ *              the edges of the receiver, stamps them with
+ *              CLOCK_MONOTONIC_RAW and hands them to the decoding thread,
+ *              which feeds them to the core with the framing by time
+ *              slots, dcf77_push_framed_edge(), as the firmware does.
+ *              The decoded minutes go to the publishing thread, which
+ *              prints them, and every edge with its event to the logging
+ *              thread, which writes them to the log file.
+ *              At the end the number of published and rejected minutes
+ *              and the latency histograms are printed.
+ *
+ * Build        cc -O2 -pthread -Ilib/DCF77Core -Itools/host tools/host/dcf77clock.c \
+ *                 tools/host/dcf77host.c tools/host/dcf77ring.c tools/host/dcf77metrics.c \
+ *                 tools/host/dcf77sntp.c tools/host/dcf77serial.c tools/host/dcf77gpio.c \
+ *                 tools/host/dcf77sim.c lib/DCF77Core/DCF77Core.c -o dcf77clock
+ *
+ * Usage        ./dcf77clock --serial /dev/ttyS0:dcd [--invert]
+ *              ./dcf77clock --gpio /dev/gpiochip0:17 [--invert] [--poll 1000]
+ *              ./dcf77clock --sim [seed] [--speed 20] [--jitter 10]
+ *                           [--drop 20] [--glitch 50] [--minutes 10]
+ *              ./dcf77clock --gpio /dev/gpiochip1:0 --drive .../sim_gpio0/pull
+ *                           [--sim seed] [--poll 1000] [--minutes 10]
+ *              --priority  SCHED_FIFO priority of the acquisition, 0 for
+ *                          the default policy, default 50; decoding,
+ *                          publishing and logging run 1, 2 and 3 below
+ *              --cpu       cores the acquisition, decoding, publishing and
+ *                          logging are pinned to, e.g. 3,2,1,1; the last
+ *                          one given holds for the threads not given
+ *              --spin      ns a thread busy-polls its queue before it
+ *                          sleeps on a futex, default 0
+ *              --log       file of all edges as ns,level,event
+ *              --stress    threads at the default policy which keep all
+ *                          cores and their caches busy during the run
+ *              --metrics   port on 127.0.0.1 of the Prometheus endpoint
+ *              --sntp      port on 127.0.0.1 of the SNTP server
+ *              --sntp-batch  requests per recvmmsg(), 1 .. 32, default 32
+ *              --speed     time lapse of the simulated signal, the core
+ *                          gets the stamps multiplied by it
+ *              --poll      read the GPIO line every us instead of waiting
+ *                          for its line events
+ *              --drive     the simulator drives a gpio-sim line through
+ *                          its pull attribute, see dcf77gpiosim.sh
+ *
+ * Remarks      The threads pass records through lock-free single producer
+ *              single consumer queues (dcf77ring.c); the acquisition never
+ *              waits for them, a full queue drops the record and counts
+ *              it as overrun.
+ *              The wake up latency is measured with the simulated source
+ *              only: the time from the write of an edge into the pipe to
+ *              the stamp taken when read() returns; or, when it drives a
+ *              GPIO line, to the stamp of the kernel or of the poll. A
+ *              receiver has no reference, there the number of changes lost
+ *              between two reads is counted instead. For every source the
+ *              time from the stamp of an edge to its log record and from
+ *              the stamp of a minute mark to the publication of its time
+ *              are measured, the latency of the pipeline.
+ *              The CPU time of the acquisition is printed per second it
+ *              ran and the edges per read() of the source.
+ *              Each thread counts its metrics in counters of its own, the
+ *              endpoint merges them when it is scraped (dcf77metrics.c).
+ *              The publishing thread sets the epoch the SNTP server takes
+ *              the time from (dcf77sntp.c).
+ *              Without the permission for SCHED_FIFO (root or
+ *              CAP_SYS_NICE) the threads run with the default policy.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <dcf77host.h>
+
+#define STRESS_SIZE (8 << 20) // bytes a stress thread walks through
+
+typedef struct
+{
+  uint64_t   ns;              // stamp of the minute mark
+  dcf77_time time;
+  uint32_t   utc;
+} Minute;
+
+typedef struct
+{
+  host_edge edge;
+  uint8_t   event;            // DCF77_EV_*
+} Logged;
+
+typedef struct
+{
+  host_source  *src;
+  host_decoder  dec;
+  host_ring     edges;        // acquisition -> decoding
+  host_ring     minutes;      // decoding -> publishing
+  host_ring     logged;       // decoding -> logging
+  host_latency  wake;         // simulator -> stamp
+  host_latency  publish;      // stamp of the minute mark -> published
+  host_latency  log;          // stamp -> logged
+  host_metrics  metrics;      // counters of the threads in the order of run[]
+  host_epoch    epoch;        // last published minute mark, for the SNTP server
+  host_sntp     sntp;
+  FILE         *logFile;
+  uint32_t      maxMinutes;   // 0: run until stopped
+  _Atomic int   stop;         // decoding has published maxMinutes
+  uint64_t      cpu;          // ns the acquisition ran on a CPU
+  uint64_t      wall;         // ns it existed
+  pthread_t     main;
+} Clock;
+
+static const char *weekday[] = { "", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun" };
+static _Atomic int stressing;
+
+/**
+ * Acquisition: stamp the edges and queue them for the decoding
+ * until the source ends or the decoding stops
+ */
+static void *acquire(void *arg)
+{
+  Clock     *clk   = arg;
+  uint64_t   start = host_now();
+  host_counters *counters = &clk->metrics.thread[0];
+  host_edge  edge;
+  int        n     = 0;
+  struct timespec cpu;
+
+  while (! atomic_load_explicit(&clk->stop, memory_order_relaxed) && (n = clk->src->read(clk->src, &edge)) > 0)
+  {
+    if (edge.sent != 0) host_latency_add(&clk->wake, edge.ns - edge.sent);
+    host_count(counters, HOST_EDGES, 1);
+    if (! host_ring_push(&clk->edges, &edge)) host_count(counters, HOST_OVERRUNS, 1);
+  }
+  if (! atomic_load(&clk->stop) && n < 0) perror(clk->src->name);
+  host_ring_close(&clk->edges);
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+  clk->cpu  = cpu.tv_sec * 1000000000ULL + cpu.tv_nsec;
+  clk->wall = host_now() - start;
+  pthread_kill(clk->main, SIGUSR1);
+  return NULL;
+}
+
+/**
+ * Decoding: every edge goes to the log,
+ * every published minute to the publishing
+ */
+static void *decode(void *arg)
+{
+  Clock         *clk      = arg;
+  host_counters *counters = &clk->metrics.thread[1];
+  Logged         rec;
+  Minute         minute;
+
+  while (host_ring_pop(&clk->edges, &rec.edge))
+  {
+    int     published = host_decode(&clk->dec, &rec.edge, &minute.time, &minute.utc);
+    uint8_t status    = clk->dec.status;
+
+    rec.event = clk->dec.event;
+    if (rec.event == DCF77_EV_GLITCH) host_count(counters, HOST_GLITCHES, 1);
+    if (! host_ring_push(&clk->logged, &rec)) host_count(counters, HOST_OVERRUNS, 1);
+    if (status != HOST_UNCHECKED)
+    {
+      host_count(counters, published ? HOST_FRAMES_OK : HOST_FRAMES_REJECTED, 1);
+      if (status & DCF77_ERR_MINUTE) host_count(counters, HOST_ERR_MINUTE, 1);
+      if (status & DCF77_ERR_HOUR)   host_count(counters, HOST_ERR_HOUR,   1);
+      if (status & DCF77_ERR_DATE)   host_count(counters, HOST_ERR_DATE,   1);
+      if (status & DCF77_ERR_MARKER) host_count(counters, HOST_ERR_MARKER, 1);
+    }
+    if (! published) continue;
+    minute.ns = rec.edge.ns;
+    if (! host_ring_push(&clk->minutes, &minute)) host_count(counters, HOST_OVERRUNS, 1);
+    if (clk->maxMinutes != 0 && clk->dec.minutes >= clk->maxMinutes)
+    {
+      atomic_store(&clk->stop, 1);
+      break;
+    }
+  }
+  host_ring_close(&clk->minutes);
+  host_ring_close(&clk->logged);
+  return NULL;
+}
+
+static void *publish(void *arg)
+{
+  Clock         *clk      = arg;
+  host_counters *counters = &clk->metrics.thread[2];
+  Minute         m;
+  uint64_t       now;
+
+  while (host_ring_pop(&clk->minutes, &m))
+  {
+    printf("%3s 20%02d-%02d-%02d %02d:%02d:%02d %4s DCF77 %u\n", weekday[m.time.wday], m.time.year, m.time.month,
+           m.time.mday, m.time.hour, m.time.minute, 0, m.time.isdst > 0 ? "MESZ" : "MEZ", m.utc);
+    fflush(stdout);
+    now = host_now();
+    host_latency_add(&clk->publish, now - m.ns);
+    host_count_latency(counters, now - m.ns);
+    atomic_store_explicit(&counters->value[HOST_PUBLISHED], now, memory_order_relaxed);
+    host_epoch_set(&clk->epoch, m.ns, m.utc, m.time.flags);
+  }
+  return NULL;
+}
+
+static void *logEdges(void *arg)
+{
+  Clock  *clk = arg;
+  Logged  rec;
+
+  while (host_ring_pop(&clk->logged, &rec))
+  {
+    if (clk->logFile != NULL)
+    {
+      fprintf(clk->logFile, "%llu,%u,%u\n", (unsigned long long)rec.edge.ns, rec.edge.rising, rec.event);
+    }
+    host_latency_add(&clk->log, host_now() - rec.edge.ns);
+  }
+  if (clk->logFile != NULL) fflush(clk->logFile);
+  return NULL;
+}
+
+/**
+ * Load for the latency measurement:
+ * compute and walk through a buffer larger than the caches
+ */
+static void *stress(void *arg)
+{
+  volatile unsigned char *buf = malloc(STRESS_SIZE);
+  uint32_t x = (uint32_t)(uintptr_t)arg;
+
+  while (buf != NULL && atomic_load_explicit(&stressing, memory_order_relaxed))
+  {
+    for (size_t i = 0; i < STRESS_SIZE; i += HOST_CACHELINE)
+    {
+      x      = x * 1664525 + 1013904223;
+      buf[i] = (unsigned char)x;
+    }
+  }
+  free((void *)buf);
+  return NULL;
+}
+
+/**
+ * Parse the cores of the threads, "3,2,1,1";
+ * a thread not given takes the core of the one before
+ */
+static void parseCpus(const char *arg, int cpus[HOST_THREADS])
+{
+  char *end;
+
+  for (int i = 0; i < HOST_THREADS; i++)
+  {
+    cpus[i] = (i == 0) ? -1 : cpus[i - 1];
+    if (*arg == '\0') continue;
+    cpus[i] = (int)strtol(arg, &end, 0);
+    arg     = (*end == ',') ? end + 1 : end;
+  }
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: dcf77clock --serial dev[:dcd|cts|dsr|ri] | --gpio chip:line [--poll us] [--invert]\n"
+                  "       | --sim [seed] [--speed x] [--jitter ms] [--drop per1000] [--glitch per1000]\n"
+                  "       | --gpio chip:line --drive pull [--sim seed] [--poll us]\n"
+                  "       [--minutes n] [--priority p] [--cpu a,d,p,l] [--spin ns] [--log file] [--stress n]\n"
+                  "       [--metrics port] [--sntp port] [--sntp-batch n]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option options[] =
+  {
+    { "serial",   required_argument, NULL, 's' }, { "sim",     optional_argument, NULL, 'S' },
+    { "invert",   no_argument,       NULL, 'i' }, { "speed",   required_argument, NULL, 'x' },
+    { "jitter",   required_argument, NULL, 'j' }, { "drop",    required_argument, NULL, 'd' },
+    { "glitch",   required_argument, NULL, 'g' }, { "minutes", required_argument, NULL, 'm' },
+    { "priority", required_argument, NULL, 'p' }, { "cpu",     required_argument, NULL, 'c' },
+    { "gpio",     required_argument, NULL, 'G' }, { "poll",    required_argument, NULL, 'P' },
+    { "drive",    required_argument, NULL, 'D' }, { "spin",    required_argument, NULL, 'w' },
+    { "log",      required_argument, NULL, 'l' }, { "stress",  required_argument, NULL, 'T' },
+    { "metrics",  required_argument, NULL, 'M' }, { "sntp",    required_argument, NULL, 'N' },
+    { "sntp-batch", required_argument, NULL, 'B' },
+    { NULL, 0, NULL, 0 }
+  };
+  static void *(*const run[HOST_THREADS])(void *) = { acquire, decode, publish, logEdges };
+  static Clock clk;
+  const char  *arg      = NULL, *seed = NULL, *logPath = NULL;
+  int          priority = 50, cpus[HOST_THREADS] = { -1, -1, -1, -1 }, opt, sig, err;
+  int          stressors = 0, port = 0, sntpPort = 0;
+  uint64_t     spin     = 0;
+  host_source  config   = host_sim;
+  sigset_t     stop;
+  pthread_t    thread[HOST_THREADS], endpoint, server, *load = NULL;
+
+  clk.src = NULL;
+  while ((opt = getopt_long(argc, argv, "", options, NULL)) >= 0)
+  {
+    switch (opt)
+    {
+      case 's': clk.src = &host_serial; arg = optarg; break;
+      case 'G': clk.src = &host_gpio;   arg = optarg; break;
+      case 'S': seed = optarg; if (clk.src != &host_gpio) clk.src = &host_sim; break;
+      case 'P': config.poll       = strtoul(optarg, NULL, 0); break;
+      case 'D': config.drive      = optarg; break;
+      case 'i': config.invert     = 1; break;
+      case 'x': config.speed      = atof(optarg); break;
+      case 'j': config.jitter     = atoi(optarg); break;
+      case 'd': config.drop       = atoi(optarg); break;
+      case 'g': config.glitch     = atoi(optarg); break;
+      case 'm': clk.maxMinutes    = strtoul(optarg, NULL, 0); break;
+      case 'p': priority          = atoi(optarg); break;
+      case 'c': parseCpus(optarg, cpus); break;
+      case 'w': spin              = strtoull(optarg, NULL, 0); break;
+      case 'l': logPath           = optarg; break;
+      case 'T': stressors         = atoi(optarg); break;
+      case 'M': port              = atoi(optarg); break;
+      case 'N': sntpPort          = atoi(optarg); break;
+      case 'B': clk.sntp.batch    = atoi(optarg); break;
+      default:  usage();
+    }
+  }
+  if (clk.src == NULL || optind != argc) usage();
+  if (clk.src == &host_sim) arg = seed;
+  clk.src->invert  = config.invert;
+  host_gpio.poll   = config.poll;
+  host_sim.speed   = config.speed;
+  host_sim.jitter  = config.jitter;
+  host_sim.drop    = config.drop;
+  host_sim.glitch  = config.glitch;
+  host_sim.drive   = config.drive;
+  // the kernel stamps a driven line in real time only
+  if (config.speed <= 0 || (config.drive != NULL && (clk.src != &host_gpio || config.speed != 1.0))) usage();
+  host_decoder_init(&clk.dec, clk.src == &host_sim ? config.speed : 1.0);
+  if (host_ring_init(&clk.edges, sizeof(host_edge), spin) < 0 || host_ring_init(&clk.minutes, sizeof(Minute), spin) < 0 ||
+      host_ring_init(&clk.logged, sizeof(Logged), spin) < 0)
+  {
+    perror("queues");
+    return 1;
+  }
+  if (logPath != NULL && (clk.logFile = fopen(logPath, "w")) == NULL)
+  {
+    perror(logPath);
+    return 1;
+  }
+  if (port != 0 && host_metrics_listen(&clk.metrics, port) < 0)
+  {
+    perror("metrics");
+    return 1;
+  }
+  clk.sntp.epoch = &clk.epoch;
+  clk.sntp.speed = clk.dec.speed;
+  if (sntpPort != 0 && host_sntp_open(&clk.sntp, sntpPort) < 0)
+  {
+    perror("sntp");
+    return 1;
+  }
+
+  // the threads inherit the blocked signals, main waits for them
+  sigemptyset(&stop);
+  sigaddset(&stop, SIGINT);
+  sigaddset(&stop, SIGTERM);
+  sigaddset(&stop, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &stop, NULL);
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) perror("mlockall");
+  if (clk.src->open(clk.src, arg) < 0)
+  {
+    perror(arg ? arg : clk.src->name);
+    return 1;
+  }
+  // the GPIO source has set host_clock, the simulator stamps with it
+  if (config.drive != NULL)
+  {
+    if (host_sim.open(&host_sim, seed) < 0)
+    {
+      perror(config.drive);
+      return 1;
+    }
+    clk.src->ref = host_sim.fd;
+    fcntl(host_sim.fd, F_SETFL, fcntl(host_sim.fd, F_GETFL) | O_NONBLOCK);
+  }
+  clk.main = pthread_self();
+  // consumers first, so that they wait when the first edge comes
+  for (int i = HOST_THREADS - 1; i >= 0; i--)
+  {
+    if ((err = host_rt_thread(&thread[i], run[i], &clk, priority > i ? priority - i : 0, cpus[i])) != 0)
+    {
+      fprintf(stderr, "thread %d: %s\n", i, strerror(err));
+      return 1;
+    }
+  }
+  // scrapes run at the default policy, on any core
+  if (port != 0 && (err = host_rt_thread(&endpoint, host_metrics_serve, &clk.metrics, 0, -1)) != 0)
+  {
+    fprintf(stderr, "metrics: %s\n", strerror(err));
+    return 1;
+  }
+  if (sntpPort != 0 && (err = host_rt_thread(&server, host_sntp_serve, &clk.sntp, 0, -1)) != 0)
+  {
+    fprintf(stderr, "sntp: %s\n", strerror(err));
+    return 1;
+  }
+  if (stressors > 0 && (load = calloc(stressors, sizeof(pthread_t))) != NULL)
+  {
+    atomic_store(&stressing, 1);
+    for (int i = 0; i < stressors; i++) host_rt_thread(&load[i], stress, (void *)(uintptr_t)(i + 1), 0, -1);
+  }
+  sigwait(&stop, &sig);
+  atomic_store(&stressing, 0);
+  for (int i = 0; load != NULL && i < stressors; i++) pthread_join(load[i], NULL);
+  // a receiver blocks in the kernel, the summary does not wait for it
+  if (sig == SIGUSR1)
+  {
+    for (int i = 0; i < HOST_THREADS; i++) pthread_join(thread[i], NULL);
+    clk.src->close(clk.src);
+    if (config.drive != NULL) host_sim.close(&host_sim);
+  }
+  if (clk.logFile != NULL) fclose(clk.logFile);
+  fprintf(stderr, "%u minutes published, %u wrong, %u rejected, %u glitches, %u changes missed, %u overruns\n",
+          clk.dec.minutes, clk.dec.wrong, clk.dec.rejected, clk.dec.glitches, clk.src->missed,
+          clk.edges.overruns + clk.minutes.overruns + clk.logged.overruns);
+  if (clk.sntp.batches != 0)
+  {
+    fprintf(stderr, "# sntp_requests %llu\n# sntp_replies %llu\n# sntp_requests_per_batch %.2f\n",
+            (unsigned long long)clk.sntp.requests, (unsigned long long)clk.sntp.replies,
+            (double)clk.sntp.requests / clk.sntp.batches);
+  }
+  if (clk.wall != 0)
+  {
+    fprintf(stderr, "# cpu_us_per_s %.1f\n", clk.cpu / (clk.wall / 1e6));
+  }
+  if (clk.src->reads != 0)
+  {
+    fprintf(stderr, "# edges_per_read %.3f\n", (double)clk.src->batched / clk.src->reads);
+  }
+  if (clk.wake.total != 0)
+  {
+    fprintf(stderr, "# wake up: simulator to stamp\n");
+    host_latency_print(&clk.wake, stderr);
+  }
+  fprintf(stderr, "# log: stamp to logged\n");
+  host_latency_print(&clk.log, stderr);
+  fprintf(stderr, "# publish: stamp of the minute mark to published\n");
+  host_latency_print(&clk.publish, stderr);
+  return 0;
+}
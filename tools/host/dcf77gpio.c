@@ -0,0 +1,183 @@
+/**
+ * Module       dcf77gpio.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Edge source for a receiver on a GPIO line, with the line
+ *              events of the GPIO character device, uAPI v2: the kernel
+ *              stamps each edge in its interrupt handler and queues it,
+ *              one read() takes all edges queued since the last one.
+ *              With poll set the line is read every poll us instead and
+ *              a change is stamped when it is seen, for the comparison.
+ *
+ * Remarks      The open argument is the chip and the offset of the line,
+ *              e.g. /dev/gpiochip0:17. The kernel stamps are
+ *              CLOCK_MONOTONIC, host_clock is set to it, so that they can
+ *              be compared with the stamps of the simulator.
+ *              The sequence number of the line tells how many edges the
+ *              kernel dropped because its queue was full; a poll misses
+ *              the pulses shorter than its period without knowing it.
+ *              If the simulator drives the line through gpio-sim, it sends
+ *              every edge through the pipe ref, non-blocking, before it 
+ *              sets the level.
+ *              An edge takes sent and utc from the last edge of the same
+ *              level sent before it was stamped.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#include <dcf77host.h>
+
+#define GPIO_BATCH 16    // events taken by one read()
+#define GPIO_QUEUE 64    // events the kernel keeps for the line
+
+typedef struct
+{
+  struct gpio_v2_line_event event[GPIO_BATCH];
+  int       count;       // events in the batch
+  int       next;        // next event of the batch to return
+  uint32_t  seqno;       // of the last event of the line
+  int       level;       // polling: last level
+  uint64_t  wake;        // polling: ns of the next read
+  host_edge ahead;       // reference edge not yet due
+  int       hasAhead;
+} Gpio;
+
+/**
+ * Take sent and utc of the edge from the simulator,
+ * if it drives the line
+ */
+static void reference(host_source *src, Gpio *g, host_edge *edge)
+{
+  edge->sent = 0;
+  edge->utc  = 0;
+  if (src->ref < 0) return;
+  for (;;)
+  {
+    if (! g->hasAhead)
+    {
+      if (read(src->ref, &g->ahead, sizeof(g->ahead)) != sizeof(g->ahead)) return;
+      g->hasAhead = 1;
+    }
+    if (g->ahead.sent > edge->ns) return;
+    if (g->ahead.rising == edge->rising)
+    {
+      edge->sent = g->ahead.sent;
+      edge->utc  = g->ahead.utc;
+    }
+    g->hasAhead = 0;
+  }
+}
+
+static int gpioOpen(host_source *src, const char *arg)
+{
+  struct gpio_v2_line_request  req    = { 0 };
+  struct gpio_v2_line_values   values = { .mask = 1 };
+  char  *path = strdup(arg);
+  char  *line = strrchr(path, ':');
+  Gpio  *g    = calloc(1, sizeof(Gpio));
+  int    chip;
+
+  if (line == NULL)
+  {
+    free(path);
+    free(g);
+    errno = EINVAL;
+    return -1;
+  }
+  *line++ = '\0';
+  chip = open(path, O_RDWR | O_CLOEXEC);
+  req.offsets[0]        = strtoul(line, NULL, 0);
+  free(path);
+  req.num_lines         = 1;
+  req.config.flags      = GPIO_V2_LINE_FLAG_INPUT | (src->invert ? GPIO_V2_LINE_FLAG_ACTIVE_LOW : 0) |
+                          (src->poll == 0 ? GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING : 0);
+  req.event_buffer_size = GPIO_QUEUE;
+  strcpy(req.consumer, "dcf77clock");
+  if (chip < 0 || ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &req) < 0 ||
+      ioctl(req.fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0)
+  {
+    if (chip >= 0) close(chip);
+    free(g);
+    return -1;
+  }
+  close(chip);
+  host_clock = CLOCK_MONOTONIC;
+  g->level   = values.bits & 1;
+  g->wake    = host_now();
+  src->fd    = req.fd;
+  src->state = g;
+  return 0;
+}
+
+static int gpioRead(host_source *src, host_edge *edge)
+{
+  Gpio *g = src->state;
+  struct gpio_v2_line_event *ev;
+  ssize_t n;
+
+  if (g->next == g->count)
+  {
+    do n = read(src->fd, g->event, sizeof(g->event)); while (n < 0 && errno == EINTR);
+    if (n <= 0) return (int)n;
+    src->reads++;
+    g->count = n / sizeof(g->event[0]);
+    g->next  = 0;
+  }
+  ev = &g->event[g->next++];
+  // the first event has seqno 1, a gap is what the kernel had no room for
+  src->missed  += ev->line_seqno - g->seqno - 1;
+  g->seqno      = ev->line_seqno;
+  src->batched++;
+  edge->ns      = ev->timestamp_ns;
+  edge->rising  = (ev->id == GPIO_V2_LINE_EVENT_RISING_EDGE);
+  reference(src, g, edge);
+  return 1;
+}
+
+/**
+ * Read the level every poll us until it changes
+ */
+static int pollRead(host_source *src, host_edge *edge)
+{
+  Gpio *g = src->state;
+  struct gpio_v2_line_values values = { .mask = 1 };
+  struct timespec ts;
+
+  for (;;)
+  {
+    g->wake    += (uint64_t)src->poll * 1000;
+    ts.tv_sec   = g->wake / 1000000000;
+    ts.tv_nsec  = g->wake % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+    if (ioctl(src->fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) return -1;
+    src->reads++;
+    if ((int)(values.bits & 1) == g->level) continue;
+    edge->ns     = host_now();
+    g->level     = values.bits & 1;
+    edge->rising = g->level;
+    src->batched++;
+    reference(src, g, edge);
+    return 1;
+  }
+}
+
+static int gpioDispatch(host_source *src, host_edge *edge)
+{
+  return (src->poll == 0) ? gpioRead(src, edge) : pollRead(src, edge);
+}
+
+static void gpioClose(host_source *src)
+{
+  close(src->fd);
+  free(src->state);
+}
+
+host_source host_gpio = { .name = "gpio", .open = gpioOpen, .read = gpioDispatch, .close = gpioClose,
+                          .fd = -1, .ref = -1, .speed = 1.0 };
@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# Program      dcf77gpiosim.sh
+# Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+#
+# Purpose      Test of the GPIO source of dcf77clock with the in-kernel
+#              gpio-sim module: a simulated chip with one line, driven by
+#              the simulator of dcf77clock through the pull attribute of
+#              the line. The clock decodes it once with the line events of
+#              the kernel and once polling the line every 1000 us, and
+#              prints the latency of the stamps and the CPU time of each.
+#
+# Usage        sudo tools/host/dcf77gpiosim.sh [minutes] [poll us] [dcf77clock]
+#
+# Remarks      Needs root, configfs and a kernel with CONFIG_GPIO_SIM.
+#              The simulated chip is removed at the end.
+
+MINUTES=${1:-5}
+POLL=${2:-1000}
+CLOCK=${3:-./dcf77clock}
+SIM=/sys/kernel/config/gpio-sim/dcf77
+
+set -e
+modprobe gpio-sim
+mountpoint -q /sys/kernel/config || mount -t configfs none /sys/kernel/config
+
+cleanup()
+{
+  [ -d $SIM ] || return 0
+  echo 0 > $SIM/live
+  rmdir $SIM/gpio-bank0/line0 $SIM/gpio-bank0 $SIM
+}
+trap cleanup EXIT
+
+mkdir -p $SIM/gpio-bank0/line0
+echo 1 > $SIM/gpio-bank0/num_lines
+echo 1 > $SIM/live
+CHIP=$(cat $SIM/gpio-bank0/chip_name)
+PULL=/sys/devices/platform/$(cat $SIM/dev_name)/$CHIP/sim_gpio0/pull
+
+echo "line events of /dev/$CHIP"
+$CLOCK --gpio /dev/$CHIP:0 --drive $PULL --minutes $MINUTES
+echo "polling /dev/$CHIP every $POLL us"
+$CLOCK --gpio /dev/$CHIP:0 --drive $PULL --minutes $MINUTES --poll $POLL
@@ -0,0 +1,161 @@
+/**
+ * Module       dcf77host.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Clock, real-time threads, decoding and latency histogram 
+ *              of the Linux host clock dcf77clock
+ */
+
+#define _GNU_SOURCE               // pthread_attr_setaffinity_np()
+
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <dcf77host.h>
+
+clockid_t host_clock = CLOCK_MONOTONIC_RAW;   // of all stamps of a run
+
+/**
+ * host_clock in ns
+ */
+uint64_t host_now(void)
+{
+  struct timespec ts;
+  clock_gettime(host_clock, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Start a thread with SCHED_FIFO at priority (0: default policy),
+ * pinned to cpu (-1: any). Without the permission for SCHED_FIFO 
+ * the thread runs with the default policy.
+ * Returns 0 or the error of pthread_create()
+ */
+int host_rt_thread(pthread_t *thread, void *(*run)(void *), void *arg, int priority, int cpu)
+{
+  pthread_attr_t     attr;
+  struct sched_param param = { .sched_priority = priority };
+  cpu_set_t          cpus;
+  int                err;
+
+  pthread_attr_init(&attr);
+  if (priority > 0)
+  {
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    pthread_attr_setschedparam(&attr, &param);
+  }
+  if (cpu >= 0)
+  {
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+  }
+  err = pthread_create(thread, &attr, run, arg);
+  if (err == EPERM && priority > 0)
+  {
+    fprintf(stderr, "no permission for SCHED_FIFO, thread runs with the default policy\n");
+    pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+    err = pthread_create(thread, &attr, run, arg);
+  }
+  pthread_attr_destroy(&attr);
+  return err;
+}
+
+/**
+ * Reset a decoder, speed is the time lapse of the source
+ */
+void host_decoder_init(host_decoder *dec, double speed)
+{
+  dcf77_init(&dec->ctx);
+  dcf77_slots_init(&dec->slots);
+  dec->start    = 0;
+  dec->speed    = speed;
+  dec->minutes  = 0;
+  dec->wrong    = 0;
+  dec->rejected = 0;
+  dec->glitches = 0;
+  dec->event    = DCF77_EV_PULSE;
+  dec->status   = HOST_UNCHECKED;
+}
+
+/**
+ * Feed an edge into the core with the framing by time slots, like
+ * DCF77Decoder. At a minute mark the completed telegram is checked
+ * and decoded into time and utc, the UTC of the mark, status 
+ * holds the result of the check.
+ * Returns 1 if a time is published
+ */
+int host_decode(host_decoder *dec, const host_edge *edge, dcf77_time *time, uint32_t *utc)
+{
+  int      synced = dec->ctx.synchronized;
+  uint32_t ms;
+  int      event;
+
+  if (dec->start == 0) dec->start = edge->ns;
+  ms    = (uint32_t)(uint64_t)((double)(edge->ns - dec->start) * dec->speed / 1e6);
+  event = dcf77_push_framed_edge(&dec->ctx, &dec->slots, ms, edge->rising);
+  dec->event = event;
+  if (event == DCF77_EV_GLITCH) dec->glitches++;
+  dec->status = HOST_UNCHECKED;
+  // the first mark only opens the minute
+  if (event != DCF77_EV_MINUTE || ! synced) return 0;
+  // slipped and not rebuilt, or bits missing and not confirmed
+  dec->status = dcf77_check_frame(dec->ctx.frame);
+  if ((dec->slots.repairs & DCF77_FIX_REJECTED) || dec->status != DCF77_OK ||
+      dcf77_decode_frame(dec->ctx.frame, time) != DCF77_OK)
+  {
+    dec->rejected++;
+    return 0;
+  }
+  *utc = dcf77_unix_time(time);
+  dec->minutes++;
+  if (edge->utc != 0 && *utc != edge->utc) dec->wrong++;
+  return 1;
+}
+
+/**
+ * Count a latency in its power of 2 bin
+ */
+void host_latency_add(host_latency *lat, uint64_t ns)
+{
+  uint8_t bin = 0;
+
+  while (bin < HOST_LATENCY_BINS - 1 && (ns >> bin) != 0) bin++;
+  lat->count[bin]++;
+  lat->total++;
+  if (ns > lat->max) lat->max = ns;
+}
+
+/**
+ * Upper bound in ns of the bin which holds quantile q,
+ * at most the maximum
+ */
+uint64_t host_latency_quantile(const host_latency *lat, double q)
+{
+  uint64_t sum = 0;
+
+  for (uint8_t bin = 0; bin < HOST_LATENCY_BINS; bin++)
+  {
+    sum += lat->count[bin];
+    if (sum > 0 && sum >= q * lat->total) return (1ULL << bin < lat->max) ? 1ULL << bin : lat->max;
+  }
+  return lat->max;
+}
+
+/**
+ * Print the quantiles and a plot ready table of the bins
+ */
+void host_latency_print(const host_latency *lat, FILE *out)
+{
+  fprintf(out, "# edges,%llu\n", (unsigned long long)lat->total);
+  if (lat->total == 0) return;
+  fprintf(out, "# p50_ns,%llu\n# p99_ns,%llu\n# p999_ns,%llu\n# max_ns,%llu\n",
+          (unsigned long long)host_latency_quantile(lat, 0.5), (unsigned long long)host_latency_quantile(lat, 0.99),
+          (unsigned long long)host_latency_quantile(lat, 0.999), (unsigned long long)lat->max);
+  fprintf(out, "latency_ns,edges\n");
+  for (uint8_t bin = 0; bin < HOST_LATENCY_BINS; bin++)
+  {
+    if (lat->count[bin] > 0) fprintf(out, "%llu,%u\n", 1ULL << bin, lat->count[bin]);
+  }
+}
@@ -0,0 +1,186 @@
+/**
+ * Header       dcf77host.h
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Declarations of the Linux host clock dcf77clock, which
+ *              takes the receiver output without an Uno in between:
+ *              the edge sources, the decoding of their edges with the
+ *              core, the queues between its threads, the latency 
+ *              histograms, the metrics of the Prometheus endpoint and
+ *              the SNTP server.
+ *
+ * Remarks      Timestamps are ns of host_clock, CLOCK_MONOTONIC_RAW which NTP
+ *              does not slew, or CLOCK_MONOTONIC for the GPIO sources, as
+ *              the kernel stamps the line events with it. The core gets 
+ *              them as ms since the start of the source.
+ *              A source is read by one thread only, read() blocks until
+ *              the next edge. A source without kernel timestamps stamps 
+ *              it as soon as it returns.
+ */
+
+#ifndef _DCF77Host_H_
+#define _DCF77Host_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <DCF77Core.h>
+
+#define HOST_LATENCY_BINS 32    // bin k counts latencies of 2^(k-1) .. 2^k ns
+#define HOST_RING_SIZE    256   // records of a queue, a power of 2
+#define HOST_CACHELINE    64
+#define HOST_UNCHECKED    0xFF  // status of an edge which completes no telegram
+#define HOST_MAX_LOCKAGE  120   // locked while the last published minute is younger [s]
+#define HOST_THREADS      4     // acquisition, decoding, publishing, logging
+#define HOST_BUCKETS      16    // of the publish latency, le 2^k us and +Inf
+#define HOST_MAX_HOLDOVER 3600  // SNTP stratum 16 after an hour without a published minute [s]
+#define HOST_SNTP_BATCH   32    // requests taken by one recvmmsg()
+
+typedef struct
+{
+  uint64_t ns;           // host_clock of the edge
+  uint64_t sent;         // when the simulator sent it, 0 from a receiver
+  uint32_t utc;          // UTC of the minute the simulator is sending, 0 from a receiver
+  uint8_t  rising;       // start of a pulse
+  uint8_t  reserved[3];
+} host_edge;
+
+typedef struct host_source host_source;
+struct host_source
+{
+  const char *name;
+  int      (*open)(host_source *src, const char *arg);
+  int      (*read)(host_source *src, host_edge *edge);   // 1 edge, 0 at the end, -1 on error
+  void     (*close)(host_source *src);
+  int      fd;
+  int      ref;          // edges of the simulator driving the line, -1 none
+  int      invert;       // receiver with inverted output
+  uint32_t poll;         // GPIO: polling period in us, 0 for line events
+  uint32_t missed;       // changes lost between two reads
+  uint32_t reads;        // read() calls of the backend
+  uint32_t batched;      // edges taken by them
+  double   speed;        // time lapse of the simulator
+  uint16_t jitter;       // simulator: pulse width jitter in ms
+  uint16_t drop;         // simulator: dropped pulses per 1000
+  uint16_t glitch;       // simulator: glitches per 1000 seconds
+  const char *drive;     // simulator: level attribute of a gpio-sim line it drives
+  void     *state;       // of the backend
+};
+
+typedef struct
+{
+  dcf77_ctx   ctx;
+  dcf77_slots slots;
+  uint64_t    start;     // ns of the first edge, core time 0
+  double      speed;     // core ms per 1e6 ns
+  uint32_t    minutes;   // telegrams published
+  uint32_t    wrong;     // published with another time than the simulator sent
+  uint32_t    rejected;  // complete but not published
+  uint32_t    glitches;
+  uint8_t     event;     // DCF77_EV_* of the last edge
+  uint8_t     status;    // DCF77_OK or DCF77_ERR_* of the telegram it completed, or HOST_UNCHECKED
+} host_decoder;
+
+typedef struct
+{
+  uint32_t count[HOST_LATENCY_BINS];
+  uint64_t total;
+  uint64_t max;
+} host_latency;
+
+typedef struct
+{
+  // producer
+  _Alignas(HOST_CACHELINE) _Atomic uint32_t head;   // records pushed, futex word
+  uint32_t         tailSeen;
+  uint32_t         overruns;    // records dropped on a full queue
+  // consumer
+  _Alignas(HOST_CACHELINE) _Atomic uint32_t tail;   // records popped
+  uint32_t         headSeen;
+  _Atomic uint32_t sleeping;    // waits on head
+  // shared, read-only after init but closed
+  _Alignas(HOST_CACHELINE) _Atomic uint32_t closed;
+  size_t           size;        // of a record
+  uint64_t         spin;        // ns the consumer busy-polls before it sleeps
+  unsigned char   *data;
+} host_ring;
+
+// counters of one thread, the gauge HOST_PUBLISHED is merged by maximum
+enum
+{
+  HOST_EDGES, HOST_GLITCHES, HOST_OVERRUNS, HOST_FRAMES_OK, HOST_FRAMES_REJECTED,
+  HOST_ERR_MINUTE, HOST_ERR_HOUR, HOST_ERR_DATE, HOST_ERR_MARKER,
+  HOST_PUBLISHED,        // host_clock ns of the last published minute
+  HOST_LATENCY_SUM,      // us
+  HOST_LATENCY,          // first of the HOST_BUCKETS
+  HOST_COUNTERS = HOST_LATENCY + HOST_BUCKETS
+};
+
+typedef struct
+{
+  _Alignas(HOST_CACHELINE) _Atomic uint64_t value[HOST_COUNTERS];
+} host_counters;
+
+typedef struct
+{
+  host_counters thread[HOST_THREADS];
+  int           listen;  // socket of the endpoint
+} host_metrics;
+
+/**
+ * Add to a counter of the calling thread, which is its only writer: 
+ * a plain load and store, no locked instruction
+ */
+static inline void host_count(host_counters *c, int counter, uint64_t n)
+{
+  atomic_store_explicit(&c->value[counter], atomic_load_explicit(&c->value[counter], memory_order_relaxed) + n,
+                        memory_order_relaxed);
+}
+
+// last published minute mark, a sequence lock with one writer
+typedef struct
+{
+  _Atomic uint32_t seq;         // odd while it is written
+  _Atomic uint64_t ns;          // host_clock of the mark
+  _Atomic uint32_t utc;         // UTC of the mark, 0 before the first
+  _Atomic uint32_t flags;       // DCF77_FLAG_* of its telegram
+} host_epoch;
+
+typedef struct
+{
+  host_epoch *epoch;
+  double      speed;            // of the source, as the decoder
+  int         fd;
+  int         batch;            // requests per recvmmsg(), up to HOST_SNTP_BATCH
+  uint64_t    requests;         // counted by the server thread only
+  uint64_t    replies;
+  uint64_t    batches;
+} host_sntp;
+
+extern host_source host_serial;
+extern host_source host_gpio;
+extern host_source host_sim;
+extern clockid_t   host_clock;
+
+uint64_t host_now(void);
+int      host_rt_thread(pthread_t *thread, void *(*run)(void *), void *arg, int priority, int cpu);
+void     host_decoder_init(host_decoder *dec, double speed);
+int      host_decode(host_decoder *dec, const host_edge *edge, dcf77_time *time, uint32_t *utc);
+void     host_latency_add(host_latency *lat, uint64_t ns);
+uint64_t host_latency_quantile(const host_latency *lat, double q);
+void     host_latency_print(const host_latency *lat, FILE *out);
+int      host_ring_init(host_ring *r, size_t size, uint64_t spin);
+void     host_ring_free(host_ring *r);
+int      host_ring_push(host_ring *r, const void *rec);
+void     host_ring_close(host_ring *r);
+int      host_ring_pop(host_ring *r, void *rec);
+void     host_count_latency(host_counters *c, uint64_t ns);
+size_t   host_metrics_format(host_metrics *m, char *buf, size_t size);
+int      host_metrics_listen(host_metrics *m, int port);
+void    *host_metrics_serve(void *metrics);
+void     host_epoch_set(host_epoch *e, uint64_t ns, uint32_t utc, uint8_t flags);
+int      host_sntp_open(host_sntp *s, int port);
+void    *host_sntp_serve(void *sntp);
+#endif
@@ -0,0 +1,177 @@
+/**
+ * Module       dcf77metrics.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Metrics of the host clock in the Prometheus text format
+ *              on a local HTTP endpoint, the counterpart of printMetrics()
+ *              of the firmware with the same names.
+ *
+ * Remarks      Every thread of the clock counts in host_counters of its
+ *              own, aligned to a cache line, as the only writer: the hot
+ *              path is a plain increment without lock or locked
+ *              instruction and no thread writes into the line of another.
+ *              A scrape adds the counters of all threads with relaxed
+ *              loads; it may see one thread a count ahead of another,
+ *              every counter on its own never goes back.
+ *              The endpoint answers every request with the metrics, on
+ *              127.0.0.1 only, one connection after the other. Lines of
+ *              the metrics end with \n as the format requires, the ones of
+ *              the HTTP header with \r\n.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <dcf77host.h>
+
+typedef struct
+{
+  char   *buf;
+  size_t  size;
+  size_t  len;
+} Text;
+
+static void append(Text *t, const char *format, ...)
+{
+  va_list args;
+  int     n;
+
+  va_start(args, format);
+  n = vsnprintf(t->buf + t->len, t->len < t->size ? t->size - t->len : 0, format, args);
+  va_end(args);
+  if (n > 0) t->len += n;
+}
+
+static uint64_t merged(host_metrics *m, int counter)
+{
+  uint64_t sum = 0;
+
+  for (int i = 0; i < HOST_THREADS; i++)
+  {
+    sum += atomic_load_explicit(&m->thread[i].value[counter], memory_order_relaxed);
+  }
+  return sum;
+}
+
+static void counter(Text *t, host_metrics *m, const char *name, int c)
+{
+  append(t, "# TYPE %s counter\n%s %llu\n", name, name, (unsigned long long)merged(m, c));
+}
+
+/**
+ * Count the latency of a publication in its bucket,
+ * bucket k holds up to 2^k us, the last one all above
+ */
+void host_count_latency(host_counters *c, uint64_t ns)
+{
+  uint64_t us     = ns / 1000;
+  int      bucket = 0;
+
+  while (bucket < HOST_BUCKETS - 1 && us > (1ULL << bucket)) bucket++;
+  host_count(c, HOST_LATENCY + bucket, 1);
+  host_count(c, HOST_LATENCY_SUM, us);
+}
+
+/**
+ * Merge the counters of all threads and write them into buf.
+ * Returns the length of the text, at least size if it was cut
+ */
+size_t host_metrics_format(host_metrics *m, char *buf, size_t size)
+{
+  Text     t         = { buf, size, 0 };
+  uint64_t published = 0, cumulative = 0, holdover;
+
+  for (int i = 0; i < HOST_THREADS; i++)
+  {
+    uint64_t ns = atomic_load_explicit(&m->thread[i].value[HOST_PUBLISHED], memory_order_relaxed);
+    if (ns > published) published = ns;
+  }
+  holdover = (published != 0) ? (host_now() - published) / 1000000000ULL : 0;
+
+  counter(&t, m, "dcf77_edges_total",           HOST_EDGES);
+  counter(&t, m, "dcf77_glitches_total",        HOST_GLITCHES);
+  counter(&t, m, "dcf77_edge_overruns_total",   HOST_OVERRUNS);
+  counter(&t, m, "dcf77_frames_ok_total",       HOST_FRAMES_OK);
+  counter(&t, m, "dcf77_frames_rejected_total", HOST_FRAMES_REJECTED);
+  append(&t, "# TYPE dcf77_check_errors_total counter\n"
+             "dcf77_check_errors_total{check=\"minute_parity\"} %llu\n"
+             "dcf77_check_errors_total{check=\"hour_parity\"} %llu\n"
+             "dcf77_check_errors_total{check=\"date_parity\"} %llu\n"
+             "dcf77_check_errors_total{check=\"marker\"} %llu\n",
+         (unsigned long long)merged(m, HOST_ERR_MINUTE), (unsigned long long)merged(m, HOST_ERR_HOUR),
+         (unsigned long long)merged(m, HOST_ERR_DATE),   (unsigned long long)merged(m, HOST_ERR_MARKER));
+  append(&t, "# TYPE dcf77_locked gauge\ndcf77_locked %d\n", published != 0 && holdover < HOST_MAX_LOCKAGE);
+  append(&t, "# TYPE dcf77_holdover_seconds gauge\ndcf77_holdover_seconds %llu\n", (unsigned long long)holdover);
+
+  append(&t, "# TYPE dcf77_edge_to_publish_latency_microseconds histogram\n");
+  for (int bucket = 0; bucket < HOST_BUCKETS; bucket++)
+  {
+    cumulative += merged(m, HOST_LATENCY + bucket);
+    if (bucket < HOST_BUCKETS - 1)
+    {
+      append(&t, "dcf77_edge_to_publish_latency_microseconds_bucket{le=\"%llu\"} %llu\n",
+             1ULL << bucket, (unsigned long long)cumulative);
+    }
+    else
+    {
+      append(&t, "dcf77_edge_to_publish_latency_microseconds_bucket{le=\"+Inf\"} %llu\n", (unsigned long long)cumulative);
+    }
+  }
+  append(&t, "dcf77_edge_to_publish_latency_microseconds_sum %llu\n"
+             "dcf77_edge_to_publish_latency_microseconds_count %llu\n",
+         (unsigned long long)merged(m, HOST_LATENCY_SUM), (unsigned long long)cumulative);
+  return t.len;
+}
+
+/**
+ * Open the endpoint on 127.0.0.1:port.
+ * Returns 0 or -1 with errno
+ */
+int host_metrics_listen(host_metrics *m, int port)
+{
+  struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port),
+                              .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  int on = 1;
+
+  m->listen = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (m->listen < 0) return -1;
+  setsockopt(m->listen, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  if (bind(m->listen, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(m->listen, 8) < 0)
+  {
+    close(m->listen);
+    m->listen = -1;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Thread of the endpoint: answer every request with the metrics
+ */
+void *host_metrics_serve(void *metrics)
+{
+  host_metrics *m = metrics;
+  char          request[1024], body[4096], head[160];
+  int           fd, n;
+  size_t        len;
+
+  while ((fd = accept4(m->listen, NULL, NULL, SOCK_CLOEXEC)) >= 0)
+  {
+    // the request is not looked at, one read takes what a scraper sends
+    if (read(fd, request, sizeof(request)) > 0)
+    {
+      len = host_metrics_format(m, body, sizeof(body));
+      if (len >= sizeof(body)) len = sizeof(body) - 1;
+      n   = snprintf(head, sizeof(head), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                         "Content-Length: %zu\r\nConnection: close\r\n\r\n", len);
+      if (write(fd, head, n) == n && write(fd, body, len) < 0) perror("metrics");
+    }
+    close(fd);
+  }
+  return NULL;
+}
@@ -0,0 +1,169 @@
+/**
+ * Program      dcf77metricsbench.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Cost of the metrics of the host clock (dcf77metrics.c):
+ *              ns per increment on the hot path with the counters of
+ *              each thread on cache lines of their own, against one
+ *              shared atomic counter, one counter under a mutex and the
+ *              counters of the threads side by side in one line; the
+ *              per-thread counters once more while a thread scrapes them
+ *              without pause. Then the cost of a scrape, the merge and
+ *              format alone and the whole HTTP request over loopback.
+ *
+ * Build        cc -O2 -pthread -Ilib/DCF77Core -Itools/host tools/host/dcf77metricsbench.c \
+ *                 tools/host/dcf77metrics.c tools/host/dcf77host.c lib/DCF77Core/DCF77Core.c \
+ *                 -o dcf77metricsbench
+ *
+ * Usage        ./dcf77metricsbench [threads] [increments] [port]   default 4 10000000 9177
+ *
+ * Remarks      The threads are not pinned; with fewer cores than threads
+ *              they take turns and the contention of the shared variants
+ *              shrinks to what a switch of threads leaves in the caches.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <dcf77host.h>
+
+#define RUNS 5      // each variant is timed this often, the best run counts
+
+typedef enum { PADDED, SHARED_ATOMIC, MUTEX, UNPADDED } Variant;
+
+static const char *names[] = { "per-thread padded", "shared atomic", "shared mutex", "per-thread unpadded" };
+
+static host_metrics      metrics;
+static _Atomic uint64_t  shared;
+static uint64_t          locked;
+static pthread_mutex_t   mutex = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic uint64_t  adjacent[HOST_THREADS];
+static _Atomic int       scraping;
+static uint64_t          increments;
+static Variant           variant;
+
+static void *count(void *arg)
+{
+  int index = (int)(uintptr_t)arg;
+
+  for (uint64_t i = 0; i < increments; i++)
+  {
+    switch (variant)
+    {
+      case PADDED:        host_count(&metrics.thread[index], HOST_EDGES, 1); break;
+      case SHARED_ATOMIC: atomic_fetch_add_explicit(&shared, 1, memory_order_relaxed); break;
+      case MUTEX:         pthread_mutex_lock(&mutex); locked++; pthread_mutex_unlock(&mutex); break;
+      case UNPADDED:      atomic_store_explicit(&adjacent[index], atomic_load_explicit(&adjacent[index],
+                                            memory_order_relaxed) + 1, memory_order_relaxed); break;
+    }
+  }
+  return NULL;
+}
+
+static void *scrape(void *arg)
+{
+  static char buf[4096];
+  uint64_t   *scrapes = arg;
+
+  while (atomic_load_explicit(&scraping, memory_order_relaxed))
+  {
+    host_metrics_format(&metrics, buf, sizeof(buf));
+    (*scrapes)++;
+  }
+  return NULL;
+}
+
+/**
+ * Best of RUNS of all threads incrementing, in ns per increment,
+ * with a scraping thread beside them if scrapes is not NULL
+ */
+static double timeVariant(Variant v, int nbrThreads, uint64_t *scrapes)
+{
+  double    best = 1e30;
+  pthread_t thread[HOST_THREADS], scraper;
+
+  variant = v;
+  for (int run = 0; run < RUNS; run++)
+  {
+    uint64_t start = host_now();
+
+    if (scrapes != NULL)
+    {
+      *scrapes = 0;
+      atomic_store(&scraping, 1);
+      pthread_create(&scraper, NULL, scrape, scrapes);
+    }
+    for (int i = 0; i < nbrThreads; i++) pthread_create(&thread[i], NULL, count, (void *)(uintptr_t)i);
+    for (int i = 0; i < nbrThreads; i++) pthread_join(thread[i], NULL);
+    double ns = (double)(host_now() - start) / ((double)increments * nbrThreads);
+    if (scrapes != NULL)
+    {
+      atomic_store(&scraping, 0);
+      pthread_join(scraper, NULL);
+    }
+    if (ns < best) best = ns;
+  }
+  return best;
+}
+
+/**
+ * One scrape over loopback as a scraper does it,
+ * returns the bytes of the answer
+ */
+static ssize_t request(int port, char *buf, size_t size)
+{
+  struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port),
+                              .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  static const char get[] = "GET /metrics HTTP/1.0\r\n\r\n";
+  ssize_t total = 0, n;
+  int     fd    = socket(AF_INET, SOCK_STREAM, 0);
+
+  if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || write(fd, get, sizeof(get) - 1) < 0)
+  {
+    if (fd >= 0) close(fd);
+    return -1;
+  }
+  while ((n = read(fd, buf + total, size - total)) > 0) total += n;
+  close(fd);
+  return total;
+}
+
+int main(int argc, char **argv)
+{
+  int       nbrThreads = (argc > 1) ? atoi(argv[1]) : 4;
+  int       port       = (argc > 3) ? atoi(argv[3]) : 9177;
+  uint64_t  scrapes, start;
+  static char buf[8192];
+  size_t    len = 0;
+  ssize_t   answer = 0;
+  pthread_t endpoint;
+  int       n;
+
+  increments = (argc > 2) ? strtoull(argv[2], NULL, 0) : 10000000;
+  if (nbrThreads < 1 || nbrThreads > HOST_THREADS) nbrThreads = HOST_THREADS;
+  printf("# threads,%d\n# increments,%llu\n# cpus,%ld\n", nbrThreads, (unsigned long long)increments,
+         sysconf(_SC_NPROCESSORS_ONLN));
+  printf("variant,ns_per_increment\n");
+  for (Variant v = PADDED; v <= UNPADDED; v++) printf("%s,%.2f\n", names[v], timeVariant(v, nbrThreads, NULL));
+  printf("%s while scraping,%.2f\n", names[PADDED], timeVariant(PADDED, nbrThreads, &scrapes));
+  printf("# scrapes during the last run,%llu\n", (unsigned long long)scrapes);
+
+  start = host_now();
+  for (n = 0; n < 100000; n++) len = host_metrics_format(&metrics, buf, sizeof(buf));
+  printf("# format_ns,%.0f\n# format_bytes,%zu\n", (double)(host_now() - start) / n, len);
+
+  if (host_metrics_listen(&metrics, port) < 0 || pthread_create(&endpoint, NULL, host_metrics_serve, &metrics) != 0)
+  {
+    perror("metrics");
+    return 1;
+  }
+  start = host_now();
+  for (n = 0; n < 2000 && (answer = request(port, buf, sizeof(buf))) > 0; n++);
+  printf("# http_scrape_us,%.1f\n# http_bytes,%zd\n", (double)(host_now() - start) / n / 1000, answer);
+  return 0;
+}
@@ -0,0 +1,145 @@
+/**
+ * Module       dcf77ring.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Lock-free queue between two threads of the host clock,
+ *              one producer and one consumer (SPSC), for records of a
+ *              fixed size.
+ *
+ * Remarks      head is written by the producer only, tail by the consumer
+ *              only, each on its own cache line with the copy of the other
+ *              index it has seen last, so that they share a line only when
+ *              the queue looks full or empty.
+ *              The producer never blocks: a record which finds the queue
+ *              full is dropped and counted, the real-time acquisition must
+ *              not wait for a slower thread.
+ *              The consumer busy-polls the head for up to spin ns, then
+ *              sleeps on it with a futex. The producer wakes it only if it
+ *              announced that it sleeps, so that a busy consumer costs the
+ *              producer no system call. spin 0 always sleeps at once, a
+ *              large spin keeps the consumer polling, which needs a core
+ *              of its own.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <dcf77host.h>
+
+static void futexWait(_Atomic uint32_t *word, uint32_t value)
+{
+  syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void futexWake(_Atomic uint32_t *word)
+{
+  syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+static inline void relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ volatile("yield");
+#endif
+}
+
+/**
+ * Allocate a queue of HOST_RING_SIZE records of size bytes.
+ * Returns 0 or -1 without memory
+ */
+int host_ring_init(host_ring *r, size_t size, uint64_t spin)
+{
+  memset(r, 0, sizeof(*r));
+  r->size = size;
+  r->spin = spin;
+  r->data = calloc(HOST_RING_SIZE, size);
+  return (r->data != NULL) ? 0 : -1;
+}
+
+void host_ring_free(host_ring *r)
+{
+  free(r->data);
+  r->data = NULL;
+}
+
+/**
+ * Producer: append a record.
+ * Returns 1, or 0 if the queue is full and the record dropped
+ */
+int host_ring_push(host_ring *r, const void *rec)
+{
+  uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+  if (head - r->tailSeen == HOST_RING_SIZE)
+  {
+    r->tailSeen = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head - r->tailSeen == HOST_RING_SIZE)
+    {
+      r->overruns++;
+      return 0;
+    }
+  }
+  memcpy(r->data + (size_t)(head % HOST_RING_SIZE) * r->size, rec, r->size);
+  // sequentially consistent against sleeping, see host_ring_pop()
+  atomic_store(&r->head, head + 1);
+  if (atomic_load(&r->sleeping)) futexWake(&r->head);
+  return 1;
+}
+
+/**
+ * Producer: no more records, wake the consumer
+ */
+void host_ring_close(host_ring *r)
+{
+  atomic_store(&r->closed, 1);
+  futexWake(&r->head);
+}
+
+/**
+ * Consumer: take the next record, wait for it if there is none.
+ * Returns 1, or 0 when the queue is closed and empty
+ */
+int host_ring_pop(host_ring *r, void *rec)
+{
+  uint32_t tail  = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  uint64_t until = 0;
+
+  while (r->headSeen == tail)
+  {
+    r->headSeen = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (r->headSeen != tail) break;
+    if (atomic_load(&r->closed))
+    {
+      // records pushed before the close
+      r->headSeen = atomic_load_explicit(&r->head, memory_order_acquire);
+      if (r->headSeen != tail) break;
+      return 0;
+    }
+    if (r->spin != 0)
+    {
+      if (until == 0) until = host_now() + r->spin;
+      if (host_now() < until)
+      {
+        relax();
+        continue;
+      }
+    }
+    // announce the sleep before the last look at head: a push after it sees
+    // sleeping set and wakes, a push before it is seen and not slept on
+    atomic_store(&r->sleeping, 1);
+    if (atomic_load(&r->head) == tail && ! atomic_load(&r->closed)) futexWait(&r->head, tail);
+    atomic_store(&r->sleeping, 0);
+    until = 0;
+  }
+  memcpy(rec, r->data + (size_t)(tail % HOST_RING_SIZE) * r->size, r->size);
+  atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+  return 1;
+}
@@ -0,0 +1,122 @@
+/**
+ * Module       dcf77serial.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Edge source for a receiver on a modem status line of a
+ *              serial port, DCD, CTS, DSR or RI, like the gameport of the
+ *              original decoder of 1999 but without an Uno in between.
+ *
+ * Remarks      TIOCMIWAIT sleeps in the kernel until the line changes, the
+ *              edge is stamped as soon as it returns, then TIOCMGET reads
+ *              the level. A pulse shorter than this round trip is seen as
+ *              no change; the interrupt counters of TIOCGICOUNT, where the
+ *              driver has them, tell how many changes were lost. 
+ *              The open argument is the device with an optional line,
+ *              e.g. /dev/ttyS0:cts, the default is DCD.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#include <dcf77host.h>
+
+typedef struct
+{
+  int      mask;         // TIOCM_* of the line
+  int      level;        // last level, after the polarity
+  int      counted;      // the driver has interrupt counters
+  uint32_t changes;      // counter of the line
+} Serial;
+
+static const struct { const char *name; int mask; } lines[] =
+{
+  { "dcd", TIOCM_CD }, { "cts", TIOCM_CTS }, { "dsr", TIOCM_DSR }, { "ri", TIOCM_RI }
+};
+
+/**
+ * Interrupt counter of the line, 
+ * returns 0 if the driver has none
+ */
+static int countChanges(int fd, int mask, uint32_t *changes)
+{
+  struct serial_icounter_struct count;
+
+  if (ioctl(fd, TIOCGICOUNT, &count) < 0) return 0;
+  *changes = (mask == TIOCM_CD) ? count.dcd : (mask == TIOCM_CTS) ? count.cts : 
+             (mask == TIOCM_DSR) ? count.dsr : count.rng;
+  return 1;
+}
+
+static int serialOpen(host_source *src, const char *arg)
+{
+  char   *path = strdup(arg);
+  char   *line = strrchr(path, ':');
+  Serial *s    = calloc(1, sizeof(Serial));
+  int     bits;
+
+  s->mask = TIOCM_CD;
+  if (line != NULL)
+  {
+    *line++ = '\0';
+    s->mask = 0;
+    for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++)
+    {
+      if (strcmp(line, lines[i].name) == 0) s->mask = lines[i].mask;
+    }
+  }
+  src->fd = (s->mask != 0) ? open(path, O_RDWR | O_NOCTTY | O_NONBLOCK) : -1;
+  free(path);
+  if (src->fd < 0 || ioctl(src->fd, TIOCMGET, &bits) < 0)
+  {
+    if (s->mask == 0) errno = EINVAL;
+    free(s);
+    return -1;
+  }
+  fcntl(src->fd, F_SETFL, fcntl(src->fd, F_GETFL) & ~O_NONBLOCK);
+  s->level   = ((bits & s->mask) != 0) ^ src->invert;
+  s->counted = countChanges(src->fd, s->mask, &s->changes);
+  src->state = s;
+  return 0;
+}
+
+static int serialRead(host_source *src, host_edge *edge)
+{
+  Serial  *s = src->state;
+  uint32_t changes;
+  int      bits, level;
+
+  for (;;)
+  {
+    if (ioctl(src->fd, TIOCMIWAIT, s->mask) < 0) return -1;
+    edge->ns = host_now();
+    if (ioctl(src->fd, TIOCMGET, &bits) < 0) return -1;
+    level = ((bits & s->mask) != 0) ^ src->invert;
+    if (s->counted && countChanges(src->fd, s->mask, &changes))
+    {
+      // changes beyond the one which is seen were too fast for the round trip
+      src->missed += changes - s->changes - (level != s->level);
+      s->changes   = changes;
+    }
+    if (level == s->level) continue;
+    s->level     = level;
+    edge->rising = level;
+    edge->sent   = 0;
+    edge->utc    = 0;
+    return 1;
+  }
+}
+
+static void serialClose(host_source *src)
+{
+  close(src->fd);
+  free(src->state);
+}
+
+host_source host_serial = { .name = "serial", .open = serialOpen, .read = serialRead, .close = serialClose, 
+                            .fd = -1, .ref = -1, .speed = 1.0 };
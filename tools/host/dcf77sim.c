@@ -0,0 +1,136 @@
+/**
+ * Module       dcf77sim.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Simulated edge source, the signal of the current UTC with
+ *              jitter, dropped pulses and glitches, for testing the host
+ *              clock without a receiver.
+ *
+ * Remarks      A thread sends every edge at its time through a pipe, 
+ *              stamped just before the write. The reader stamps it again
+ *              when read() returns, the difference is the latency of the
+ *              wake up of the acquisition thread. A speed above 1 runs the
+ *              signal faster, which scales the latency up for the core.
+ *              The thread stands for the receiver, it runs at the highest
+ *              SCHED_FIFO priority so that a load on the host does not 
+ *              shift the edges it sends.
+ *              With drive set the simulator also writes the level of each
+ *              edge into the pull attribute of a gpio-sim line, after it
+ *              has sent the edge through the pipe. The GPIO source reads 
+ *              the line and takes the pipe as reference for the latency.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <dcf77host.h>
+
+typedef struct
+{
+  host_source *src;
+  int          pipe[2];
+  int          drive;        // pull attribute of a gpio-sim line, -1 none
+  pthread_t    thread;
+  unsigned int seed;
+} Sim;
+
+/**
+ * Wait until ms of the signal have passed since t0, on CLOCK_MONOTONIC
+ */
+static void waitFor(const struct timespec *t0, uint64_t ms, double speed)
+{
+  uint64_t        ns = (uint64_t)(ms * 1e6 / speed);
+  struct timespec at = { t0->tv_sec + (time_t)(ns / 1000000000ULL), t0->tv_nsec + (long)(ns % 1000000000ULL) };
+
+  if (at.tv_nsec >= 1000000000L) { at.tv_sec++; at.tv_nsec -= 1000000000L; }
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL) == EINTR);
+}
+
+/**
+ * Send the edges of one second after another
+ */
+static void *simRun(void *arg)
+{
+  Sim            *sim  = arg;
+  host_source    *src  = sim->src;
+  uint32_t        utc  = (uint32_t)time(NULL) + 1;
+  struct timespec t0;
+  dcf77_time      minute;
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (uint64_t s = 0; ; s++, utc++)
+  {
+    uint8_t   second = utc % 60;
+    uint64_t  frame, at[4];      // ms of the edges since t0
+    uint8_t   n = 0;
+    host_edge edge = { .utc = utc - second };
+
+    // the telegram sent in a minute announces the next one
+    dcf77_from_unix(utc - second + 60, 0, &minute);
+    frame = dcf77_encode_frame(&minute);
+    if (second < DCF77_FRAMEBITS && (uint32_t)rand_r(&sim->seed) % 1000 >= src->drop)
+    {
+      at[n++] = 1000 * s;
+      at[n++] = 1000 * s + (((frame >> second) & 1) ? 200 : 100) - src->jitter + 
+                (uint32_t)rand_r(&sim->seed) % (2 * src->jitter + 1);
+    }
+    if ((uint32_t)rand_r(&sim->seed) % 1000 < src->glitch)
+    {
+      uint64_t glitch = 1000 * s + 300 + rand_r(&sim->seed) % 600;
+      at[n++] = glitch;
+      at[n++] = glitch + 8;
+    }
+    for (uint8_t i = 0; i < n; i++)
+    {
+      waitFor(&t0, at[i], src->speed);
+      edge.rising = (i % 2 == 0);
+      edge.sent   = host_now();
+      if (write(sim->pipe[1], &edge, sizeof(edge)) != sizeof(edge)) return NULL;
+      if (sim->drive >= 0 && pwrite(sim->drive, edge.rising ? "pull-up" : "pull-down", 
+                                    edge.rising ? 7 : 9, 0) < 0) return NULL;
+    }
+  }
+}
+
+static int simOpen(host_source *src, const char *arg)
+{
+  Sim *sim = calloc(1, sizeof(Sim));
+
+  sim->src   = src;
+  sim->seed  = (arg != NULL) ? (unsigned int)strtoul(arg, NULL, 0) : 1;
+  sim->drive = (src->drive != NULL) ? open(src->drive, O_WRONLY) : -1;
+  if ((src->drive != NULL && sim->drive < 0) || pipe(sim->pipe) < 0) { free(sim); return -1; }
+  src->fd    = sim->pipe[0];
+  src->state = sim;
+  // a closed reader ends the sender with EPIPE instead of SIGPIPE
+  signal(SIGPIPE, SIG_IGN);
+  return host_rt_thread(&sim->thread, simRun, sim, sched_get_priority_max(SCHED_FIFO), -1) == 0 ? 0 : -1;
+}
+
+static int simRead(host_source *src, host_edge *edge)
+{
+  ssize_t n = read(src->fd, edge, sizeof(host_edge));
+
+  edge->ns = host_now();
+  return (n == sizeof(host_edge)) ? 1 : (n == 0) ? 0 : -1;
+}
+
+static void simClose(host_source *src)
+{
+  Sim *sim = src->state;
+
+  close(sim->pipe[0]);
+  pthread_join(sim->thread, NULL);
+  close(sim->pipe[1]);
+  if (sim->drive >= 0) close(sim->drive);
+  free(sim);
+}
+
+host_source host_sim = { .name = "sim", .open = simOpen, .read = simRead, .close = simClose, 
+                         .fd = -1, .ref = -1, .speed = 1.0, .jitter = 10 };
@@ -0,0 +1,183 @@
+/**
+ * Module       dcf77sntp.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      SNTP server of the host clock (RFC 4330): answers client
+ *              requests, mode 3, with the decoded DCF77 time, mode 4, on
+ *              UDP at 127.0.0.1, for the local services of the host.
+ *
+ * Remarks      The publishing thread sets the epoch, the host_clock stamp
+ *              of the last published minute mark with its UTC and flags,
+ *              under a sequence lock; the server reads it without lock
+ *              and extrapolates the time from it with host_clock.
+ *              recvmmsg() takes up to batch requests per call, all of
+ *              them get the receive time stamped when it returns, and
+ *              sendmmsg() sends all replies with one call. The fields of
+ *              the reply which do not depend on the request are set once
+ *              per batch in a template: leap indicator, stratum, root
+ *              dispersion, reference id and time and the receive time. Leap and stratum follow
+ *              showNtpTime() of the firmware: leap 1 with announcement A2,
+ *              stratum 1 for an hour after the last published minute, then
+ *              16; leap 3 and no time before the first one. The root
+ *              dispersion grows with the holdover by 15 ppm (RFC 5905).
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <dcf77host.h>
+
+#define NTP_SIZE      48            // packet without extensions and MAC
+#define NTP_OFFSET    2208988800UL  // seconds from 1900 to 1970
+#define NTP_PRECISION -20           // log2 of the resolution of host_clock reads, about 1 us
+#define NTP_PHI       15            // frequency tolerance [ppm]
+
+/**
+ * Publisher: a new minute mark
+ */
+void host_epoch_set(host_epoch *e, uint64_t ns, uint32_t utc, uint8_t flags)
+{
+  atomic_fetch_add_explicit(&e->seq, 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&e->ns,    ns,    memory_order_relaxed);
+  atomic_store_explicit(&e->utc,   utc,   memory_order_relaxed);
+  atomic_store_explicit(&e->flags, flags, memory_order_relaxed);
+  atomic_fetch_add_explicit(&e->seq, 1, memory_order_release);
+}
+
+/**
+ * Reader: a consistent copy of the epoch
+ */
+static void getEpoch(host_epoch *e, uint64_t *ns, uint32_t *utc, uint8_t *flags)
+{
+  uint32_t seq;
+
+  do
+  {
+    while ((seq = atomic_load_explicit(&e->seq, memory_order_acquire)) & 1);
+    *ns    = atomic_load_explicit(&e->ns,    memory_order_relaxed);
+    *utc   = atomic_load_explicit(&e->utc,   memory_order_relaxed);
+    *flags = atomic_load_explicit(&e->flags, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+  } while (atomic_load_explicit(&e->seq, memory_order_relaxed) != seq);
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+  p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+/**
+ * NTP timestamp of host_clock now from the epoch, 0 without one
+ */
+static void timestamp(uint8_t *p, const host_sntp *s, uint64_t now, uint64_t ns, uint32_t utc)
+{
+  uint64_t elapsed, seconds;
+
+  if (utc == 0)
+  {
+    memset(p, 0, 8);
+    return;
+  }
+  elapsed = (uint64_t)((double)(now - ns) * s->speed);
+  seconds = utc + NTP_OFFSET + elapsed / 1000000000ULL;
+  put32(p,     (uint32_t)seconds);
+  put32(p + 4, (uint32_t)(((elapsed % 1000000000ULL) << 32) / 1000000000ULL));
+}
+
+/**
+ * Open the server on 127.0.0.1:port.
+ * Returns 0 or -1 with errno
+ */
+int host_sntp_open(host_sntp *s, int port)
+{
+  struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port),
+                              .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+
+  s->fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (s->fd < 0) return -1;
+  if (bind(s->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+  {
+    close(s->fd);
+    s->fd = -1;
+    return -1;
+  }
+  if (s->batch < 1 || s->batch > HOST_SNTP_BATCH) s->batch = HOST_SNTP_BATCH;
+  return 0;
+}
+
+/**
+ * Thread of the server: answer the requests in batches
+ */
+void *host_sntp_serve(void *sntp)
+{
+  host_sntp         *s = sntp;
+  static uint8_t     request[HOST_SNTP_BATCH][NTP_SIZE + 64], reply[HOST_SNTP_BATCH][NTP_SIZE];
+  struct sockaddr_in peer[HOST_SNTP_BATCH];
+  struct iovec       in[HOST_SNTP_BATCH], out[HOST_SNTP_BATCH];
+  struct mmsghdr     rx[HOST_SNTP_BATCH], tx[HOST_SNTP_BATCH];
+  uint8_t            template[NTP_SIZE];
+  uint64_t           now, ns, holdover;
+  uint32_t           utc, dispersion;
+  uint8_t            flags, leap, stratum;
+  int                n, k;
+
+  for (int i = 0; i < HOST_SNTP_BATCH; i++)
+  {
+    in[i]  = (struct iovec){ request[i], sizeof(request[i]) };
+    out[i] = (struct iovec){ reply[i],   NTP_SIZE };
+    rx[i]  = (struct mmsghdr){ .msg_hdr = { .msg_name = &peer[i], .msg_iov = &in[i],  .msg_iovlen = 1 } };
+    tx[i]  = (struct mmsghdr){ .msg_hdr = { .msg_iov = &out[i], .msg_iovlen = 1 } };
+  }
+  for (;;)
+  {
+    for (int i = 0; i < s->batch; i++) rx[i].msg_hdr.msg_namelen = sizeof(peer[i]);
+    n = recvmmsg(s->fd, rx, s->batch, MSG_WAITFORONE, NULL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) break;
+    now = host_now();
+
+    // the fields of this batch
+    getEpoch(s->epoch, &ns, &utc, &flags);
+    holdover   = (utc != 0) ? (uint64_t)((double)(now - ns) * s->speed) / 1000000000ULL : 0;
+    leap       = (utc == 0) ? 3 : (flags & DCF77_FLAG_LEAP) ? 1 : 0;
+    stratum    = (utc != 0 && holdover < HOST_MAX_HOLDOVER) ? 1 : 16;
+    // 1 ms of the decoding plus the drift since the minute mark, 16.16 fixed point seconds
+    dispersion = (uint32_t)(65536 / 1000 + holdover * NTP_PHI * 65536 / 1000000);
+    memset(template, 0, sizeof(template));
+    template[1]  = stratum;
+    template[3]  = (uint8_t)NTP_PRECISION;
+    put32(template + 8, dispersion);
+    memcpy(template + 12, "DCF", 4);
+    timestamp(template + 16, s, ns, ns, utc);    // reference
+    timestamp(template + 32, s, now, ns, utc);   // receive
+
+    k = 0;
+    for (int i = 0; i < n; i++)
+    {
+      const uint8_t *q = request[i];
+      uint8_t       *r = reply[k];
+      uint8_t        version = (q[0] >> 3) & 7;
+
+      s->requests++;
+      if (rx[i].msg_len < NTP_SIZE || (q[0] & 7) != 3 || version < 1 || version > 4) continue;
+      memcpy(r, template, NTP_SIZE);
+      r[0] = (uint8_t)(leap << 6 | version << 3 | 4);
+      r[2] = q[2];                              // poll
+      memcpy(r + 24, q + 40, 8);                   // originate = transmit of the client
+      timestamp(r + 40, s, host_now(), ns, utc);   // transmit
+      tx[k].msg_hdr.msg_name    = &peer[i];
+      tx[k].msg_hdr.msg_namelen = rx[i].msg_hdr.msg_namelen;
+      k++;
+    }
+    s->batches++;
+    if (k > 0 && (n = sendmmsg(s->fd, tx, k, 0)) > 0) s->replies += n;
+  }
+  perror("sntp");
+  return NULL;
+}
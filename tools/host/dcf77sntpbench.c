@@ -0,0 +1,141 @@
+/**
+ * Program      dcf77sntpbench.c
+ * Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+ *
+ * Purpose      Load generator for the SNTP server of the host clock:
+ *              keeps window requests in flight on loopback, sent and
+ *              received with sendmmsg() and recvmmsg(), and prints the
+ *              queries per second, the percentiles of the response time
+ *              and the leap indicator, stratum and time of the last reply.
+ *
+ * Build        cc -O2 tools/host/dcf77sntpbench.c -o dcf77sntpbench
+ *
+ * Usage        ./dcf77sntpbench [port] [requests] [window]   default 12300 200000 64
+ *
+ * Remarks      The transmit timestamp of a request carries its index, the
+ *              server returns it as originate time, which identifies the
+ *              reply. A request without reply after 1 s counts as lost.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define NTP_SIZE   48
+#define NTP_OFFSET 2208988800UL  // seconds from 1900 to 1970
+#define BATCH      32           // requests per sendmmsg() and replies per recvmmsg()
+
+static uint64_t now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int byValue(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+int main(int argc, char **argv)
+{
+  int       port     = (argc > 1) ? atoi(argv[1]) : 12300;
+  uint32_t  total    = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : 200000;
+  uint32_t  window   = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 0) : 64;
+  uint64_t *sent     = calloc(total, sizeof(uint64_t));
+  uint64_t *latency  = calloc(total, sizeof(uint64_t));
+  struct sockaddr_in server = { .sin_family = AF_INET, .sin_port = htons(port),
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  struct timeval timeout = { 1, 0 };
+  static uint8_t request[BATCH][NTP_SIZE], reply[BATCH][NTP_SIZE + 64], last[NTP_SIZE];
+  struct iovec   out[BATCH], in[BATCH];
+  struct mmsghdr tx[BATCH], rx[BATCH];
+  uint32_t  next = 0, answered = 0, wrong = 0, inFlight = 0;
+  uint64_t  start, elapsed;
+  int       fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+  if (fd < 0 || sent == NULL || latency == NULL || window < 1 ||
+      connect(fd, (struct sockaddr *)&server, sizeof(server)) < 0)
+  {
+    perror("dcf77sntpbench");
+    return 1;
+  }
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  for (int i = 0; i < BATCH; i++)
+  {
+    memset(request[i], 0, NTP_SIZE);
+    request[i][0] = 4 << 3 | 3;          // version 4, client
+    request[i][2] = 6;                   // poll 64 s
+    out[i] = (struct iovec){ request[i], NTP_SIZE };
+    in[i]  = (struct iovec){ reply[i], sizeof(reply[i]) };
+    tx[i]  = (struct mmsghdr){ .msg_hdr = { .msg_iov = &out[i], .msg_iovlen = 1 } };
+    rx[i]  = (struct mmsghdr){ .msg_hdr = { .msg_iov = &in[i],  .msg_iovlen = 1 } };
+  }
+
+  start = now();
+  while (answered + wrong < next || next < total)
+  {
+    int n = 0, r;
+
+    // fill the window up
+    while (next + n < total && inFlight + n < window && n < BATCH)
+    {
+      uint32_t id = next + n;
+      memset(request[n] + 40, 0, 8);
+      request[n][44] = id >> 24; request[n][45] = id >> 16; request[n][46] = id >> 8; request[n][47] = id;
+      n++;
+    }
+    if (n > 0)
+    {
+      uint64_t t = now();
+      r = sendmmsg(fd, tx, n, 0);
+      for (int i = 0; i < r; i++) sent[next + i] = t;
+      if (r > 0) { next += r; inFlight += r; }
+    }
+    r = recvmmsg(fd, rx, BATCH, MSG_WAITFORONE, NULL);
+    if (r <= 0) break;                   // the rest is lost
+    uint64_t t = now();
+    for (int i = 0; i < r; i++)
+    {
+      uint32_t id = get32(reply[i] + 28);
+
+      inFlight--;
+      if (rx[i].msg_len < NTP_SIZE || (reply[i][0] & 7) != 4 || get32(reply[i] + 24) != 0 || id >= next)
+      {
+        wrong++;
+        continue;
+      }
+      latency[answered++] = t - sent[id];
+      memcpy(last, reply[i], NTP_SIZE);
+    }
+  }
+  elapsed = now() - start;
+
+  qsort(latency, answered, sizeof(uint64_t), byValue);
+  printf("# window,%u\n# requests,%u\n# answered,%u\n# wrong,%u\n# lost,%u\n", window, next, answered, wrong,
+         next - answered - wrong);
+  if (answered == 0) return 1;
+  printf("# qps,%.0f\n", answered / (elapsed / 1e9));
+  printf("# p50_us,%.1f\n# p99_us,%.1f\n# p999_us,%.1f\n# max_us,%.1f\n", latency[answered / 2] / 1e3,
+         latency[(uint64_t)answered * 99 / 100] / 1e3, latency[(uint64_t)answered * 999 / 1000] / 1e3,
+         latency[answered - 1] / 1e3);
+  time_t utc = (time_t)(get32(last + 40) - NTP_OFFSET);
+  char   text[32] = "none";
+  if (get32(last + 40) != 0) strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S UTC", gmtime(&utc));
+  printf("# leap,%u\n# stratum,%u\n# transmit,%s\n", last[0] >> 6, last[1], text);
+  return 0;
+}
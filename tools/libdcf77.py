@@ -0,0 +1,202 @@
+"""
+Module       libdcf77.py
+Author       2021-08-13 Charles Geiser (https://www.dodeka.ch)
+
+Purpose      ctypes binding of the decoding core lib/DCF77Core, so the host
+             tools decode with the same code as the clock instead of a
+             copy of it. The core is compiled once per set of thresholds
+             into a shared library in the cache directory and loaded from
+             there.
+
+Usage        from libdcf77 import Core, Tuning, Edges
+             core = Core()                               # header defaults
+             core = Core((100, 200, 45, 1800, 1900))     # P0 P1 JITTER MIN MAX
+             marks = core.decode(edges)                  # [(markTime, unix)]
+             tuning = Tuning()                           # thresholds set at run time
+             tuning.set_thresholds((100, 200, 45, 1800, 1900))
+             marks = tuning.decode(Edges(edges))         # prepared once, decoded often
+             ctx, slots = core.context(), core.slots()   # one stream framed like the clock
+             event = core.dcf77_push_framed_edge(ctx, slots, t_ms, rising)
+
+Remarks      Needs a C compiler, $CC or cc. The libraries are kept in
+             $DCF77_CACHE, default ~/.cache/dcf77, and rebuilt when the
+             core sources are newer. The thresholds are macros of the
+             core, so every set of thresholds is a library of its own,
+             except for Tuning, the core built with DCF77_TUNING whose
+             thresholds are variables, for the threshold search only.
+             The structures below must match DCF77Core.h.
+"""
+
+import ctypes
+import os
+import subprocess
+import sys
+
+CORE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "lib", "DCF77Core")
+SOURCES = ("DCF77Core.c",)
+HEADERS = ("DCF77Core.h", "DCF77Thresholds.h")
+NAMES = ("P0", "P1", "JITTER", "MIN_SYNCGAP", "MAX_SYNCGAP")
+
+DCF77_FRAMEBITS = 59
+DCF77_EV_PULSE, DCF77_EV_MINUTE, DCF77_EV_BIT0, DCF77_EV_BIT1, DCF77_EV_GLITCH = range(5)
+DCF77_OK = 0
+DCF77_FIX_FLYWHEEL, DCF77_FIX_FALSEMARK, DCF77_FIX_SLIP, DCF77_FIX_REBUILT, DCF77_FIX_REJECTED = 0x01, 0x02, 0x04, 0x08, 0x10
+
+
+class Ctx(ctypes.Structure):
+    _fields_ = [("frame", ctypes.c_uint64),
+                ("startPulse", ctypes.c_uint32),
+                ("endPulse", ctypes.c_uint32),
+                ("seconds", ctypes.c_uint8),
+                ("nbrBits", ctypes.c_uint8),
+                ("synchronized", ctypes.c_uint8),
+                ("reserved", ctypes.c_uint8)]
+
+
+class Slots(ctypes.Structure):
+    _fields_ = [("bits", ctypes.c_uint64),
+                ("seen", ctypes.c_uint64),
+                ("bad", ctypes.c_uint64),
+                ("lastFrame", ctypes.c_uint64),
+                ("lastChecked", ctypes.c_uint64),
+                ("lastMillis", ctypes.c_uint32),
+                ("lastSlot", ctypes.c_uint8),
+                ("framed", ctypes.c_uint8),
+                ("repairs", ctypes.c_uint8),
+                ("reserved", ctypes.c_uint8)]
+
+
+class Frame(ctypes.Structure):
+    _fields_ = [("frame", ctypes.c_uint64),
+                ("markTime", ctypes.c_uint32),
+                ("nbrBits", ctypes.c_uint8),
+                ("repairs", ctypes.c_uint8),
+                ("reserved", ctypes.c_uint8 * 2)]
+
+
+class Time(ctypes.Structure):
+    _fields_ = [("minute", ctypes.c_uint8),
+                ("hour", ctypes.c_uint8),
+                ("mday", ctypes.c_uint8),
+                ("wday", ctypes.c_uint8),
+                ("month", ctypes.c_uint8),
+                ("year", ctypes.c_uint8),
+                ("isdst", ctypes.c_int8),
+                ("status", ctypes.c_uint8),
+                ("flags", ctypes.c_uint8),
+                ("reserved", ctypes.c_uint8 * 3)]
+
+
+PROTOTYPES = {
+    "dcf77_init": (None, [ctypes.POINTER(Ctx)]),
+    "dcf77_push_edge": (ctypes.c_int, [ctypes.POINTER(Ctx), ctypes.c_uint32, ctypes.c_int]),
+    "dcf77_slots_init": (None, [ctypes.POINTER(Slots)]),
+    "dcf77_push_framed_edge": (ctypes.c_int, [ctypes.POINTER(Ctx), ctypes.POINTER(Slots), ctypes.c_uint32, ctypes.c_int]),
+    "dcf77_push_edges": (ctypes.c_size_t, [ctypes.POINTER(Ctx), ctypes.POINTER(ctypes.c_uint32),
+                                           ctypes.POINTER(ctypes.c_uint8), ctypes.c_size_t,
+                                           ctypes.POINTER(Frame), ctypes.c_size_t]),
+    "dcf77_push_framed_edges": (ctypes.c_size_t, [ctypes.POINTER(Ctx), ctypes.POINTER(Slots),
+                                                  ctypes.POINTER(ctypes.c_uint32), ctypes.POINTER(ctypes.c_uint8),
+                                                  ctypes.c_size_t, ctypes.POINTER(Frame), ctypes.c_size_t]),
+    "dcf77_check_frame": (ctypes.c_int, [ctypes.c_uint64]),
+    "dcf77_decode_frame": (ctypes.c_int, [ctypes.c_uint64, ctypes.POINTER(Time)]),
+    "dcf77_decode_frames": (ctypes.c_size_t, [ctypes.POINTER(Frame), ctypes.POINTER(Time), ctypes.c_size_t]),
+    "dcf77_unix_time": (ctypes.c_uint32, [ctypes.POINTER(Time)]),
+    "dcf77_from_unix": (None, [ctypes.c_uint32, ctypes.c_int8, ctypes.POINTER(Time)]),
+    "dcf77_encode_frame": (ctypes.c_uint64, [ctypes.POINTER(Time)]),
+}
+
+
+def cache_dir():
+    return os.environ.get("DCF77_CACHE") or os.path.join(os.path.expanduser("~"), ".cache", "dcf77")
+
+
+def build(params=None, tuning=False):
+    """Path of the shared library for the thresholds params, or of the
+    tuning build, compiled if missing or older than the core sources"""
+    tag = "tuning" if tuning else "-".join(map(str, params)) if params else "default"
+    path = os.path.join(cache_dir(), "libdcf77-%s.so" % tag)
+    sources = [os.path.join(CORE, f) for f in SOURCES + HEADERS]
+    if os.path.exists(path) and os.path.getmtime(path) >= max(os.path.getmtime(s) for s in sources):
+        return path
+    os.makedirs(cache_dir(), exist_ok=True)
+    defines = ["-DDCF77_TUNING"] if tuning else ["-D%s=%d" % (n, v) for n, v in zip(NAMES, params)] if params else []
+    temp = "%s.%d" % (path, os.getpid())   # parallel builds must not see half written files
+    command = [os.environ.get("CC", "cc"), "-O2", "-shared", "-fPIC", "-I" + CORE] + defines + \
+              [os.path.join(CORE, f) for f in SOURCES] + ["-o", temp]
+    result = subprocess.run(command, stderr=subprocess.PIPE, universal_newlines=True)
+    if result.returncode != 0:
+        sys.exit("cannot build libdcf77: %s\n%s" % (" ".join(command), result.stderr))
+    os.replace(temp, path)
+    return path
+
+
+class Edges:
+    """Edges [(t_ms, rising)] as the arrays of the batch functions, 
+    prepared once for decoding them with many thresholds"""
+
+    def __init__(self, edges):
+        self.n = len(edges)
+        self.times = (ctypes.c_uint32 * self.n)(*(t & 0xFFFFFFFF for t, _ in edges))
+        self.levels = (ctypes.c_uint8 * self.n)(*(1 if rising else 0 for _, rising in edges))
+        self.frames = (Frame * (self.n // 2 + 1))()
+        self.decoded = (Time * len(self.frames))()
+
+
+class Core:
+    """The core compiled with the thresholds params, None for the defaults
+    of DCF77Core.h. The C functions are attributes of the instance."""
+
+    def __init__(self, params=None, tuning=False):
+        self.params = tuple(params) if params else None
+        self.lib = ctypes.CDLL(build(self.params, tuning))
+        for name, (restype, argtypes) in PROTOTYPES.items():
+            function = getattr(self.lib, name)
+            function.restype, function.argtypes = restype, argtypes
+            setattr(self, name, function)
+
+    def context(self):
+        ctx = Ctx()
+        self.dcf77_init(ctx)
+        return ctx
+
+    def slots(self):
+        slots = Slots()
+        self.dcf77_slots_init(slots)
+        return slots
+
+    def decode(self, edges):
+        """[(markTime, unix)] of the valid telegrams in edges [(t_ms, rising)]
+        or Edges, framed by the time slots like the clock does, see
+        dcf77_push_framed_edges() and dcf77_decode_frames()"""
+        if not isinstance(edges, Edges):
+            edges = Edges(edges)
+        if edges.n == 0:
+            return []
+        frames, decoded = edges.frames, edges.decoded
+        nbrFrames = self.dcf77_push_framed_edges(self.context(), self.slots(), edges.times, edges.levels,
+                                                 edges.n, frames, len(frames))
+        self.dcf77_decode_frames(frames, decoded, nbrFrames)
+        return [(frames[i].markTime, self.dcf77_unix_time(decoded[i]))
+                for i in range(nbrFrames) if decoded[i].status == DCF77_OK]
+
+    def encode(self, unix, isdst=0):
+        """Telegram announcing the UTC seconds unix at its minute mark"""
+        t = Time()
+        self.dcf77_from_unix(unix, isdst, t)
+        return self.dcf77_encode_frame(t)
+
+
+class Tuning(Core):
+    """The core built with DCF77_TUNING, its thresholds are set at run time
+    with set_thresholds(). Holds one set per process."""
+
+    def __init__(self):
+        Core.__init__(self, tuning=True)
+        self.lib.dcf77_set_thresholds.restype = None
+        self.lib.dcf77_set_thresholds.argtypes = [ctypes.POINTER(ctypes.c_uint32)]
+
+    def set_thresholds(self, params):
+        """P0, P1, JITTER, MIN_SYNCGAP and MAX_SYNCGAP"""
+        self.params = tuple(params)
+        self.lib.dcf77_set_thresholds((ctypes.c_uint32 * 5)(*self.params))